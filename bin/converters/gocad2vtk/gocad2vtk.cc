@@ -198,6 +198,13 @@ int main(int argc, char **argv)
         /* Write point data.  This requires a double coordinate conversion
            utm2to dd and then dd to vtk coordinates */
         outstrm << "POINTS " << npoints<<" float"<<endl;
+        /* Coordinates are accumulated in parallel arrays so the 
+           conversion to vtk coordinates can be done in one call 
+           to the array version of the cartesian method */
+        vector<double> plat,plon,pr;
+        plat.reserve(npoints);
+        plon.reserve(npoints);
+        pr.reserve(npoints);
         PointSet::iterator psitr;
         for(psitr=utmpoints.begin();psitr!=utmpoints.end();++psitr)
         {
@@ -216,10 +223,19 @@ int main(int argc, char **argv)
                paraview we need to convert this to radius in km */
             double r=r0;
             r+=((psitr->x3)/1000.0);
-            Cartesian_point vtkpoint=vtkcoords.cartesian(lat,lon,r);
-            outstrm << vtkpoint.x1 <<" "
-                << vtkpoint.x2 << " "
-                << vtkpoint.x3 << endl;
+            plat.push_back(lat);
+            plon.push_back(lon);
+            pr.push_back(r);
+        }
+        if(npoints>0)
+        {
+            vector<double> vx1(npoints),vx2(npoints),vx3(npoints);
+            vtkcoords.cartesian(&(plat[0]),&(plon[0]),&(pr[0]),
+                    &(vx1[0]),&(vx2[0]),&(vx3[0]),npoints,true);
+            for(i=0;i<npoints;++i)
+                outstrm << vx1[i] <<" "
+                    << vx2[i] << " "
+                    << vx3[i] << endl;
         }
         // second number is number of items to read. 
         outstrm << "POLYGONS "<<ntriangles<<" "<<ntriangles*4<<endl;
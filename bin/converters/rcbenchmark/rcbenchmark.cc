@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "coords.h"
+#include "seispp.h"
+#include "RegionalCoordinates.h"
+using namespace std;
+using namespace SEISPP;
+const string prog("rcbenchmark");
+/* Benchmark of the RegionalCoordinates conversions used by the
+   converters.   Random points in a box around the origin are converted
+   with the scalar methods, the array methods on one thread, and the
+   array methods split between threads.  Times and the largest difference
+   from the scalar results are written to stdout.  */
+void usage()
+{
+    cerr << prog <<" [-n npoints -r repetitions -v]"<<endl
+        << "Times scalar and array RegionalCoordinates conversions"<<endl
+        << "Defaults:  npoints=1000000 repetitions=5"<<endl;
+    exit(-1);
+}
+/* Prints one line of the result table.   Time is the best of the
+   repetitions to reduce noise from other processes. */
+void report(string name, double t, double tscalar, int n, double maxdiff)
+{
+    cout << setw(28) << left << name << right
+        << setw(12) << setprecision(4) << fixed << t
+        << setw(12) << setprecision(2) << static_cast<double>(n)/t/1.0e6
+        << setw(10) << setprecision(2) << tscalar/t
+        << setw(14) << setprecision(3) << scientific << maxdiff
+        << endl;
+}
+/* Largest difference (km) of any cartesian component */
+double cartesian_diff(vector<double>& x1, vector<double>& x2, 
+        vector<double>& x3, vector<double>& sx1, vector<double>& sx2,
+        vector<double>& sx3)
+{
+    double result(0.0);
+    int n=x1.size();
+    for(int i=0;i<n;++i)
+    {
+        result=max(result,fabs(x1[i]-sx1[i]));
+        result=max(result,fabs(x2[i]-sx2[i]));
+        result=max(result,fabs(x3[i]-sx3[i]));
+    }
+    return(result);
+}
+/* Largest difference of geographic points converted to km */
+double geographic_diff(vector<double>& lat, vector<double>& lon,
+        vector<double>& r, vector<double>& slat, vector<double>& slon,
+        vector<double>& sr)
+{
+    double result(0.0);
+    int n=lat.size();
+    for(int i=0;i<n;++i)
+    {
+        result=max(result,fabs(r[i]-sr[i]));
+        result=max(result,fabs(lat[i]-slat[i])*sr[i]);
+        result=max(result,fabs(lon[i]-slon[i])*sr[i]*cos(slat[i]));
+    }
+    return(result);
+}
+bool SEISPP::SEISPP_verbose(false);
+int main(int argc, char **argv)
+{
+    int i,k;
+    int npts(1000000),nrep(5);
+    ios::sync_with_stdio();
+    for(i=1;i<argc;++i)
+    {
+        string sarg(argv[i]);
+        if(sarg=="-n")
+        {
+            ++i;
+            if(i>=argc) usage();
+            npts=atoi(argv[i]);
+        }
+        else if(sarg=="-r")
+        {
+            ++i;
+            if(i>=argc) usage();
+            nrep=atoi(argv[i]);
+        }
+        else if(sarg=="-v")
+            SEISPP_verbose=true;
+        else
+            usage();
+    }
+    if((npts<=0) || (nrep<=0)) usage();
+    /* Same origin as the example pf files of the converters */
+    RegionalCoordinates coords(rad(60.5),rad(-142.8),6162.94,rad(20.0));
+    vector<double> lat(npts),lon(npts),r(npts);
+    srand48(1);
+    for(i=0;i<npts;++i)
+    {
+        lat[i]=rad(55.5+10.0*drand48());
+        lon[i]=rad(-147.8+10.0*drand48());
+        r[i]=r0_ellipse(lat[i])-700.0*drand48();
+    }
+    vector<double> x1(npts),x2(npts),x3(npts);
+    vector<double> sx1(npts),sx2(npts),sx3(npts);
+    vector<double> glat(npts),glon(npts),gr(npts);
+    vector<double> slat(npts),slon(npts),sr(npts);
+    double t,t0,tcs,tcser,tcthr,tgs,tgser,tgthr;
+    tcs=tcser=tcthr=tgs=tgser=tgthr=1.0e99;
+    for(k=0;k<nrep;++k)
+    {
+        t0=omp_get_wtime();
+        for(i=0;i<npts;++i)
+        {
+            Cartesian_point cp=coords.cartesian(lat[i],lon[i],r[i]);
+            sx1[i]=cp.x1;
+            sx2[i]=cp.x2;
+            sx3[i]=cp.x3;
+        }
+        t=omp_get_wtime()-t0;
+        if(t<tcs) tcs=t;
+        t0=omp_get_wtime();
+        coords.cartesian(&(lat[0]),&(lon[0]),&(r[0]),
+                &(x1[0]),&(x2[0]),&(x3[0]),npts,false);
+        t=omp_get_wtime()-t0;
+        if(t<tcser) tcser=t;
+        t0=omp_get_wtime();
+        coords.cartesian(&(lat[0]),&(lon[0]),&(r[0]),
+                &(x1[0]),&(x2[0]),&(x3[0]),npts,true);
+        t=omp_get_wtime()-t0;
+        if(t<tcthr) tcthr=t;
+        t0=omp_get_wtime();
+        for(i=0;i<npts;++i)
+        {
+            Geographic_point gp=coords.geographic(sx1[i],sx2[i],sx3[i]);
+            slat[i]=gp.lat;
+            slon[i]=gp.lon;
+            sr[i]=gp.r;
+        }
+        t=omp_get_wtime()-t0;
+        if(t<tgs) tgs=t;
+        t0=omp_get_wtime();
+        coords.geographic(&(sx1[0]),&(sx2[0]),&(sx3[0]),
+                &(glat[0]),&(glon[0]),&(gr[0]),npts,false);
+        t=omp_get_wtime()-t0;
+        if(t<tgser) tgser=t;
+        t0=omp_get_wtime();
+        coords.geographic(&(sx1[0]),&(sx2[0]),&(sx3[0]),
+                &(glat[0]),&(glon[0]),&(gr[0]),npts,true);
+        t=omp_get_wtime()-t0;
+        if(t<tgthr) tgthr=t;
+        if(SEISPP_verbose) cerr << prog << ":  finished repetition "
+            << k+1 << " of " << nrep << endl;
+    }
+    /* Results of the last repetition are from the threaded calls.  
+       Redo the serial calls so each is compared to the scalar methods.*/
+    double cdiffthr=cartesian_diff(x1,x2,x3,sx1,sx2,sx3);
+    double gdiffthr=geographic_diff(glat,glon,gr,slat,slon,sr);
+    coords.cartesian(&(lat[0]),&(lon[0]),&(r[0]),
+            &(x1[0]),&(x2[0]),&(x3[0]),npts,false);
+    coords.geographic(&(sx1[0]),&(sx2[0]),&(sx3[0]),
+            &(glat[0]),&(glon[0]),&(gr[0]),npts,false);
+    double cdiff=cartesian_diff(x1,x2,x3,sx1,sx2,sx3);
+    double gdiff=geographic_diff(glat,glon,gr,slat,slon,sr);
+    cout << prog << ":  " << npts << " points, best of " << nrep
+        << " repetitions, " << omp_get_max_threads() << " threads" << endl;
+    cout << setw(28) << left << "method" << right
+        << setw(12) << "seconds"
+        << setw(12) << "Mpoints/s"
+        << setw(10) << "speedup"
+        << setw(14) << "maxdiff(km)" << endl;
+    report("cartesian scalar",tcs,tcs,npts,0.0);
+    report("cartesian array",tcser,tcs,npts,cdiff);
+    report("cartesian array threaded",tcthr,tcs,npts,cdiffthr);
+    report("geographic scalar",tgs,tgs,npts,0.0);
+    report("geographic array",tgser,tgs,npts,gdiff);
+    report("geographic array threaded",tgthr,tgs,npts,gdiffthr);
+}
@@ -1,3 +1,4 @@
+#include "LatLonGridAxes.h"
 #include "MultiMask.h"
 MultiMask::MultiMask(istream& in)
 {
@@ -56,4 +57,54 @@ bool MultiMask::is_inside(double lat0, double lon0)
     }
     return true;
 }
-
+GCLMask MultiMask::build_mask(GCLgrid& g)
+{
+    GCLMask mask(g);
+    int i,j;
+    if(!is_latlon_rectilinear(g))
+    {
+        for(i=0;i<g.n1;++i)
+            for(j=0;j<g.n2;++j)
+            {
+                if(this->is_inside(g.lat(i,j),g.lon(i,j)))
+                    mask.enable_point(i,j);
+                else
+                    mask.mask_point(i,j);
+            }
+        return(mask);
+    }
+    LatLonGridAxes ax(g);
+    int nlat=ax.lat.size();
+    int nlon=ax.lon.size();
+    int nnodes=nlat*nlon;
+    /* keep is the logical and of all the polygon tests */
+    vector<unsigned char> keep(nnodes,1);
+    vector<unsigned char> polyin;
+    int k,n;
+    int npoly=polygon.size();
+    for(k=0;k<npoly;++k)
+    {
+        polygon[k].rasterize(ax.lat,ax.lon,polyin);
+        if(inside[k])
+        {
+            for(n=0;n<nnodes;++n)
+                if(!polyin[n]) keep[n]=0;
+        }
+        else
+        {
+            for(n=0;n<nnodes;++n)
+                if(polyin[n]) keep[n]=0;
+        }
+    }
+    int ilat,ilon;
+    for(ilat=0,n=0;ilat<nlat;++ilat)
+        for(ilon=0;ilon<nlon;++ilon,++n)
+        {
+            ax.node(ilat,ilon,i,j);
+            if(keep[n])
+                mask.enable_point(i,j);
+            else
+                mask.mask_point(i,j);
+        }
+    return(mask);
+}
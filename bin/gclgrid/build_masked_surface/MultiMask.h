@@ -1,6 +1,7 @@
 #ifndef _MULTIMASK_H_
 #define _MULTIMASK_H_
 #include "GeoPolygonRegion.h"
+#include "GCLMasked.h"
 /*! \brief Object to define a masked region define by multiple
   overlapping polygons.  Polygons define region inside or outside that is
   to be kept. Whether a point is defined as in or out is determined by the 
@@ -13,6 +14,16 @@ class MultiMask
         MultiMask(const MultiMask& parent);
         MultiMask& operator=(const MultiMask& parent);
         bool is_inside(double lat0, double lon0);
+        /*! \brief Build the mask for a grid.
+
+          Computes the GCLMask with each node of g enabled where is_inside
+          is true and masked otherwise.  If g is rectilinear in latitude 
+          and longitude each polygon is scan converted onto the grid with
+          GeoPolygonRegion::rasterize and the results are combined.  That
+          takes time proportional to the number of nodes plus edges.  
+          Other grids are tested node by node.
+          */
+        GCLMask build_mask(GCLgrid& g);
     private:
         /* An array of polygons that define the masking geometry. */
         vector<GeoPolygonRegion> polygon;
@@ -20,13 +20,15 @@ void usage()
 }
 /* This series of procedures implement a masked defined by points exceeding
    a min and max range.  More or less like a clip by value function.
-   All return the number of points masked by that method. */
+   All return the number of points masked by that method.  Points 
+   already masked are skipped a word at a time with next_valid_run. */
 int mask_range(GCLMaskedScalarField *f,double vmin, double vmax)
 {
     int count(0);
-    int i,j;
-    for(i=0;i<f->n1;++i)
-        for(j=0;j<f->n2;++j)
+    int i(0),j(0),n,iend;
+    while((n=f->next_valid_run(i,j))>0)
+    {
+        for(iend=i+n;i<iend;++i)
         {
             double vtest=f->val[i][j];
             if( (vtest<vmin) || (vtest>vmax) )
@@ -35,15 +37,17 @@ int mask_range(GCLMaskedScalarField *f,double vmin, double vmax)
                 ++count;
             }
         }
+    }
     return(count);
 }
 /* For a vector field we use the L2 norm of components for size */
 int mask_range(GCLMaskedVectorField *f,double vmin, double vmax)
 {
     int count(0);
-    int i,j,k;
-    for(i=0;i<f->n1;++i)
-        for(j=0;j<f->n2;++j)
+    int i(0),j(0),k,n,iend;
+    while((n=f->next_valid_run(i,j))>0)
+    {
+        for(iend=i+n;i<iend;++i)
         {
             double vtest,vtmp;
             for(k=0,vtest=0.0;k<f->nv;++k) 
@@ -58,15 +62,17 @@ int mask_range(GCLMaskedVectorField *f,double vmin, double vmax)
                 ++count;
             }
         }
+    }
     return(count);
 }
 /* For a plain grid we use the depth method */
 int mask_range(GCLMaskedGrid *g,double vmin, double vmax)
 {
     int count(0);
-    int i,j;
-    for(i=0;i<g->n1;++i)
-        for(j=0;j<g->n2;++j)
+    int i(0),j(0),n,iend;
+    while((n=g->next_valid_run(i,j))>0)
+    {
+        for(iend=i+n;i<iend;++i)
         {
             double vtest=g->depth(i,j);
             if( (vtest<vmin) || (vtest>vmax) )
@@ -75,6 +81,7 @@ int mask_range(GCLMaskedGrid *g,double vmin, double vmax)
                 ++count;
             }
         }
+    }
     return(count);
 }
 bool SEISPP::SEISPP_verbose(true);
@@ -167,21 +174,10 @@ int main(int argc, char **argv)
                 cerr << "Coding error:  input type has not been set correctly"<<endl;
                 usage();
         }
-        /* This will hold the mask we will apply.  We clone it's geometry from g to guarantee
-           consistency */
-        GCLMask mask(*g);
-        /* now compute the mask */
-        for(i=0;i<g->n1;++i)
-            for(j=0;j<g->n2;++j)
-            {
-                double lat,lon;
-                lat=g->lat(i,j);
-                lon=g->lon(i,j);
-                if(polymask.is_inside(lat,lon))
-                    mask.enable_point(i,j);
-                else
-                    mask.mask_point(i,j);
-            }
+        /* This will hold the mask we will apply.  It clones the geometry
+           of g to guarantee consistency.  Regular lat,lon grids are 
+           rasterized and others are tested point by point */
+        GCLMask mask(polymask.build_mask(*g));
         GCLMaskedGrid *mg;
         GCLMaskedScalarField *msf;
         GCLMaskedVectorField *mvf;
@@ -13,6 +13,7 @@
 #include "Metadata.h"
 #include "gclgrid.h"
 #include "GCLMasked.h"
+#include "GCLVolumeSmoother.h"
 #include "agc.h"
 #include "vtk_output.h"
 
@@ -228,6 +229,41 @@ int main(int argc, char **argv)
 			  << " pf parameter is set true"<<endl;
 			exit(-1);
 		}
+		/* Optional 3d smoothing.  Defaults off so older pf files
+		   without these parameters still work. */
+		bool apply_smoother(false);
+		GCLVolumeSmoother smoother;
+		if(control.is_attribute("apply_smoother"))
+			apply_smoother=control.get_bool("apply_smoother");
+		if(apply_smoother)
+		{
+			string kernel=control.get_string("smoother_kernel");
+			VolumeSmootherKernel ktype;
+			if(kernel=="gaussian")
+				ktype=GaussianKernel;
+			else if(kernel=="boxcar")
+				ktype=BoxcarKernel;
+			else
+			{
+				cerr << "Illegal smoother_kernel="<<kernel<<endl
+				  << "Must be gaussian or boxcar"<<endl;
+				exit(-1);
+			}
+			double sl1=control.get_double("smoother_x1_length");
+			double sl2=control.get_double("smoother_x2_length");
+			double sl3=control.get_double("smoother_x3_length");
+			smoother=GCLVolumeSmoother(ktype,sl1,sl2,sl3);
+			cout << "Applying "<<kernel<<" smoother with lengths "
+				<< sl1<<", "<<sl2<<", "<<sl3
+				<< " grid intervals"<<endl;
+			if(control.is_attribute("smoother_null_value"))
+			{
+				double nullval=control.get_double("smoother_null_value");
+				smoother.set_null_value(nullval);
+				cout << "Points with value "<<nullval
+					<< " are masked by the smoother"<<endl;
+			}
+		}
 		string fielddir;
 		if(saveagcfield)
 			fielddir=control.get_string("field_directory");
@@ -245,6 +281,7 @@ int main(int argc, char **argv)
 				remap_grid(dynamic_cast<GCLgrid3d&>(field),
 						*rgptr);
 			}
+			if(apply_smoother) smoother.apply(field);
 			if(rmeanx3) remove_mean_x3(field);
 			if(apply_agc) agc_scalar_field(field,iwagc);
                         if(xmloutput)
@@ -280,6 +317,10 @@ int main(int argc, char **argv)
 			}
                         if(SaveAsVectorField)
                         {
+                            if(apply_smoother)
+                                cerr << "apply_smoother set true:  "
+                                    << "ignored when save_as_vector_field "
+                                    << "is true"<<endl;
                             if(xmloutput)
                                 outfile=outfile+".vts";
                             else
@@ -295,6 +336,7 @@ int main(int argc, char **argv)
 			        GCLscalarfield3d *sfptr;
                                 vector<string> thiscomponent;
 				sfptr = extract_component(vfield,i);
+				if(apply_smoother) smoother.apply(*sfptr);
 				if(apply_agc) agc_scalar_field(*sfptr,iwagc);
 				stringstream ss;
 				ss << outfile <<"_"<<i;
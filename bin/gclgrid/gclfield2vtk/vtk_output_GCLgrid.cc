@@ -107,34 +107,30 @@ int vtk_output_GCLgrid(GCLMaskedScalarField& g,ofstream& out,string data_tag)
         write_header_block(g.name,out);
         write_points(g,out);
         /* For a masked grid the number of actual polygons has to be computed.
-           To do that we basically build the POLYGONS section first as a list of
-           strings.  We then just ask the size of the list to get the size field
-           and then dump this list of strings. Algorithm is further complicated 
-           by the fact that a valid polygon requires testing all 4 corners.  
-           If the masking algorithm were expensive this could be a problem, but
-           since this implementation is simply testing a boolean this is not a 
-           concern. Point this out as an extension to a generalization could
-         make this an issue*/
-        list<string> polygons;
+           A valid polygon requires all 4 corners be valid.  cell_mask 
+           computes that for the whole grid a word at a time so we just
+           count the valid cells and then write them by walking the runs of
+           valid cells.*/
+        GCLMask cells(g.cell_mask());
+        int npoly=cells.number_valid();
+        icell=(g.n1-1)*(g.n2-1);
         char linebuf[512];
-        for(j=0,icell=0;j<g.n2-1;++j)
-            for(i=0;i<g.n1-1;++i,++icell)
+        out << "POLYGONS " << npoly<< " " << 5*npoly<<endl;
+        int n,iend;
+        i=0;
+        j=0;
+        while((n=cells.next_valid_run(i,j))>0)
+        {
+            for(iend=i+n;i<iend;++i)
             {
-                if( g.point_is_valid(i,j) && g.point_is_valid(i+1,j)
-                        &&  g.point_is_valid(i,j+1) &&  g.point_is_valid(i+1,j+1))
-                {
-                    /* Because we define all the points above and not just those
-                       with valid data we can use the same point indexing formulas
-                       as the full grid writer */
-                    sprintf(linebuf,"4 %d %d %d %d\n",j*g.n1 + i,j*g.n1 + i + 1,
-                            (j+1)*g.n1 + i + 1, (j+1)*g.n1 + i);
-                    polygons.push_back(string(linebuf));
-                }
+                /* Because we define all the points above and not just those
+                   with valid data we can use the same point indexing formulas
+                   as the full grid writer */
+                sprintf(linebuf,"4 %d %d %d %d\n",j*g.n1 + i,j*g.n1 + i + 1,
+                        (j+1)*g.n1 + i + 1, (j+1)*g.n1 + i);
+                out << linebuf<<endl;
             }
-        out << "POLYGONS " << polygons.size()<< " " << 5*polygons.size()<<endl;
-        list<string>::iterator lptr;
-        for(lptr=polygons.begin();lptr!=polygons.end();++lptr)
-            out << *lptr<<endl;
+        }
         /* Finally write out the data section.   I believe the concept is 
            that values are linked to points.   Any masked points could be 
            deleted, but here we include them and set them to the value 
@@ -4,6 +4,7 @@
 #include "Metadata.h"
 #include "VelocityModel_1d.h"
 #include "Crust1_0.h"
+#include "Crust1VolumeBuilder.h"
 GCLgrid *makegrid(Metadata& p)
 {
     /* The parameters used here are identical to makegclgrid 
@@ -78,7 +79,7 @@ int main(int argc, char **argv)
     try{
         Metadata control(pf);
         DatascopeHandle dbh(dbname,false);
-        Crust1_0 crust1p0;
+        const Crust1_0& crust1p0=Crust1_0::shared();
         GCLgrid *g;
         if(load_grid_from_db)
             g=new GCLgrid(dbh,gridname);
@@ -116,15 +117,38 @@ int main(int argc, char **argv)
         GCLscalarfield f(*g);
         /* We can clear g now */
         delete g;
+        /* All the fields come from one batch evaluation of the model
+           at the grid nodes.  Node i,j is point i*n2+j. */
+        int npts=f.n1*f.n2;
+        vector<double> nodelat(npts),nodelon(npts);
+        for(i=0;i<f.n1;++i)
+            for(j=0;j<f.n2;++j)
+            {
+                Geographic_point gp=f.geo_coordinates(i,j);
+                /* Crust1_0 object uses degrees not radians as used in gclgrid library*/
+                nodelat[i*f.n2+j]=deg(gp.lat);
+                nodelon[i*f.n2+j]=deg(gp.lon);
+            }
+        const int nl(Crust1_0::NumLayers);
+        vector<double> vp(nl*npts),vs(nl*npts),rho(nl*npts),tops(nl*npts);
+        Crust1Buffers crustbuf;
+        crustbuf.vp=&(vp[0]);
+        crustbuf.vs=&(vs[0]);
+        crustbuf.rho=&(rho[0]);
+        crustbuf.tops=&(tops[0]);
+        crust1p0.evaluate(&(nodelat[0]),&(nodelon[0]),npts,
+                Crust1Vp|Crust1Vs|Crust1Density|Crust1LayerTops,crustbuf);
+        /* The last layer is the mantle so these are the properties just
+           below the Moho.  (model strips zero thickness layers but the 
+           mantle layer is never empty.) */
+        const size_t moho=static_cast<size_t>(nl-1)*npts;
         for(j=0;j<f.n2;++j)
             for(i=0;i<f.n1;++i)
             {
+                int p=i*f.n2+j;
                 Geographic_point gp=f.geo_coordinates(i,j);
-                /* Crust1_0 object uses degrees not radians as used in gclgrid library*/
-                double dlat=deg(gp.lat);
-                double dlon=deg(gp.lon);
                 double r0=r0_ellipse(gp.lat);
-                gp.r = r0 - crust1p0.CrustalThickness(dlat,dlon);
+                gp.r = r0 - (tops[p]-tops[moho+p]);
                 /* change the point's coordinates.  This algorithm effectively projects
                 grid to surface and then projects down.   Not important when generated
                 internally, but potentially an issue if grid is read from db */
@@ -132,10 +156,7 @@ int main(int argc, char **argv)
                 f.x1[i][j]=cp.x1;
                 f.x2[i][j]=cp.x2;
                 f.x3[i][j]=cp.x3;
-                VelocityModel_1d vp=crust1p0.model(dlat,dlon,string("Pvelocity"));
-                /* The object interface strips zero thickness layers in crust1.0 so
-                   we have to use the last layer velocity for moho velocity */
-                f.val[i][j]=vp.v[vp.nlayers-1];
+                f.val[i][j]=vp[moho+p];
             }
         string fieldname;
         fieldname=base_name+"_MVp";
@@ -144,17 +165,10 @@ int main(int argc, char **argv)
         else
             f.save(fieldname,outdir);
         /* For Vs and rho we only need to extract alternative data so this loop 
-           is simpler - no change to coordinates. Painfully repetitious code here, but
-           turnin this into a procedure would only confuse this*/
+           is simpler - no change to coordinates.*/
         for(j=0;j<f.n2;++j)
             for(i=0;i<f.n1;++i)
-            {
-                Geographic_point gp=f.geo_coordinates(i,j);
-                double dlat=deg(gp.lat);
-                double dlon=deg(gp.lon);
-                VelocityModel_1d vs=crust1p0.model(dlat,dlon,string("Svelocity"));
-                f.val[i][j]=vs.v[vs.nlayers-1];
-            }
+                f.val[i][j]=vs[moho+i*f.n2+j];
         fieldname=base_name+"_MVs";
         if(save_to_db)
             f.save(dbh,outdir,outdir,fieldname,fieldname);
@@ -162,13 +176,7 @@ int main(int argc, char **argv)
             f.save(fieldname,outdir);
         for(j=0;j<f.n2;++j)
             for(i=0;i<f.n1;++i)
-            {
-                Geographic_point gp=f.geo_coordinates(i,j);
-                double dlat=deg(gp.lat);
-                double dlon=deg(gp.lon);
-                VelocityModel_1d rho=crust1p0.model(dlat,dlon,string("Density"));
-                f.val[i][j]=rho.v[rho.nlayers-1];
-            }
+                f.val[i][j]=rho[moho+i*f.n2+j];
         fieldname=base_name+"_Mrho";
         if(save_to_db)
             f.save(dbh,outdir,outdir,fieldname,fieldname);
@@ -177,17 +185,43 @@ int main(int argc, char **argv)
         /* Finally do depth as a field.   Output depth in km */
         for(j=0;j<f.n2;++j)
             for(i=0;i<f.n1;++i)
-            {
-                Geographic_point gp=f.geo_coordinates(i,j);
-                double dlat=deg(gp.lat);
-                double dlon=deg(gp.lon);
-                f.val[i][j]=crust1p0.CrustalThickness(dlat,dlon);
-            }
+                f.val[i][j]=tops[i*f.n2+j]-tops[moho+i*f.n2+j];
         fieldname=base_name+"_depthmoho";
         if(save_to_db)
             f.save(dbh,outdir,outdir,fieldname,fieldname);
         else
             f.save(fieldname,outdir);
+        /* Optional 3d volumes of the full crust.  The grid must already
+           exist in the database.  Defaults off so older pf files still 
+           work. */
+        if(control.is_attribute("volume_gridname"))
+        {
+            string volname=control.get_string("volume_gridname");
+            GCLgrid3d vgrid(dbh,volname);
+            GCLscalarfield3d vp(vgrid),vs(vgrid),rho(vgrid);
+            Crust1VolumeBuilder builder(crust1p0);
+            if(control.is_attribute("volume_null_value"))
+                builder.set_null_value(control.get_double("volume_null_value"));
+            int ninside=builder.build(vp,vs,rho);
+            cout << "gridcrust1p0:  "<<ninside<<" of "
+                << vgrid.n1*vgrid.n2*vgrid.n3
+                << " nodes of grid "<<volname<<" are in the crust"<<endl;
+            fieldname=base_name+"_Vp";
+            if(save_to_db)
+                vp.save(dbh,outdir,outdir,fieldname,fieldname);
+            else
+                vp.save(fieldname,outdir);
+            fieldname=base_name+"_Vs";
+            if(save_to_db)
+                vs.save(dbh,outdir,outdir,fieldname,fieldname);
+            else
+                vs.save(fieldname,outdir);
+            fieldname=base_name+"_rho";
+            if(save_to_db)
+                rho.save(dbh,outdir,outdir,fieldname,fieldname);
+            else
+                rho.save(fieldname,outdir);
+        }
     }catch(std::exception err)
     {
         cerr << err.what()<<endl;
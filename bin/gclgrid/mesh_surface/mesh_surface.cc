@@ -113,14 +113,21 @@ int main(int argc, char **argv)
         GeoSurface *bptr; 
         // Comparable when using an attribute added to surface
         GeoSurface *abptr;
+        string cachedir("");
+        if(md.is_attribute("surface_cache_directory"))
+            cachedir=md.get_string("surface_cache_directory");
+        /* Set for triangulated surfaces to allow the rasterization 
+           shortcut used below */
+        GeoTriMeshSurface *gtmsptr=NULL;
+        GeoTriMeshSurface *gatmpptr=NULL;
         if(surface_type=="DelaunayTriangularization")
         {
-            GeoTriMeshSurface *gtmsptr=new GeoTriMeshSurface(gp);
+            gtmsptr=new GeoTriMeshSurface(gp,string("radians"),cachedir);
             bptr=dynamic_cast<GeoSurface*>(gtmsptr);
             if(data_has_attribute)
             {
-                GeoTriMeshSurface *gatmpptr
-                    =new GeoTriMeshSurface(gp_attr);
+                gatmpptr=new GeoTriMeshSurface(gp_attr,string("radians"),
+                        cachedir);
                 abptr=dynamic_cast<GeoSurface*>(gatmpptr);
             }
         }
@@ -128,11 +135,13 @@ int main(int argc, char **argv)
         {
             GeoSplineSurface *gssptr=new GeoSplineSurface(gp,md);
             bptr=dynamic_cast<GeoSurface*>(gssptr);
+            cout << gssptr->fit_statistics();
             if(data_has_attribute)
             {
                 GeoSplineSurface *gatmpptr
                     = new GeoSplineSurface(gp_attr,md);
                 abptr=dynamic_cast<GeoSurface*>(gatmpptr);
+                cout << gatmpptr->fit_statistics();
             }
         }
         else
@@ -143,34 +152,83 @@ int main(int argc, char **argv)
                 << "Edit parameter file and try again"<<endl;
             exit(-1);
         }
-        int nlive=0;
-        for(i=0;i<mesh.n1;++i)
-            for(j=0;j<mesh.n2;++j)
+        /* Evaluate the surface (and attribute) for all grid points in
+           one call.  Points are ordered with j varying fastest so 
+           neighbours in the arrays are neighbours in the grid. */
+        int npts=mesh.n1*mesh.n2;
+        vector<double> mlat(npts),mlon(npts),mdepth(npts),adepth(npts);
+        bool *defined=new bool[npts];
+        bool *adefined=NULL;
+        int k;
+        for(i=0,k=0;i<mesh.n1;++i)
+            for(j=0;j<mesh.n2;++j,++k)
             {
-                cout << "working on grid point i="<<i<<" j="<<j<<endl;
-                double mlat(mesh.lat(i,j));
-                double mlon(mesh.lon(i,j));
-                double mr=r0_ellipse(mlat);
-                if(bptr->is_defined(mlat,mlon))
+                mlat[k]=mesh.lat(i,j);
+                mlon[k]=mesh.lon(i,j);
+            }
+        if(data_has_attribute) adefined=new bool[npts];
+        int nlive;
+        if((gtmsptr!=NULL) && is_latlon_rectilinear(mesh))
+        {
+            /* A triangulation on a regular lat,lon mesh is much faster
+               to evaluate by scan converting the triangles */
+            cout << "Mesh is rectilinear in lat,lon - "
+                << "evaluating surface by rasterization"<<endl;
+            nlive=gtmsptr->rasterize_depth(f,UndefinedDepth);
+            for(i=0,k=0;i<mesh.n1;++i)
+                for(j=0;j<mesh.n2;++j,++k)
+                {
+                    mdepth[k]=f.val[i][j];
+                    defined[k]=(f.val[i][j]!=UndefinedDepth);
+                }
+            if(data_has_attribute)
+            {
+                gatmpptr->rasterize_depth(f,UndefinedDepth);
+                for(i=0,k=0;i<mesh.n1;++i)
+                    for(j=0;j<mesh.n2;++j,++k)
+                    {
+                        adepth[k]=f.val[i][j];
+                        adefined[k]=(f.val[i][j]!=UndefinedDepth);
+                    }
+            }
+        }
+        else
+        {
+            nlive=bptr->batch_depth(&(mlat[0]),&(mlon[0]),&(mdepth[0]),
+                    defined,npts,true);
+            if(data_has_attribute)
+                abptr->batch_depth(&(mlat[0]),&(mlon[0]),&(adepth[0]),
+                        adefined,npts,true);
+        }
+        for(i=0,k=0;i<mesh.n1;++i)
+            for(j=0;j<mesh.n2;++j,++k)
+            {
+                if(defined[k])
                 {
-                    f.val[i][j]=bptr->depth(mlat,mlon);
-                    mr-=f.val[i][j];
-                    ++nlive;
-                    Cartesian_point cp=mesh.gtoc(mlat,mlon,mr);
+                    f.val[i][j]=mdepth[k];
+                    double mr=r0_ellipse(mlat[k])-mdepth[k];
+                    Cartesian_point cp=mesh.gtoc(mlat[k],mlon[k],mr);
                     f.x1[i][j]=cp.x1;
                     f.x2[i][j]=cp.x2;
                     f.x3[i][j]=cp.x3;
                     if(data_has_attribute)
-                        f.val[i][j]=abptr->depth(mlat,mlon);
+                    {
+                        if(adefined[k])
+                            f.val[i][j]=adepth[k];
+                        else
+                            f.val[i][j]=UndefinedDepth;
+                    }
                     //DEBUG
-                    cout << deg(mlon) << " "<<deg(f.lon(i,j))<<" "
-                        <<deg(mlat)<<" "<<deg(f.lat(i,j))
+                    cout << deg(mlon[k]) << " "<<deg(f.lon(i,j))<<" "
+                        <<deg(mlat[k])<<" "<<deg(f.lat(i,j))
                         <<" "<<f.depth(i,j)<<" "<<f.val[i][j]<<endl;
                 }
                 else
                     // Do not distort grid for undefined points - leaves them at original r
                     f.val[i][j]=UndefinedDepth;
             }
+        delete [] defined;
+        if(adefined!=NULL) delete [] adefined;
         f.save(outfieldname,string("."));
         cout << "Saved result to field file with root name="<<outfieldname<<endl
             << "There are "<<nlive<<" live points of total in grid of "
@@ -7,6 +7,7 @@
 #include "interpolator1d.h"
 #include "PLGeoPath.h"
 #include "PlateBoundaryPath.h"
+#include "FlowLineTracer.h"
 /* this is used several times here.  Beware if you ever cut and paste from this file */
 const double REARTH(6378.17);  //This is a constant earth radius used for distance estimates`
 using namespace std;
@@ -44,63 +45,9 @@ vector<Geographic_point> load_geopointdata(string fname)
        force it to first point in list.  Allow azimuth to default to 0 */
     return(points);
 }
-PLGeoPath timesample_PLGeoPath(PLGeoPath& raw, 
-        vector<double>t,vector<double> s,double dt,double endtime)
-{
-    if(t.size()!=s.size()) throw SeisppError(string("timesample_PLGeoPath:  ")
-            + "time and distance vector sizes do not match");
-    double s0=raw.sbegin();
-    double smax=raw.send();
-    Geographic_point gp;
-    vector<Geographic_point> newpts;
-    int nt=t.size();
-    if(nt<=1) throw SeisppError(string("timesample_PLGeoPath:  ")
-            + "empty vectors for time and distance for path");
-    double t0,tmax;
-    tmax=t[nt-1];
-    //Assume first point is time t=0;
-    gp=raw.origin();
-    newpts.push_back(gp);
-    t0=dt;
-    /* terminate on either end of the path or the passed endtime 
-       argument*/
-    double etest=endtime+(0.01*dt);  //allow some slop for this test
-    while(t0<tmax && t0<=etest)
-    {
-        // A hideously inefficient linear search, but don't expect
-        // nt to ever be huge
-        int i;
-        for(i=1;i<nt;++i)
-            if(t[i]>t0) break;
-        double dsdt=(s[i]-s[i-1])/(t[i]-t[i-1]);
-        double sp=s[i-1]+(t0-t[i-1])*dsdt;
-        gp=raw.position(sp);
-        newpts.push_back(gp);
-        t0+=dt;
-    }
-    return(PLGeoPath(newpts,0));
-}
-PLGeoPath resample_PLGeoPath(PLGeoPath& raw,double ds)
-{
-    if(ds<=0.0) 
-        throw SeisppError("resample_PLGeoPath was passed a negative resample interval");
-    double s0=raw.sbegin();
-    double smax=raw.send();
-    Geographic_point gp;
-    gp=raw.origin();
-    vector<Geographic_point> newpts;
-    newpts.push_back(gp);
-    double s;
-    s=s0+ds;
-    while(s<smax)
-    {
-        gp=raw.position(s);
-        newpts.push_back(gp);
-        s+=ds;
-    }
-    return(PLGeoPath(newpts,0));
-}
-GeoPath *BuildPBPObject(double olat, double olon, Pf *pf)
+/* Build the plate motion model from the pole_data Tbl.  The one
+   model is shared by all paths.  */
+StagePoleModel BuildStagePoleModel(Pf *pf)
 {
     Tbl *t;
     string tname("pole_data");
@@ -131,55 +78,7 @@ GeoPath *BuildPBPObject(double olat, double olon, Pf *pf)
         /* These are stage pole rotation angles */
         ang.insert(ang.begin(),phi);
     }
-    int npoles=spla.size();
-    if(npoles==1)
-    {
-        PlateBoundaryPath *pbpath=new PlateBoundaryPath(spla[0],splo[0],
-                olat,olon,ang[0]/dt[0]);
-        return pbpath;
-    }
-    else
-    {
-        TimeVariablePlateBoundaryPath *pbpath=new TimeVariablePlateBoundaryPath(
-                spla,splo,dt,ang,olat,olon);
-        return pbpath;
-    }
-}
-/*  Compute and return great circle distance between two points
-    defined by two Geographic_point objects. Returned distance 
-    is in radians. */
-double GeoDistance(Geographic_point gp0, Geographic_point gp1)
-{
-    double delta,az;
-    dist(gp0.lat,gp0.lon,gp1.lat,gp1.lon,&delta,&az);
-    return(delta);
-}
-
-/* This pair of functions are used to computed 3d distance and 
-   a corrected time increment for paths.  There is duplication of
-   the distance calculation, which is not very efficient, but 
-   acceptable as long as as this isn't used enormous numbers
-   of times.
-
-In both procedures gp0 is first point and gp1 is second.  Significant
-only in how horizontal distance is computed as r*delta.  */
-double distance_increment(Geographic_point gp0, Geographic_point gp1, 
-        double dt)
-{
-    double delta;
-    delta=GeoDistance(gp0,gp1);
-    delta*=gp0.r;
-    double ds=hypot(delta,fabs(gp1.r-gp0.r));
-    return(ds);
-}
-double adjustedtime(Geographic_point gp0, Geographic_point gp1, 
-        double dt)
-{
-    double delta;
-    delta=GeoDistance(gp0,gp1);
-    delta*=r0_ellipse(gp0.lat);
-    double ds=hypot(delta,fabs(gp1.r-gp0.r));
-    return(dt*ds/delta);
+    return(StagePoleModel(spla,splo,dt,ang));
 }
 void usage()
 {
@@ -298,170 +197,50 @@ int main(int argc, char **argv)
                in 3d than the paths constructed. */
             rawmaster=load_geopointdata(master_curve_file);
             PLGeoPath masterpath(rawmaster,0,0.0);
-            /* We need this to define end of path repeatedly */
-            double master_path_total_length=masterpath.send();
-
+            const int oversampling(50);
             /* Now create one path for each point on resampled trench path.*/
-            int npoints=SEISPP::nint(modeltime/timesampleinterval)+1;
             int npaths=zerotimecurve.number_points();
             if(SEISPP_verbose) cerr << "Output grid npaths="<<npaths<<endl;
-            GeoPath *pbpath;
+            vector<Geographic_point> origins;
             for(i=0;i<npaths;++i)
             {
-                double s;
-                Geographic_point gp;
                 if(triple_mode)
                 {
-                    gp=zerotimecurve.node_position(i);
+                    origins.push_back(zerotimecurve.node_position(i));
                 }
                 else
                 {
-                    s=trench_path_sample_interval*static_cast<double>(i);
-                    gp=zerotimecurve.position(s);
+                    double s=trench_path_sample_interval*static_cast<double>(i);
+                    origins.push_back(zerotimecurve.position(s));
                 }
-                pbpath=BuildPBPObject(gp.lat,gp.lon, pf);
-                const int oversampling(50);
-                double sdt=timesampleinterval/static_cast<double>(oversampling);
-                int j;
-                vector<Geographic_point> oversampledpath;
-                /* These are needed if we have to extrapolate the last valid point */
-                Geographic_point lastgp;
-                /* This vector holds path times corrected for radial distance.
-                   This is necessary to create a time grid.*/
-                vector<double> corrected_time;
-                /* Parallel vector of arc distances */
-                vector<double> path_s;
-                double current_time(0.0),current_s(0.0),ds;
-                double dzdx;
-                if(SEISPP_verbose) cerr <<"Oversample path length="
-                    <<npoints*oversampling<<endl;
-                /* Two counters used here.  j is the live index for
-                 vectors.  jloop is the total loop counter
-                 They are different only if origin outside convex
-                 hull error (jloop=0 conditional) is entered */
-                for(int jloop=0,j=0;jloop<(npoints*oversampling+1);++j,++jloop)
-                {
-                    gp=pbpath->position(static_cast<double>(jloop)*sdt);
-                    if(current_s<master_path_total_length)
-                    {
-                        Geographic_point gptmp=masterpath.position(current_s);
-                        /* This is necessary to properly handle ellipticity
-                           since masterpath may be at a completely different
-                           latitude that the path being constructed */
-                        double masterz=r0_ellipse(gptmp.lat)-gptmp.r;
-                        gp.r=r0_ellipse(gptmp.lat)-masterz;
-                    }
-                    else
-                    {
-                    // Allow the first point to be skipped but issue warning
-                        if(jloop==0)
-                        {
-                            cerr << "Warning:  origin point not inside convex hull. "<<endl
-                                << "A skew of about "<<1.0/static_cast<double>(oversampling)
-                                << " of the time sampling rate will be present"<<endl;
-                            lastgp=gp;
-                            --j;
-                            continue;
-                        }
-                        else if(j<2)
-                            break;
-                        else
-                        {
-
-                            // This computes change in depth (sign switch)
-                            dzdx=oversampledpath[j-2].r
-                                        - oversampledpath[j-1].r;
-                            /* compute distance between j-1 and j-2 to compute dip */
-                            double ddelta=GeoDistance(oversampledpath[j-2],oversampledpath[j-1]);
-                            dzdx/= ddelta;  // note mixed units.  dz in km, ddelta in radians
-                            double dipdeg;
-                            double R0(oversampledpath[j-1].r);
-                            dipdeg=dzdx/R0;
-                            dipdeg=deg(atan(dipdeg));
-                            /* These could be  precomputed for efficiency but better to leave
-                               it here for clarity */
-                            if(dipdeg>maxdip)
-                            {
-                                dzdx=tan(rad(maxdip))*R0;
-                                dipdeg=maxdip;
-                            }
-                            else if(dipdeg<mindip)
-                            {
-                                dzdx=tan(rad(mindip))*R0;
-                                dipdeg=mindip;
-                            }
-                            int jlast=j-1;
-                            if(SEISPP_verbose) 
-                                cerr << "Extending path "<<i<<" with dip "
-                                <<dipdeg<<" from point number "<<j<<endl
-                                <<"Position = " 
-                                <<deg(oversampledpath[jlast].lat)<<", "
-                                <<deg(oversampledpath[jlast].lon)<<endl;
-                            // now extend the path to npoints
-                            int jj;
-                            double s0=path_s[jlast];
-                            double r0=oversampledpath[jlast].r;
-                            lastgp=oversampledpath[jlast-1];
-                            for(jj=j;jj<(npoints*oversampling+1);++jj)
-                            {
-                                double s;
-                                s=static_cast<double>(jj)*sdt;
-                                gp=pbpath->position(s);
-                                // recycle ddelta for same context here
-                                ddelta=GeoDistance(lastgp,gp);
-                                /* This option corrects delta for 
-                                   shrinking length with depth */
-                                if(use_local_dip) ddelta *= lastgp.r/R0;
-                                gp.r=lastgp.r-dzdx*ddelta;
-                                oversampledpath.push_back(gp);
-                                current_time += adjustedtime(lastgp,gp,sdt);
-                                ds = distance_increment(lastgp,gp,sdt);
-                                current_s += ds;
-                                corrected_time.push_back(current_time);
-                                path_s.push_back(current_s);
-                                lastgp=gp;
-                            }
-                            break;
-                        }
-                    }
-                    if(j>0)
-                    {
-                        current_time += adjustedtime(lastgp,gp,sdt);
-                        ds = distance_increment(lastgp,gp,sdt);
-                        current_s += ds;
-                    }
-                    corrected_time.push_back(current_time);
-                    path_s.push_back(current_s);
-                    //DEBUG
-                    /*
-                    cout << "Interpolated: "
-                        << deg(gp.lon)<<" "
-                        << deg(gp.lat)<<" "
-                        <<r0_ellipse(gp.lat)-gp.r<<endl;
-                        */
-
-                    oversampledpath.push_back(gp);
-                    lastgp=gp;
-                }
-                if(oversampledpath.size()>1)
+            }
+            /* Paths are traced in parallel.  Warnings and output are 
+               produced afterward in path order. */
+            StagePoleModel spm=BuildStagePoleModel(pf);
+            FlowLineTracer tracer(spm,timesampleinterval,modeltime,
+                    oversampling);
+            /* Paths are always extended past the end of the master curve */
+            tracer.set_extension(mindip,maxdip,use_local_dip);
+            ProfileFlowLineDepth masterdepth(masterpath);
+            if(SEISPP_verbose) cerr <<"Oversample path length="
+                <<tracer.number_steps()<<endl;
+            vector<FlowLine> flowlines=tracer.trace(origins,masterdepth);
+            for(i=0;i<npaths;++i)
+            {
+                if(!flowlines[i].origin_defined)
+                    cerr << "Warning:  origin point not inside convex hull. "<<endl
+                        << "A skew of about "<<1.0/static_cast<double>(oversampling)
+                        << " of the time sampling rate will be present"<<endl;
+                if(SEISPP_verbose && (flowlines[i].extension_start>=0))
+                    cerr << "Extending path "<<i<<" with dip "
+                        <<flowlines[i].extension_dip<<" from point number "
+                        <<flowlines[i].extension_start<<endl
+                        <<"Position = " 
+                        <<deg(flowlines[i].extension_origin.lat)<<", "
+                        <<deg(flowlines[i].extension_origin.lon)<<endl;
+                if(flowlines[i].path.number_points()>0)
                 {
-                    //DEBUG
-                    /*
-                    for(int kd=0;kd<oversampledpath.size();++kd)
-                        cout << path_s[kd]<<" "
-                            << corrected_time[kd]<<" "
-                            << deg(oversampledpath[kd].lat)<<" "
-                            << deg(oversampledpath[kd].lon)<<" "
-                            << oversampledpath[kd].r
-                            <<" "
-                            << r0_ellipse(oversampledpath[kd].lat)
-                              - oversampledpath[kd].r<<endl;
-                              */
-                    PLGeoPath plop(oversampledpath,0);
-                    PLGeoPath finalpath=timesample_PLGeoPath(plop,
-                            corrected_time,path_s,timesampleinterval,
-                            modeltime);
-                    cout << finalpath;
+                    cout << flowlines[i].path;
                     cout <<">"<<endl;
                 }
                 else
@@ -469,10 +248,6 @@ int main(int argc, char **argv)
                     cerr << "Warning:  Path has zero length "
                         <<"for path point number "<<i<<endl;
                 }
-                oversampledpath.clear();
-                corrected_time.clear();
-                path_s.clear();
-                delete pbpath;
             }
         }
 
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "coords.h"
+#include "Metadata.h"
+#include "seispp.h"
+#include "gclgrid.h"
+#include "RegionalCoordinates.h"
+#include "StagePoleModel.h"
+#include "GeoCoordError.h"
+using namespace std;
+using namespace SEISPP;
+const string prog("platereconstruct");
+/* Legacy vtk cell type codes used for output */
+const int VTKVertex(1);
+const int VTKPolyLine(4);
+const int VTKQuad(9);
+const int VTKHexahedron(12);
+/* Everything to be reconstructed is accumulated in one set of arrays
+   so each age is a single call to the rotation engine.  Points keep
+   their depth so reconstructed points stay at the same depth below the
+   ellipsoid.  cells is the legacy vtk cell list (count followed by
+   point indices) and dataset tags each cell with the input it came
+   from for coloring in paraview. */
+class ReconstructionData
+{
+public:
+    vector<Geographic_point> points;
+    vector<double> depth;
+    vector<int> cells;
+    vector<int> celltype;
+    vector<int> dataset;
+    int number_points(){return(points.size());};
+    int number_cells(){return(celltype.size());};
+    int add_point(double lat, double lon, double z)
+    {
+        Geographic_point gp;
+        gp.lat=lat;
+        gp.lon=lon;
+        gp.r=r0_ellipse(lat)-z;
+        points.push_back(gp);
+        depth.push_back(z);
+        return(points.size()-1);
+    };
+    void add_cell(int type, int setid, const vector<int>& ids)
+    {
+        cells.push_back(ids.size());
+        cells.insert(cells.end(),ids.begin(),ids.end());
+        celltype.push_back(type);
+        dataset.push_back(setid);
+    };
+};
+/* Reads digitized line data in GMT multisegment format:  lon lat [depth]
+   with segments separated by lines beginning with >.  Depth is in km
+   and defaults to 0.  Lines beginning with # are comments.  Each segment
+   becomes one polyline (a vertex for single point segments).  Returns
+   the number of points read. */
+int load_line_file(string fname, int setid, ReconstructionData& d)
+{
+    const string base_error("load_line_file:  ");
+    FILE *fp=fopen(fname.c_str(),"r");
+    if(fp==NULL) throw SeisppError(base_error
+            + "Open failed on file="+fname);
+    vector<int> segment;
+    char line[256];
+    int npts(0);
+    while(true)
+    {
+        bool eof=(fgets(line,256,fp)==NULL);
+        if(eof || (line[0]=='>'))
+        {
+            if(segment.size()==1)
+                d.add_cell(VTKVertex,setid,segment);
+            else if(segment.size()>1)
+                d.add_cell(VTKPolyLine,setid,segment);
+            segment.clear();
+            if(eof) break;
+            continue;
+        }
+        if(line[0]=='#') continue;
+        double lon,lat,z(0.0);
+        int nread=sscanf(line,"%lf%lf%lf",&lon,&lat,&z);
+        if(nread<2) continue;
+        if(nread==2) z=0.0;
+        segment.push_back(d.add_point(rad(lat),rad(lon),z));
+        ++npts;
+    }
+    fclose(fp);
+    return(npts);
+}
+/* A surface grid becomes one quadrilateral per grid cell */
+void add_grid(GCLgrid& g, int setid, ReconstructionData& d)
+{
+    int i,j;
+    int base=d.number_points();
+    for(i=0;i<g.n1;++i)
+        for(j=0;j<g.n2;++j)
+            d.add_point(g.lat(i,j),g.lon(i,j),g.depth(i,j));
+    vector<int> ids(4);
+    for(i=0;i<g.n1-1;++i)
+        for(j=0;j<g.n2-1;++j)
+        {
+            ids[0]=base+i*g.n2+j;
+            ids[1]=base+(i+1)*g.n2+j;
+            ids[2]=base+(i+1)*g.n2+j+1;
+            ids[3]=base+i*g.n2+j+1;
+            d.add_cell(VTKQuad,setid,ids);
+        }
+}
+/* A volume grid becomes one hexahedron per grid cell */
+void add_grid(GCLgrid3d& g, int setid, ReconstructionData& d)
+{
+    int i,j,k,l;
+    int base=d.number_points();
+    for(i=0;i<g.n1;++i)
+        for(j=0;j<g.n2;++j)
+            for(k=0;k<g.n3;++k)
+                d.add_point(g.lat(i,j,k),g.lon(i,j,k),g.depth(i,j,k));
+    vector<int> ids(8);
+    for(i=0;i<g.n1-1;++i)
+        for(j=0;j<g.n2-1;++j)
+            for(k=0;k<g.n3-1;++k)
+            {
+                int n0=base+(i*g.n2+j)*g.n3+k;
+                ids[0]=n0;
+                ids[1]=n0+g.n2*g.n3;
+                ids[2]=n0+g.n2*g.n3+g.n3;
+                ids[3]=n0+g.n3;
+                for(l=0;l<4;++l) ids[l+4]=ids[l]+1;
+                d.add_cell(VTKHexahedron,setid,ids);
+            }
+}
+/* Writes one legacy ascii unstructured grid file.  x1, x2, and x3 are
+   the point coordinates in the output cartesian system. */
+void write_vtk(string fname, string title, ReconstructionData& d,
+        vector<double>& x1, vector<double>& x2, vector<double>& x3)
+{
+    ofstream out(fname.c_str(),ios::out);
+    if(out.fail()) throw SeisppError(string("write_vtk:  ")
+            + "Open failed for output file "+fname);
+    int i;
+    int npts=d.number_points();
+    int ncells=d.number_cells();
+    out << "# vtk DataFile Version 2.0"<<endl
+        << title <<endl
+        << "ASCII"<<endl
+        << "DATASET UNSTRUCTURED_GRID"<<endl;
+    out << "POINTS " << npts<<" float"<<endl;
+    for(i=0;i<npts;++i)
+        out << x1[i] <<" " << x2[i] << " " << x3[i] << endl;
+    out << "CELLS "<<ncells<<" "<<d.cells.size()<<endl;
+    vector<int>::iterator cptr=d.cells.begin();
+    while(cptr!=d.cells.end())
+    {
+        int nc=*cptr;
+        out << nc;
+        ++cptr;
+        for(i=0;i<nc;++i,++cptr) out << " "<<*cptr;
+        out << endl;
+    }
+    out << "CELL_TYPES "<<ncells<<endl;
+    for(i=0;i<ncells;++i) out << d.celltype[i]<<endl;
+    out << "CELL_DATA "<<ncells<<endl
+        << "SCALARS dataset int 1"<<endl
+        << "LOOKUP_TABLE default"<<endl;
+    for(i=0;i<ncells;++i) out << d.dataset[i]<<endl;
+    out << "POINT_DATA "<<npts<<endl
+        << "SCALARS depth float 1"<<endl
+        << "LOOKUP_TABLE default"<<endl;
+    for(i=0;i<npts;++i) out << d.depth[i]<<endl;
+}
+/* Paraview reads this json file as a time series of vtk files with
+   the age of each file as the time value.  File names are relative
+   to the directory of the series file. */
+void write_series(string fname, vector<string>& files, vector<double>& ages)
+{
+    ofstream out(fname.c_str(),ios::out);
+    if(out.fail()) throw SeisppError(string("write_series:  ")
+            + "Open failed for output file "+fname);
+    out << "{"<<endl
+        << "  \"file-series-version\" : \"1.0\","<<endl
+        << "  \"files\" : ["<<endl;
+    for(size_t i=0;i<files.size();++i)
+    {
+        string name(files[i]);
+        size_t slash=name.rfind('/');
+        if(slash!=string::npos) name.erase(0,slash+1);
+        out << "    { \"name\" : \""<<name<<"\", \"time\" : "
+            << ages[i] <<" }";
+        if((i+1)<files.size()) out << ",";
+        out << endl;
+    }
+    out << "  ]"<<endl
+        << "}"<<endl;
+}
+/* Returns the entries of a Tbl in the pf as a vector of strings.  An
+   undefined Tbl gives an empty list. */
+vector<string> get_string_list(Pf *pf, string tname)
+{
+    vector<string> result;
+    Tbl *t;
+    t=pfget_tbl(pf,const_cast<char *>(tname.c_str()));
+    if(t==NULL) return(result);
+    for(int i=0;i<maxtbl(t);++i)
+    {
+        char *line;
+        line=(char *)gettbl(t,i);
+        stringstream ss(line);
+        string s;
+        ss >> s;
+        if(s.length()>0) result.push_back(s);
+    }
+    freetbl(t,0);
+    return(result);
+}
+void usage()
+{
+    cerr << prog <<" outbase [-pf pffile -v]"<<endl
+        << "Reconstructs line data and grids to a list of ages with stage poles"
+        <<endl
+        << "Writes outbase_NNN.vtk for each age and outbase.vtk.series"
+        <<endl;
+    exit(-1);
+}
+bool SEISPP::SEISPP_verbose(false);
+int main(int argc, char **argv)
+{
+    int i,j;
+    ios::sync_with_stdio();
+    if(argc<2) usage();
+    string outbase(argv[1]);
+    string pfname(prog);
+    for(i=2;i<argc;++i)
+    {
+        string sarg(argv[i]);
+        if(sarg=="-pf")
+        {
+            ++i;
+            if(i>=argc) usage();
+            pfname=string(argv[i]);
+        }
+        else if(sarg=="-v")
+        {
+            SEISPP_verbose=true;
+        }
+        else
+            usage();
+    }
+    Pf *pf;
+    if(pfread(const_cast<char *>(pfname.c_str()),&pf))
+    {
+        cerr << "pfread failed for pf file="<<pfname<<endl;
+        usage();
+    }
+    try {
+        Metadata control(pf);
+        string spfile=control.get_string("stage_pole_file");
+        StagePoleModel spm(spfile);
+        vector<string> agelist=get_string_list(pf,"reconstruction_ages");
+        vector<double> ages;
+        int nlist=agelist.size();
+        for(i=0;i<nlist;++i)
+            ages.push_back(atof(agelist[i].c_str()));
+        if(ages.size()==0)
+        {
+            cerr << prog << ":  reconstruction_ages list is empty"<<endl;
+            exit(-1);
+        }
+        /* Output coordinate system.  Names are consistent with
+           vtk_gcl_converter and gocad2vtk */
+        double lat,lon,radius,az;
+        lat=control.get_double("origin_latitude");
+        lon=control.get_double("origin_longitude");
+        radius=control.get_double("origin_radius");
+        az=control.get_double("azimuth_y_axis");
+        RegionalCoordinates vtkcoords(rad(lat),rad(lon),radius,rad(az));
+        /* Load all the data.  Dataset numbers follow the order of the
+           lists in the pf file. */
+        ReconstructionData data;
+        int setid(0);
+        vector<string> files=get_string_list(pf,"line_files");
+        int nfiles=files.size();
+        for(i=0;i<nfiles;++i,++setid)
+        {
+            int n=load_line_file(files[i],setid,data);
+            if(SEISPP_verbose) cerr << prog << ":  read "<<n
+                <<" points from line file "<<files[i]<<endl;
+        }
+        files=get_string_list(pf,"surface_grid_files");
+        nfiles=files.size();
+        for(i=0;i<nfiles;++i,++setid)
+        {
+            GCLgrid g(files[i]);
+            add_grid(g,setid,data);
+            if(SEISPP_verbose) cerr << prog << ":  loaded surface grid "
+                <<files[i]<<" with "<<g.n1<<"x"<<g.n2<<" points"<<endl;
+        }
+        files=get_string_list(pf,"volume_grid_files");
+        nfiles=files.size();
+        for(i=0;i<nfiles;++i,++setid)
+        {
+            GCLgrid3d g(files[i]);
+            add_grid(g,setid,data);
+            if(SEISPP_verbose) cerr << prog << ":  loaded volume grid "
+                <<files[i]<<" with "<<g.n1<<"x"<<g.n2<<"x"<<g.n3
+                <<" points"<<endl;
+        }
+        int npts=data.number_points();
+        if(npts==0)
+        {
+            cerr << prog << ":  no input data.  Check the line_files, "
+                << "surface_grid_files, and volume_grid_files lists"<<endl;
+            exit(-1);
+        }
+        if(SEISPP_verbose) cerr << prog << ":  reconstructing "<<npts
+            <<" points and "<<data.number_cells()<<" cells to "
+            <<ages.size()<<" ages"<<endl;
+        /* One pass:  unit vectors are computed once.  Each age is then 
+           one threaded rotation of every point followed by one array 
+           conversion to output coordinates */
+        vector<double> xunit(3*npts);
+        for(i=0;i<npts;++i)
+            dsphcar(data.points[i].lon,data.points[i].lat,&(xunit[3*i]));
+        vector<double> plat(npts),plon(npts),pr(npts);
+        vector<double> x1(npts),x2(npts),x3(npts);
+        vector<string> outfiles;
+        int nages=ages.size();
+        for(j=0;j<nages;++j)
+        {
+            spm.rotate(&(xunit[0]),npts,ages[j],&(plat[0]),&(plon[0]),true);
+            for(i=0;i<npts;++i) pr[i]=r0_ellipse(plat[i])-data.depth[i];
+            vtkcoords.cartesian(&(plat[0]),&(plon[0]),&(pr[0]),
+                    &(x1[0]),&(x2[0]),&(x3[0]),npts,true);
+            stringstream ss;
+            ss << outbase << "_" << setw(3) << setfill('0') << j << ".vtk";
+            stringstream title;
+            title << prog << " reconstruction age " << ages[j];
+            write_vtk(ss.str(),title.str(),data,x1,x2,x3);
+            outfiles.push_back(ss.str());
+            if(SEISPP_verbose) cerr << prog << ":  wrote "<<ss.str()
+                <<" for age "<<ages[j]<<endl;
+        }
+        write_series(outbase+".vtk.series",outfiles,ages);
+    }
+    catch (SeisppError& serr)
+    {
+        serr.log_error();
+        exit(-2);
+    }
+    catch (GeoCoordError& gerr)
+    {
+        cerr << gerr.what()<<endl;
+        exit(-3);
+    }
+    catch (GCLgridError& gerr)
+    {
+        cerr << gerr.what()<<endl;
+        exit(-2);
+    }
+}
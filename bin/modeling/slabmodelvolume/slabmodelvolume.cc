@@ -135,7 +135,7 @@ PathArray BuildLithosphereSurface(PathArray& topsurface,double dz,
     base.reserve(npaths);
     int i,j,k;
     MatrixVector tangents,crosslines,normals,ds;
-    Cartesian_point thisnode,lastnode,nextnode;
+    Cartesian_point thisnode,nextnode;
     double length;
     for(i=0;i<npaths;++i)
     {
@@ -146,35 +146,15 @@ PathArray BuildLithosphereSurface(PathArray& topsurface,double dz,
         /* First comput tangents using a forward difference.
            Tangent vectors are indexed starting at 0.  Last point is 
            made a copy of the second to last */
-//DEBUG
-  //      cerr << "Start tangents for flow line "<<i<<endl;
-        for(j=0;j<npts;++j)
+        pathds(0,0)=0.0;
+        for(j=0;j<npts-1;++j)
         {
-            thisnode=topsurface[i].node_position_xyz(j);
-            //DEBUG
-            //cerr << "x,y,z="<<thisnode.x1<<" "<<thisnode.x2<<" "<<thisnode.x3<<endl;
-            if(j==0) 
-            {
-                lastnode=thisnode;
-                pathds(0,j)=0.0;
-            }
-            else
-            {
-                pathtangents(0,j-1)=thisnode.x1-lastnode.x1;
-                pathtangents(1,j-1)=thisnode.x2-lastnode.x2;
-                pathtangents(2,j-1)=thisnode.x3-lastnode.x3;
-                length=unit_vector_normalization(pathtangents.get_address(0,j-1));
-                pathds(0,j)=length;
-                //DEBUG
-                //cerr << "i j distance:  "<<i<<" "<<j<<" "<<length<<endl;
-                /* The size of this test is dependent upon assumed cartesian
-                   coordinates in units of km.  i.e. this means within 1 m */
-                if(fabs(length)<0.001) throw GeoCoordError(base_error
-                        + "Duplicate points in input.  Fix data file");
-                lastnode=thisnode;
-            }
-            //DEBUG
-            //cerr << "tangent " << j-1 << " length="<<length<<endl;
+            length=topsurface[i].node_tangent(j,pathtangents.get_address(0,j));
+            pathds(0,j+1)=length;
+            /* The size of this test is dependent upon assumed cartesian
+               coordinates in units of km.  i.e. this means within 1 m */
+            if(fabs(length)<0.001) throw GeoCoordError(base_error
+                    + "Duplicate points in input.  Fix data file");
         }
         /* Above loop leaves last point unset.  Make it a copy of the second to last */
         for(j=0;j<3;++j) pathtangents(j,npts-1)=pathtangents(j,npts-2);
@@ -251,15 +231,8 @@ PathArray BuildLithosphereSurface(PathArray& topsurface,double dz,
         dmatrix pathnormals(3,npts);
         for(j=0;j<npts;++j)
         {
-            Geographic_point gpthis=topsurface[i].node_position(j);
-            Geographic_point gpdz=gpthis;
-            gpdz.r += 10.0;  // Arbitrary radial upward step size.
-            Cartesian_point cpr=topsurface[i].coordxyz.cartesian(gpthis);
-            Cartesian_point cpdz=topsurface[i].coordxyz.cartesian(gpdz);
             double upvector[3];
-            upvector[0]=cpdz.x1-cpr.x1;
-            upvector[1]=cpdz.x2-cpr.x2;
-            upvector[2]=cpdz.x3-cpr.x3;
+            topsurface[i].node_vertical(j,upvector);
             /* now get the normal vector as cross product of tangent and crossline 
                vectors */
             double rawnormal[3];
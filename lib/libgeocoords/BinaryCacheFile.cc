@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "BinaryCacheFile.h"
+using namespace std;
+/* File layout.   All blocks start on an 8 byte boundary.
+     header:  magic (8 bytes), version (int32), type (int32), key (uint64)
+     each array:  element type (int32), element size (int32),
+                  count (uint64), data padded to a multiple of 8 bytes
+*/
+namespace {
+const char CacheMagic[8]={'G','E','O','C','A','C','H','E'};
+const int32_t CacheVersion(1);
+const int32_t DoubleElement(1);
+const int32_t IntElement(2);
+const int32_t UInt64Element(3);
+struct CacheHeader
+{
+    char magic[8];
+    int32_t version;
+    int32_t type;
+    uint64_t key;
+};
+struct BlockHeader
+{
+    int32_t elementtype;
+    int32_t elementsize;
+    uint64_t count;
+};
+size_t padded_size(size_t n)
+{
+    return((n+7)&(~static_cast<size_t>(7)));
+}
+}  // end anonymous namespace
+
+uint64_t fnv1a_hash(const void *buf, size_t nbytes, uint64_t h)
+{
+    const uint64_t prime(1099511628211ULL);
+    const unsigned char *p=reinterpret_cast<const unsigned char *>(buf);
+    for(size_t i=0;i<nbytes;++i)
+    {
+        h^=static_cast<uint64_t>(p[i]);
+        h*=prime;
+    }
+    return(h);
+}
+string cache_file_name(const string dir, const string prefix, uint64_t key)
+{
+    char keystr[32];
+    snprintf(keystr,32,"%016llx",static_cast<unsigned long long>(key));
+    string result;
+    if(dir.length()>0)
+        result=dir+"/"+prefix+"_"+keystr+".cache";
+    else
+        result=prefix+"_"+keystr+".cache";
+    return(result);
+}
+BinaryCacheWriter::BinaryCacheWriter(const string fn, int type, uint64_t key)
+    : fname(fn)
+{
+    /* mkstemp gives every writer a unique temporary file.  A name 
+       built from the pid alone is shared by threads of one process
+       writing the same key and they would corrupt each other. */
+    tmpname=fname+".tmpXXXXXX";
+    vector<char> tmpl(tmpname.begin(),tmpname.end());
+    tmpl.push_back('\0');
+    int fd=mkstemp(&(tmpl[0]));
+    if(fd<0)
+        throw GeoCoordError(string("BinaryCacheWriter constructor:  ")
+                + "cannot create temporary file "+tmpname);
+    tmpname=string(&(tmpl[0]));
+    /* mkstemp creates the file readable only by the owner.  Cache
+       files are normally shared so use the usual permissions. */
+    fchmod(fd,0644);
+    fp=fdopen(fd,"w");
+    if(fp==NULL)
+    {
+        ::close(fd);
+        unlink(tmpname.c_str());
+        throw GeoCoordError(string("BinaryCacheWriter constructor:  ")
+                + "cannot open temporary file "+tmpname);
+    }
+    failed=false;
+    CacheHeader h;
+    memcpy(h.magic,CacheMagic,8);
+    h.version=CacheVersion;
+    h.type=type;
+    h.key=key;
+    if(fwrite(&h,sizeof(CacheHeader),1,fp)!=1) failed=true;
+}
+BinaryCacheWriter::~BinaryCacheWriter()
+{
+    if(fp!=NULL)
+    {
+        fclose(fp);
+        unlink(tmpname.c_str());
+    }
+}
+void BinaryCacheWriter::write_block(const void *d, size_t n,
+        int elementtype, size_t elementsize)
+{
+    if(fp==NULL)
+    {
+        failed=true;
+        return;
+    }
+    BlockHeader b;
+    b.elementtype=elementtype;
+    b.elementsize=elementsize;
+    b.count=n;
+    if(fwrite(&b,sizeof(BlockHeader),1,fp)!=1) failed=true;
+    size_t nbytes=n*elementsize;
+    if(nbytes>0)
+        if(fwrite(d,1,nbytes,fp)!=nbytes) failed=true;
+    size_t npad=padded_size(nbytes)-nbytes;
+    if(npad>0)
+    {
+        char zeros[8]={0,0,0,0,0,0,0,0};
+        if(fwrite(zeros,1,npad,fp)!=npad) failed=true;
+    }
+}
+void BinaryCacheWriter::write(const double *d, size_t n)
+{
+    write_block(d,n,DoubleElement,sizeof(double));
+}
+void BinaryCacheWriter::write(const int *d, size_t n)
+{
+    write_block(d,n,IntElement,sizeof(int));
+}
+void BinaryCacheWriter::write(const vector<double>& d)
+{
+    if(d.empty())
+        write_block(NULL,0,DoubleElement,sizeof(double));
+    else
+        write_block(&(d[0]),d.size(),DoubleElement,sizeof(double));
+}
+void BinaryCacheWriter::write(const vector<int>& d)
+{
+    if(d.empty())
+        write_block(NULL,0,IntElement,sizeof(int));
+    else
+        write_block(&(d[0]),d.size(),IntElement,sizeof(int));
+}
+void BinaryCacheWriter::write(const uint64_t *d, size_t n)
+{
+    write_block(d,n,UInt64Element,sizeof(uint64_t));
+}
+void BinaryCacheWriter::write(const vector<uint64_t>& d)
+{
+    if(d.empty())
+        write_block(NULL,0,UInt64Element,sizeof(uint64_t));
+    else
+        write_block(&(d[0]),d.size(),UInt64Element,sizeof(uint64_t));
+}
+void BinaryCacheWriter::close()
+{
+    const string base_error("BinaryCacheWriter::close:  ");
+    if(fp==NULL) return;
+    if(fclose(fp)!=0) failed=true;
+    fp=NULL;
+    if(failed)
+    {
+        unlink(tmpname.c_str());
+        throw GeoCoordError(base_error + "write error on file "+tmpname);
+    }
+    if(rename(tmpname.c_str(),fname.c_str()))
+    {
+        unlink(tmpname.c_str());
+        throw GeoCoordError(base_error + "rename to "+fname+" failed");
+    }
+}
+BinaryCacheReader::BinaryCacheReader(const string fn, int type, uint64_t key)
+    : fname(fn)
+{
+    const string base_error("BinaryCacheReader constructor:  ");
+    base=NULL;
+    length=0;
+    offset=0;
+    fd=open(fname.c_str(),O_RDONLY);
+    if(fd<0)
+        throw GeoCoordError(base_error + "cannot open file "+fname);
+    struct stat sb;
+    if(fstat(fd,&sb) || (static_cast<size_t>(sb.st_size)<sizeof(CacheHeader)))
+    {
+        ::close(fd);
+        throw GeoCoordError(base_error + "file "+fname
+                + " is too short to be a cache file");
+    }
+    length=sb.st_size;
+    void *p=mmap(NULL,length,PROT_READ,MAP_SHARED,fd,0);
+    if(p==MAP_FAILED)
+    {
+        ::close(fd);
+        throw GeoCoordError(base_error + "mmap failed for file "+fname);
+    }
+    base=static_cast<char *>(p);
+    const CacheHeader *h=reinterpret_cast<const CacheHeader *>(base);
+    string problem;
+    if(memcmp(h->magic,CacheMagic,8))
+        problem="is not a cache file";
+    else if(h->version!=CacheVersion)
+        problem="has an incompatible version";
+    else if(h->type!=type)
+        problem="holds the wrong type of object";
+    else if(h->key!=key)
+        problem="key does not match";
+    if(problem.length()>0)
+    {
+        munmap(base,length);
+        ::close(fd);
+        throw GeoCoordError(base_error + "file "+fname+" "+problem);
+    }
+    offset=sizeof(CacheHeader);
+}
+BinaryCacheReader::~BinaryCacheReader()
+{
+    munmap(base,length);
+    ::close(fd);
+}
+const void *BinaryCacheReader::next_block(int elementtype, size_t elementsize,
+        size_t& n)
+{
+    const string base_error("BinaryCacheReader:  ");
+    if(offset+sizeof(BlockHeader)>length)
+        throw GeoCoordError(base_error + "file "+fname+" is truncated");
+    const BlockHeader *b=reinterpret_cast<const BlockHeader *>(base+offset);
+    if((b->elementtype!=elementtype)
+            || (b->elementsize!=static_cast<int32_t>(elementsize)))
+        throw GeoCoordError(base_error + "file "+fname
+                + " data type does not match request");
+    offset+=sizeof(BlockHeader);
+    /* The count is tested before it is multiplied so a corrupt count 
+       cannot overflow and pass the size test */
+    size_t remaining=length-offset;
+    if(b->count>remaining/elementsize)
+        throw GeoCoordError(base_error + "file "+fname+" is truncated");
+    n=b->count;
+    size_t nbytes=padded_size(n*elementsize);
+    if(nbytes>remaining)
+        throw GeoCoordError(base_error + "file "+fname+" is truncated");
+    const void *result=base+offset;
+    offset+=nbytes;
+    return(result);
+}
+const double *BinaryCacheReader::next_double(size_t& n)
+{
+    return(static_cast<const double *>(next_block(DoubleElement,
+                    sizeof(double),n)));
+}
+const int *BinaryCacheReader::next_int(size_t& n)
+{
+    return(static_cast<const int *>(next_block(IntElement,sizeof(int),n)));
+}
+const uint64_t *BinaryCacheReader::next_uint64(size_t& n)
+{
+    return(static_cast<const uint64_t *>(next_block(UInt64Element,
+                    sizeof(uint64_t),n)));
+}
+void BinaryCacheReader::read(vector<double>& d)
+{
+    size_t n;
+    const double *p=next_double(n);
+    d.assign(p,p+n);
+}
+void BinaryCacheReader::read(vector<int>& d)
+{
+    size_t n;
+    const int *p=next_int(n);
+    d.assign(p,p+n);
+}
+void BinaryCacheReader::read(vector<uint64_t>& d)
+{
+    size_t n;
+    const uint64_t *p=next_uint64(n);
+    d.assign(p,p+n);
+}
@@ -0,0 +1,140 @@
+#ifndef _BINARYCACHEFILE_H_
+#define _BINARYCACHEFILE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "GeoCoordError.h"
+using namespace std;
+/* Type codes for cache files written by objects in this library.
+   New types should be added at the end. */
+enum CacheFileType {TRIMESH_SURFACE_CACHE=1,SPLINE_SURFACE_CACHE=2,
+    GCLMASK_FILE=3,CRUST1_CACHE=4};
+/* Default starting value for an FNV-1a hash */
+const uint64_t FNV1aOffset(14695981039346656037ULL);
+/*! \brief 64 bit FNV-1a hash of a block of memory.
+
+  Used to build keys for cache files from the data used to build
+  an object.   Call repeatedly passing the previous result as h to
+  hash several blocks.
+  \param buf is the start of the data to hash.
+  \param nbytes is the number of bytes to hash.
+  \param h is the starting hash value (default is the standard FNV-1a
+    offset basis).
+  */
+uint64_t fnv1a_hash(const void *buf, size_t nbytes, uint64_t h=FNV1aOffset);
+/*! \brief Write a binary cache file.
+
+  Objects that are expensive to build can save their internal data
+  in a binary cache file and be reconstructed from it with a
+  BinaryCacheReader.   The file is a short header followed by a
+  sequence of arrays of doubles, ints, or 64 bit words written in 
+  native byte order (little endian on all current platforms).  A file
+  written with a different byte order fails the version check.
+  Every array is aligned on an 8 byte boundary so the file can be
+  memory mapped and the arrays used in place.  The header holds a
+  type code and a key (normally a hash of the input data) that the
+  reader checks to assure a file is not stale.
+
+  Data are written to a temporary file that is renamed to the
+  final name by the close method.   That assures a reader never sees
+  a partially written file, even when several processes build the same
+  cache file at the same time.
+  */
+class BinaryCacheWriter
+{
+public:
+    /*! \brief Open a cache file for writing.
+
+      \param fname is the name of the file to create.
+      \param type is a code for the type of object stored in the file.
+      \param key is the key (usually a content hash) to store in the header.
+      \exception GeoCoordError is thrown if the file cannot be created.
+      */
+    BinaryCacheWriter(const string fname, int type, uint64_t key);
+    /*! Destructor.  Removes the temporary file if close was not called.*/
+    ~BinaryCacheWriter();
+    /*! Append an array of doubles to the file. */
+    void write(const double *d, size_t n);
+    /*! Append an array of ints to the file. */
+    void write(const int *d, size_t n);
+    /*! Append a vector of doubles to the file. */
+    void write(const vector<double>& d);
+    /*! Append a vector of ints to the file. */
+    void write(const vector<int>& d);
+    /*! Append an array of 64 bit words to the file. */
+    void write(const uint64_t *d, size_t n);
+    /*! Append a vector of 64 bit words to the file. */
+    void write(const vector<uint64_t>& d);
+    /*! \brief Finish the file.
+
+      Flushes the data and renames the temporary file to the final name.
+      \exception GeoCoordError is thrown if any write failed.
+      */
+    void close();
+private:
+    string fname;
+    string tmpname;
+    FILE *fp;
+    bool failed;
+    void write_block(const void *d, size_t n, int elementtype, size_t elementsize);
+    /* A file handle cannot be copied */
+    BinaryCacheWriter(const BinaryCacheWriter& parent);
+    BinaryCacheWriter& operator=(const BinaryCacheWriter& parent);
+};
+/*! \brief Read a binary cache file created with BinaryCacheWriter.
+
+  The file is memory mapped.  Arrays can be copied to vectors or
+  accessed in place with the pointer returned by the next_* methods.
+  Pointers into the mapped file are valid only while the reader
+  object exists.
+  */
+class BinaryCacheReader
+{
+public:
+    /*! \brief Open and map a cache file.
+
+      \param fname is the name of the file to read.
+      \param type is the required type code.
+      \param key is the required key.
+      \exception GeoCoordError is thrown if the file does not exist,
+        cannot be mapped, is not a cache file, or if the type or key
+        do not match.
+      */
+    BinaryCacheReader(const string fname, int type, uint64_t key);
+    /*! Destructor.  Unmaps the file.*/
+    ~BinaryCacheReader();
+    /*! \brief Return a pointer to the next array of doubles.
+
+      \param n is set to the number of values in the array.
+      \exception GeoCoordError is thrown if the next array is not
+        doubles or the file is truncated.
+      */
+    const double *next_double(size_t& n);
+    /*! Same as next_double for an array of ints.*/
+    const int *next_int(size_t& n);
+    /*! Same as next_double for an array of 64 bit words.*/
+    const uint64_t *next_uint64(size_t& n);
+    /*! Copy the next array of doubles to a vector. */
+    void read(vector<double>& d);
+    /*! Copy the next array of ints to a vector. */
+    void read(vector<int>& d);
+    /*! Copy the next array of 64 bit words to a vector. */
+    void read(vector<uint64_t>& d);
+private:
+    string fname;
+    int fd;
+    char *base;
+    size_t length;
+    size_t offset;
+    const void *next_block(int elementtype, size_t elementsize, size_t& n);
+    /* Mapped files cannot be copied */
+    BinaryCacheReader(const BinaryCacheReader& parent);
+    BinaryCacheReader& operator=(const BinaryCacheReader& parent);
+};
+/*! \brief Standard name for a cache file.
+
+  Returns dir/prefix_key.cache with the key in hexadecimal.  */
+string cache_file_name(const string dir, const string prefix, uint64_t key);
+#endif
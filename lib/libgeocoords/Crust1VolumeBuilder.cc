@@ -0,0 +1,100 @@
+#include <math.h>
+#include <vector>
+#include "Crust1VolumeBuilder.h"
+using namespace std;
+namespace {
+/* Grids with fewer nodes than this are never split between threads */
+const int C1VThreadThreshold(16384);
+}  // end anonymous namespace
+Crust1VolumeBuilder::Crust1VolumeBuilder(const Crust1_0& m) : model(m)
+{
+    masked=false;
+    nullvalue=0.0;
+}
+void Crust1VolumeBuilder::set_null_value(double nv)
+{
+    nullvalue=nv;
+    masked=true;
+}
+void Crust1VolumeBuilder::clear_null_value()
+{
+    masked=false;
+}
+int Crust1VolumeBuilder::build(GCLscalarfield3d& vp, GCLscalarfield3d& vs,
+        GCLscalarfield3d& rho, bool threaded)
+{
+    try {
+        int n1=vp.n1;
+        int n2=vp.n2;
+        int n3=vp.n3;
+        if((vs.n1!=n1) || (vs.n2!=n2) || (vs.n3!=n3)
+            || (rho.n1!=n1) || (rho.n2!=n2) || (rho.n3!=n3))
+            throw GCLgridError(string("Crust1VolumeBuilder::build:  ")
+                    + "vp, vs, and rho fields do not have the same size");
+        if((n1<=0) || (n2<=0) || (n3<=0)) return(0);
+        threaded=threaded 
+            && (static_cast<size_t>(n1)*n2*n3>C1VThreadThreshold);
+        int ncol=n1*n2;
+        const int nl(Crust1_0::NumLayers);
+        /* Column c=i*n2+j is located by its surface node */
+        vector<double> collat(ncol),collon(ncol);
+        int c;
+#pragma omp parallel for schedule(static) if(threaded)
+        for(c=0;c<ncol;++c)
+        {
+            Geographic_point gp=vp.geo_coordinates(c/n2,c%n2,n3-1);
+            collat[c]=deg(gp.lat);
+            collon[c]=deg(gp.lon);
+        }
+        vector<double> cvp(nl*ncol),cvs(nl*ncol),crho(nl*ncol),ctops(nl*ncol);
+        Crust1Buffers buf;
+        buf.vp=&(cvp[0]);
+        buf.vs=&(cvs[0]);
+        buf.rho=&(crho[0]);
+        buf.tops=&(ctops[0]);
+        model.evaluate(&(collat[0]),&(collon[0]),ncol,
+                Crust1Vp|Crust1Vs|Crust1Density|Crust1LayerTops,buf);
+        /* gtoc of a zero radius is the earth's center for any lat,lon */
+        Cartesian_point center=vp.gtoc(0.0,0.0,0.0);
+        int ninside(0);
+#pragma omp parallel for schedule(static) reduction(+:ninside) if(threaded)
+        for(c=0;c<ncol;++c)
+        {
+            int i=c/n2;
+            int j=c%n2;
+            int k,l;
+            double tops[nl];
+            for(l=0;l<nl;++l) tops[l]=ctops[l*ncol+c];
+            double r0=r0_ellipse(rad(collat[c]));
+            for(k=0;k<n3;++k)
+            {
+                double dx1=vp.x1[i][j][k]-center.x1;
+                double dx2=vp.x2[i][j][k]-center.x2;
+                double dx3=vp.x3[i][j][k]-center.x3;
+                /* Elevation is positive up like the crust1.0 boundaries */
+                double z=sqrt(dx1*dx1+dx2*dx2+dx3*dx3)-r0;
+                bool outside=((z>tops[0]) || (z<=tops[nl-1]));
+                if(outside && masked)
+                {
+                    vp.val[i][j][k]=nullvalue;
+                    vs.val[i][j][k]=nullvalue;
+                    rho.val[i][j][k]=nullvalue;
+                    continue;
+                }
+                if(!outside) ++ninside;
+                /* The layer holding z is the deepest with a top at or 
+                   above z.  Zero thickness layers are passed over
+                   because the layer below has the same top.  Points 
+                   above the surface are clamped to it. */
+                if(z>tops[0]) z=tops[0];
+                int layer(0);
+                for(l=1;l<nl;++l)
+                    if(tops[l]>=z) layer=l;
+                vp.val[i][j][k]=cvp[layer*ncol+c];
+                vs.val[i][j][k]=cvs[layer*ncol+c];
+                rho.val[i][j][k]=crho[layer*ncol+c];
+            }
+        }
+        return(ninside);
+    }catch(...){throw;};
+}
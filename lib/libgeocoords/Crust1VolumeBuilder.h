@@ -0,0 +1,63 @@
+#ifndef _CRUST1VOLUMEBUILDER_H_
+#define _CRUST1VOLUMEBUILDER_H_
+#include "gclgrid.h"
+#include "Crust1_0.h"
+using namespace std;
+/*! \brief Samples CRUST1.0 on the nodes of a 3d grid.
+
+  Builds Vp, Vs, and density volumes from a Crust1_0 model in a single
+  sweep of a grid.  The model is interpolated once for each column of
+  the grid (fixed i,j) with Crust1_0::evaluate and every node of the
+  column is assigned the value of the layer holding its depth.   Columns
+  are assumed radial, which is true of grids built by the GCLgrid3d
+  constructors, so the latitude and longitude of the surface node 
+  (k=n3-1) are used for all nodes of a column.   Depth is measured 
+  from the reference ellipsoid (r0_ellipse) and compared with the 
+  crust1.0 boundary elevations.  The node sweep is split between 
+  threads.
+
+  Nodes below the Moho are given the crust1.0 mantle values and nodes
+  above the surface the values of the uppermost layer of nonzero 
+  thickness.   When a null value is set both are set to the null value
+  instead so the crust can be merged into another model.
+  */
+class Crust1VolumeBuilder
+{
+public:
+    /*! \brief Construct a builder for a model.
+
+      The model is referenced, not copied, so it must exist as long 
+      as this object is used.  Crust1_0::shared() is a good choice.  */
+    Crust1VolumeBuilder(const Crust1_0& model);
+    /*! \brief Flag nodes outside the crust.
+
+      Nodes above the surface or below the Moho are set to nullvalue
+      (e.g. GCLFieldNullValue) in all fields.  */
+    void set_null_value(double nullvalue);
+    /*! Turn off the null value set by set_null_value.  */
+    void clear_null_value();
+    /*! \brief Fill fields with crust1.0 values.
+
+      The fields must have the same dimensions.  The geometry of vp
+      defines the node positions so vs and rho are assumed congruent
+      with it.   Only the val arrays are altered.
+
+      \param vp receives P velocity (km/s).
+      \param vs receives S velocity (km/s).
+      \param rho receives density (g/cc).
+      \param threaded when true (default) large grids are split 
+        between threads.
+
+      \return number of nodes inside the crust (from the surface to
+        the Moho).
+      \exception GCLgridError is thrown if the fields do not have the
+        same dimensions.  SeisppError from Crust1_0 is passed along.
+      */
+    int build(GCLscalarfield3d& vp, GCLscalarfield3d& vs, 
+            GCLscalarfield3d& rho, bool threaded=true);
+private:
+    const Crust1_0& model;
+    bool masked;
+    double nullvalue;
+};
+#endif
@@ -1,34 +1,146 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "stock.h"
 #include "Crust1_0.h"
 #include "gclgrid.h"
 using namespace std;
 using namespace SEISPP;
-/* this helper is a key component of the main constructor */
-void Crust1_0::load_crust1file(double ***y,string fname)
+/* Parses one of the crust1.0 ascii files into y.  The whole file is 
+   read in one block and converted with strtod as that is much faster
+   than ifstream operator >>. */
+void Crust1_0::load_crust1file(vector<double>& y,string fname) const
 {
     int i,j,k;
-    try {
-        ifstream in;
-        in.open(fname.c_str(),std::ifstream::in);
-        /* Note we invert the latitude order to make grid start 
-           at the south pole.  The data file start at 89.5 degrees
-           north.  This makes the origin at -89.5 degrees.*/
-        for(j=nlat-1;j>0;--j)
-            for(i=0;i<nlon;++i)
-                for(k=0;k<nlayers;++k)
-                    in >> y[i][j][k];
-        in.close();
-    }catch(...){throw;};
+    const string base_error("Crust1_0::load_crust1file:  ");
+    ifstream in;
+    in.open(fname.c_str(),std::ifstream::in);
+    if(in.fail())
+        throw SeisppError(base_error+"cannot open file "+fname);
+    ostringstream ss;
+    ss << in.rdbuf();
+    in.close();
+    string buf=ss.str();
+    const char *p=buf.c_str();
+    char *endp;
+    y.resize(nlon*nlat*nlayers);
+    /* Note we invert the latitude order to make grid start 
+       at the south pole.  The data file start at 89.5 degrees
+       north.  This makes the origin at -89.5 degrees.*/
+    for(j=nlat-1;j>=0;--j)
+        for(i=0;i<nlon;++i)
+            for(k=0;k<nlayers;++k)
+            {
+                double val=strtod(p,&endp);
+                if(endp==p)
+                    throw SeisppError(base_error+"read error in file "
+                            +fname);
+                y[(i*nlat+j)*nlayers+k]=val;
+                p=endp;
+            }
+}
+/* For efficiency we compute thicknesses at each node as
+   there are frequent zero thickness layers in this beast.
+   Note the difference in count of 1 for intervals 
+   compared to points.  Thickness references the layer 
+   below each top.   Also note depth is a bit of a 
+   misnomer as the boundaries are tabulated with positive
+   up (Moho always has a negative depth value).*/
+void Crust1_0::compute_thickness(const double *depth, vector<double>& dz) const
+{
+    dz.resize(nlon*nlat*nlayers);
+    for(int ij=0;ij<nlon*nlat;++ij)
+    {
+        const double *tops=depth+ij*nlayers;
+        double *t=&(dz[ij*nlayers]);
+        for(int k=0;k<nlayers-1;++k)
+            t[k]=tops[k]-tops[k+1];
+        /* set to large value to allow a test for
+           zero thickness to not incorrectly skip */
+        t[nlayers-1]=6000.0;
+    }
 }
-Crust1_0::Crust1_0()
+/* The key for the cache file is built from the size and modification 
+   time of the ascii files so editing or replacing them invalidates
+   the cache without having to read them. */
+uint64_t Crust1_0::cache_key()
+{
+    int dims[3]={nlon,nlat,nlayers};
+    uint64_t key=fnv1a_hash(dims,sizeof(dims));
+    for(int p=0;p<DepthGrid+1;++p)
+    {
+        struct stat sb;
+        if(stat(datafile[p].c_str(),&sb))
+            throw SeisppError(string("Crust1_0:  cannot stat file ")
+                    +datafile[p]);
+        int64_t fileid[2];
+        fileid[0]=static_cast<int64_t>(sb.st_size);
+        fileid[1]=static_cast<int64_t>(sb.st_mtime);
+        key=fnv1a_hash(fileid,sizeof(fileid),key);
+    }
+    return(key);
+}
+/* Maps the cache file.  Returns false if it is missing or stale. */
+bool Crust1_0::load_cache(const string fname, uint64_t key)
+{
+    try{
+        cache=boost::shared_ptr<BinaryCacheReader>
+            (new BinaryCacheReader(fname,CRUST1_CACHE,key));
+        size_t npts=nlon*nlat*nlayers;
+        for(int p=0;p<NumGrids;++p)
+        {
+            size_t n;
+            grid[p]=cache->next_double(n);
+            if(n!=npts) throw GeoCoordError("cache file grid size is wrong");
+        }
+        return(true);
+    }catch(GeoCoordError& err)
+    {
+        cache.reset();
+        for(int p=0;p<NumGrids;++p) grid[p]=NULL;
+        return(false);
+    }
+}
+/* Parses all the ascii files and saves them to a cache file.  The 
+   parsed grids are kept so this run does not need to map the file. */
+void Crust1_0::build_cache(const string fname, uint64_t key)
+{
+    for(int p=0;p<NumGrids;++p) this->get_grid(p);
+    try{
+        BinaryCacheWriter out(fname,CRUST1_CACHE,key);
+        for(int p=0;p<NumGrids;++p) out.write(*(storage[p]));
+        out.close();
+    }catch(GeoCoordError& err)
+    {
+        cerr << "Crust1_0:  could not save cache file "<<fname<<endl
+            << err.what()<<endl;
+    }
+}
+/* Returns the array for a property loading it from the ascii file
+   the first time it is needed if the model is not cached. */
+const double *Crust1_0::get_grid(int property) const
+{
+    if(grid[property]!=NULL) return(grid[property]);
+    boost::shared_ptr<vector<double> > y(new vector<double>);
+    if(property==ThicknessGrid)
+        compute_thickness(this->get_grid(DepthGrid),*y);
+    else
+        load_crust1file(*y,datafile[property]);
+    storage[property]=y;
+    grid[property]=&((*y)[0]);
+    return(grid[property]);
+}
+Crust1_0::Crust1_0(string cachedir)
 {
     /* Could not how to initialize these in the .h file without generating a warning
        with gcc. These would be more appropriate as const parameteters */
     nlon=360;
     nlat=180;
-    nlayers=9;
+    nlayers=NumLayers;
     dlon=1.0;
     dlat=1.0;
     /* Note the data in the file actually start at N 89.5.   I reverse the order of storage
@@ -36,105 +148,84 @@ Crust1_0::Crust1_0()
        anyway) upside down y axis. */
     lat0=-89.5;
     lon0=-179.5;
+    int p;
+    for(p=0;p<NumGrids;++p) grid[p]=NULL;
     const string base_error("Crust1_0 constructor:  ");
-    char *vpfile=datapath(NULL,"crust1.0","crust1","vp");
-    if(vpfile==NULL) 
-        throw SeisppError(base_error+"datapath failed search for crust1.vp file");
-    char *vsfile=datapath(NULL,"crust1.0","crust1","vs");
-    /* This and the next 2 similar tests are very unlikely to every be
-       thrown.  If any of these throw they will generate a small memory 
-       leak, but the extra coding required to fix that is not justified.*/
-    if(vsfile==NULL) 
-        throw SeisppError(base_error+"datapath failed search for crust1.vs file");
-    char *rhofile=datapath(NULL,"crust1.0","crust1","rho");
-    if(rhofile==NULL) 
-        throw SeisppError(base_error+"datapath failed search for crust1.rho file");
-    char *bndsfile=datapath(NULL,"crust1.0","crust1","bnds");
-    if(bndsfile==NULL) 
-        throw SeisppError(base_error+"datapath failed search for crust1.bnds file");
-    /* crust1.0 has a frozen structure with nothing in the file at all 
-       linked to critical parameters.  In particular, the size of the grid
-       is frozen and not in the file.   Here we deal with that using
-       const int values in the private area of the object.   We use
-       these now to create the work areas. */
-    try{
-        vp=create_3dgrid_contiguous(nlon,nlat,nlayers);
-        if(vp==NULL) throw SeisppError(base_error
-                + "alloc failed for vp grid array");
-        vs=create_3dgrid_contiguous(nlon,nlat,nlayers);
-        if(vs==NULL) throw SeisppError(base_error
-                + "alloc failed for vs grid array");
-        rho=create_3dgrid_contiguous(nlon,nlat,nlayers);
-        if(rho==NULL) throw SeisppError(base_error
-                + "alloc failed for rho grid array");
-        depth=create_3dgrid_contiguous(nlon,nlat,nlayers);
-        if(depth==NULL) throw SeisppError(base_error
-                + "alloc failed for depth grid array");
-        /* This will have an extra component, but easier to leave
-           to allow interpolator to work with this array like
-           the other arrays */
-        thickness=create_3dgrid_contiguous(nlon,nlat,nlayers);
-        if(thickness==NULL) throw SeisppError(base_error
-                + "alloc failed for thickness grid array");
-    /* Load the model files using the private method load_crust1file */
-        load_crust1file(vp,vpfile);
-        load_crust1file(vs,vsfile);
-        load_crust1file(rho,rhofile);
-        load_crust1file(depth,bndsfile);
-        /* For efficiency we compute thicknesses at each node as
-           there are frequent zero thickness layers in this beast.
-           Note the difference in count of 1 for intervals 
-           compared to points.  Thickness references the layer 
-           below each top.   Also note depth is a bit of a 
-           misnomer as the boundaries are tabulated with positive
-           up (Moho always has a negative depth value).*/
-        for(int i=0;i<nlon;++i)
-            for(int j=0;j<nlat;++j)
-            {
-                for(int k=0;k<8;++k)
-                    thickness[i][j][k]=depth[i][j][k]
-                                        - depth[i][j][k+1];
-                /* set to large value to allow a test for
-                   zero thickness to not incorrectly skip */
-                thickness[i][j][8]=6000.0;
-            }
-
-        free(vpfile);
-        free(vsfile);
-        free(rhofile);
-        free(bndsfile);
-    }catch(...){throw;};
-}
-int Crust1_0::lookup_lon(double lon)
-{
-    /* Force lon to be between -180 and 180.   A bit excessive 
-    here deal with absurd requests */
-    int i;
-    const int maxtries(10);
-    i=0;
-    double maxlon=lon0+static_cast<double>(nlon-1)*dlon;
-    while(maxlon>180.0 && i<maxtries)
+    const char *suffix[4]={"vp","vs","rho","bnds"};
+    for(p=0;p<DepthGrid+1;++p)
     {
-        lon -= 360.0;
-        ++i;
+        char *fname=datapath(NULL,"crust1.0","crust1",suffix[p]);
+        if(fname==NULL) 
+            throw SeisppError(base_error+"datapath failed search for crust1."
+                    +suffix[p]+" file");
+        datafile[p]=string(fname);
+        free(fname);
     }
-    i=0;
-    while(lon<lon0 && i<maxtries)
+    if(cachedir.length()==0)
     {
-        lon += 360.0;
-        ++i;
+        size_t slash=datafile[VpGrid].rfind('/');
+        if(slash==string::npos)
+            cachedir=".";
+        else
+            cachedir=datafile[VpGrid].substr(0,slash);
     }
-    int result=(int) (lon-lon0)/dlon;
-    return result;
+    uint64_t key=cache_key();
+    string cachefile=cache_file_name(cachedir,"crust1",key);
+    if(load_cache(cachefile,key)) return;
+    /* Without write permission each property is parsed when needed */
+    if(access(cachedir.c_str(),W_OK)==0) build_cache(cachefile,key);
 }
-int Crust1_0::lookup_lat(double lat)
+/* Every property is loaded before the instance is published so no 
+   thread can see it partly built.  After that it is never modified.
+   It is never deleted. */
+const Crust1_0& Crust1_0::load_shared()
 {
-    int result=(int) (lat-lat0)/dlat;
-    /* nlat-1 used because we require finding point at lower left of 
+    Crust1_0 *m=new Crust1_0();
+    try{
+        for(int p=0;p<NumGrids;++p) m->get_grid(p);
+    }catch(...)
+    {
+        delete m;
+        throw;
+    };
+    return(*m);
+}
+/* Initialization of a function local static is done exactly once and
+   is safe with any kind of thread.  Only the first calls wait for it.
+   If load_shared throws the exception reaches the caller unaltered
+   and the next call tries again. */
+const Crust1_0& Crust1_0::shared()
+{
+    static const Crust1_0& instance=Crust1_0::load_shared();
+    return(instance);
+}
+/* Longitudes are wrapped into the grid range so any multiple of 360 
+   degrees is accepted.  Points north of the last latitude row or south
+   of the first are clamped to the nearest row as crust1.0 has no 
+   tabulated values at the poles. */
+void Crust1_0::locate(double lat, double lon, int& i0, int& i1, int& j,
+        double& tx, double& ty) const
+{
+    /* Written to also reject NaNs */
+    if(!((lat>=-90.0) && (lat<=90.0)))
+        throw SeisppError(string("Crust1_0::locate: illegal latitude"));
+    double x=fmod(lon-lon0,360.0);
+    if(x<0.0) x+=360.0;
+    x/=dlon;
+    if(!((x>=0.0) && (x<=static_cast<double>(nlon))))
+        throw SeisppError(string("Crust1_0::locate: illegal longitude"));
+    i0=static_cast<int>(x);
+    if(i0>=nlon) i0=nlon-1;
+    tx=x-static_cast<double>(i0);
+    i1=(i0+1)%nlon;
+    double y=(lat-lat0)/dlat;
+    if(y<0.0) y=0.0;
+    /* nlat-2 used because we require finding point at lower left of 
        grid square to interpolate.*/
-    if( (result<0) || (result>(nlat-1)) ) 
-        throw SeisppError(string("Crust1_0::lookup_lat: illegal latitude"));
-    return result;
+    j=static_cast<int>(y);
+    if(j>(nlat-2)) j=nlat-2;
+    ty=y-static_cast<double>(j);
+    if(ty>1.0) ty=1.0;
 }
 /* Use bilinear interpolator for model components.  Complication 
    is that Crust1.0 has zero entries in places that we have to 
@@ -142,71 +233,82 @@ int Crust1_0::lookup_lat(double lat)
    and revert to nearest neighbor if any are zero.  Will return
    zero if zero node is closest.
 
+    y is a property grid with nlat latitudes and nlayers layers stored
+    with the layer index varying fastest.  i0 and i1 are the longitude
+    indices of the two sides of the cell (i1 wraps to 0 at the date line)
+    and j is the latitude index of the lower side.  Results are stored 
+    in result which must have nlayers elements.
+
     Note dlon and dlat are normalized delta latitude and delta longitude
     That is, range is 0 to 1 */
-double *interpolate_model_grid(double ***y,int i, int j, 
-        double dlon, double dlat)
+void interpolate_model_grid(const double *y, int nlat, int nlayers,
+        int i0, int i1, int j, double dlon, double dlat, double *result)
 {
     /* The nearest neighbor algorithm requires this test to avoid
        disaster */
     if((dlon<0.0) || (dlon>1.01) || (dlat<0.0) || (dlat>1.01))
         throw SeisppError(string("Crust1_0:  interpolate_model_grid")
               + "illegal delta latitude and/or delta longitude values passed");
-    double *result=new double[9];
     /* We blindly assume the i and j values are valid */
-    int k,ii,jj;
+    const double *c00=y+(i0*nlat+j)*nlayers;
+    const double *c10=y+(i1*nlat+j)*nlayers;
+    const double *c01=c00+nlayers;
+    const double *c11=c10+nlayers;
+    int k;
     bool has_a_zero(false);
-    for(k=0;k<9;++k)
+    for(k=0;k<nlayers;++k)
     {
-        for(ii=i;ii<i+2;++ii)
-            for(jj=j;jj<j+2;++jj)
-                if(fabs(y[ii][jj][k])<0.01)
-                {
-                    has_a_zero=true;
-                    break;
-                }
-
+        /* Once set this stays set for deeper layers as in the
+           original implementation */
+        if((fabs(c00[k])<0.01) || (fabs(c10[k])<0.01)
+                || (fabs(c01[k])<0.01) || (fabs(c11[k])<0.01))
+            has_a_zero=true;
         if(has_a_zero)
         {
-            result[k]=y[i+SEISPP::nint(dlon)][j+SEISPP::nint(dlat)][k];
+            const double *c=(SEISPP::nint(dlon) ? c10 : c00);
+            if(SEISPP::nint(dlat)) c+=nlayers;
+            result[k]=c[k];
         }
         else
         {
-            result[k]=bilinear<double>(dlon,dlat,y[i][j][k],y[i+1][j][k],
-                y[i][j+1][k],y[i+1][j+1][k]);
+            result[k]=bilinear<double>(dlon,dlat,c00[k],c10[k],
+                c01[k],c11[k]);
         }
     }
-    return result;
 }
-VelocityModel_1d Crust1_0::model(double lat, double lon, string property)
+VelocityModel_1d Crust1_0::model(double lat, double lon, string property) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *dz,*y;
-        dz=interpolate_model_grid(thickness,i,j,deltalon,deltalat);
-        double *layertops;
-        layertops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        int ip;
         if(property=="Pvelocity" || property=="Vp")
-            y=interpolate_model_grid(vp,i,j,deltalon,deltalat);
-        else if(property=="Svelocity" || property=="Vp")
-            y=interpolate_model_grid(vs,i,j,deltalon,deltalat);
+            ip=VpGrid;
+        else if(property=="Svelocity" || property=="Vs")
+            ip=VsGrid;
         else if(property=="Density" || property=="rho")
-            y=interpolate_model_grid(rho,i,j,deltalon,deltalat);
-        VelocityModel_1d result(9);
+            ip=RhoGrid;
+        else
+            throw SeisppError(string("Crust1_0::model:  ")
+                    + "illegal property name="+property);
+        double dz[NumLayers],y[NumLayers],layertops[NumLayers];
+        interpolate_model_grid(get_grid(ThicknessGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,dz);
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,layertops);
+        interpolate_model_grid(get_grid(ip),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,y);
+        VelocityModel_1d result(NumLayers);
         int k;
-        for(k=0;k<9;++k)
+        for(k=0;k<NumLayers;++k)
         {
             /* Skip any zero thickness layers and those with zero
                propeties.   (tested against a small value).
                This happens frequently in crust1.0.
                Magic numbers assume units of km and seconds.
                */
-            if(((fabs(dz[k])>0.001)) && (fabs(y[k]>0.01)))
+            if((fabs(dz[k])>0.001) && (fabs(y[k])>0.01))
             {
                 result.v.push_back(y[k]);
                 /* Reverse sign of layertops because the VelocityModel_1d
@@ -216,97 +318,149 @@ VelocityModel_1d Crust1_0::model(double lat, double lon, string property)
                 result.grad.push_back(0.0);
             }
         }
-        //DEBUG
-        /*
-        for(k=0;k<result.v.size();++k)
-            cout << k <<" "<< result.v[k]<<" "<<result.z[k]<<endl;
-            */
         result.nlayers=result.v.size();
-        delete [] dz;
-        delete [] y;
-        delete [] layertops;
         return result;
     }catch(...){throw;};
 }
-double Crust1_0::CrustalThickness(double lat, double lon)
+double Crust1_0::CrustalThickness(double lat, double lon) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *tops;
-        tops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
-        double dz=tops[0]-tops[8];
-        delete [] tops;
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        double tops[NumLayers];
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,tops);
+        double dz=tops[0]-tops[NumLayers-1];
         return(dz);
     }catch(...){throw;};
 }
-double Crust1_0::MohoDepth(double lat, double lon)
+double Crust1_0::MohoDepth(double lat, double lon) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *tops;
-        tops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
-        double z=-tops[8];
-        delete [] tops;;
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        double tops[NumLayers];
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,tops);
+        double z=-tops[NumLayers-1];
         return(z);
     }catch(...){throw;};
 }
-double Crust1_0::SedimentThickness(double lat, double lon)
+double Crust1_0::SedimentThickness(double lat, double lon) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *tops;
-        tops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        double tops[NumLayers];
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,tops);
         double dz=tops[2]-tops[5];
-        delete [] tops;
         return(dz);
     }catch(...){throw;};
 }
-double Crust1_0::WaterDepth(double lat, double lon)
+double Crust1_0::WaterDepth(double lat, double lon) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *tops;
-        tops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        double tops[NumLayers];
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,tops);
         double z=tops[0]-tops[1];
-        delete [] tops;
         return(z);
     }catch(...){throw;};
 }
-double Crust1_0::IceThickness(double lat, double lon)
+double Crust1_0::IceThickness(double lat, double lon) const
 {
     try {
-        int i,j;
-        i=lookup_lon(lon);
-        j=lookup_lat(lat);
+        int i0,i1,j;
         double deltalat,deltalon;
-        deltalat=(lat - (lat0+dlat*static_cast<double>(j)))/dlat;
-        deltalon=(lon - (lon0+dlon*static_cast<double>(i)))/dlon;
-        double *tops;
-        tops=interpolate_model_grid(depth,i,j,deltalon,deltalat);
+        locate(lat,lon,i0,i1,j,deltalon,deltalat);
+        double tops[NumLayers];
+        interpolate_model_grid(get_grid(DepthGrid),nlat,nlayers,
+                i0,i1,j,deltalon,deltalat,tops);
         /* It appears we have to use the second field or we get bogus
            ice thickness values in oceanic crust. */
         double dz=tops[1] - tops[2];
-        delete [] tops;;
         return(dz);
     }catch(...){throw;};
 }
+namespace {
+/* Grid and output buffer for one property handled by evaluate */
+struct BatchProperty
+{
+    const double *y;
+    double *out;
+};
+/* Same algorithm as interpolate_model_grid for all layers of one point
+   with the bilinear weights computed once.  w is the four weights in 
+   the order c00, c10, c01, c11 and cn is the offset from c00 to the
+   nearest corner.   Layers above the first with a zero at a corner 
+   are a branch free loop over layers the compiler can vectorize. */
+inline void interpolate_layers(const double *c00, const double *c10,
+        const double *w, int offset01, int cn, double *result)
+{
+    const double *c01=c00+offset01;
+    const double *c11=c10+offset01;
+    int k,kz;
+    for(kz=0;kz<Crust1_0::NumLayers;++kz)
+        if((fabs(c00[kz])<0.01) || (fabs(c10[kz])<0.01)
+                || (fabs(c01[kz])<0.01) || (fabs(c11[kz])<0.01)) break;
+    for(k=0;k<kz;++k)
+        result[k]=w[0]*c00[k]+w[1]*c10[k]+w[2]*c01[k]+w[3]*c11[k];
+    const double *c=c00+cn;
+    for(;k<Crust1_0::NumLayers;++k) result[k]=c[k];
+}
+}  // end anonymous namespace
+int Crust1_0::evaluate(const double *lat, const double *lon, int n,
+        int properties, Crust1Buffers& out) const
+{
+    const string base_error("Crust1_0::evaluate:  ");
+    const int gridid[5]={VpGrid,VsGrid,RhoGrid,DepthGrid,ThicknessGrid};
+    const int flags[5]={Crust1Vp,Crust1Vs,Crust1Density,Crust1LayerTops,
+        Crust1LayerThickness};
+    double *buffers[5]={out.vp,out.vs,out.rho,out.tops,out.thickness};
+    BatchProperty props[5];
+    int np(0),ip;
+    for(ip=0;ip<5;++ip)
+    {
+        if(!(properties & flags[ip])) continue;
+        if(buffers[ip]==NULL)
+            throw SeisppError(base_error
+                    + "NULL output buffer for a requested property");
+        props[np].y=get_grid(gridid[ip]);
+        props[np].out=buffers[ip];
+        ++np;
+    }
+    /* In the flat grids stepping one cell north is nlayers values */
+    const int offset01(nlayers);
+    for(int p=0;p<n;++p)
+    {
+        int i0,i1,j;
+        double tx,ty;
+        locate(lat[p],lon[p],i0,i1,j,tx,ty);
+        /* Same expressions as bilinear so results match model */
+        double w[4];
+        w[0]=(1.0-tx)*(1.0-ty);
+        w[1]=tx*(1.0-ty);
+        w[2]=(1.0-tx)*ty;
+        w[3]=tx*ty;
+        int c00=(i0*nlat+j)*nlayers;
+        int c10=(i1*nlat+j)*nlayers;
+        int cn=(SEISPP::nint(tx) ? c10-c00 : 0);
+        if(SEISPP::nint(ty)) cn+=offset01;
+        for(ip=0;ip<np;++ip)
+        {
+            double result[NumLayers];
+            interpolate_layers(props[ip].y+c00,props[ip].y+c10,w,
+                    offset01,cn,result);
+            double *dst=props[ip].out+p;
+            for(int k=0;k<NumLayers;++k) dst[k*n]=result[k];
+        }
+    }
+    return(n);
+}
@@ -1,13 +1,84 @@
 #ifndef _CRUST_1_0_
 #define _CRUST_1_0_
 #include <string>
+#include <vector>
+#include <boost/smart_ptr.hpp>
 #include "VelocityModel_1d.h"
+#include "BinaryCacheFile.h"
 using namespace std;
+/*! \brief Property selectors for Crust1_0::evaluate.
+
+  Values are bit flags so several properties are requested by 
+  combining them with |.  */
+enum Crust1Property {Crust1Vp=1, Crust1Vs=2, Crust1Density=4, 
+    Crust1LayerTops=8, Crust1LayerThickness=16};
+/*! \brief Caller supplied output buffers for Crust1_0::evaluate.
+
+  Each buffer holds Crust1_0::NumLayers rows of n values stored 
+  layer by layer (structure of arrays).   That is, the value for layer 
+  k at point p is at buffer[k*n+p] so a single layer (e.g. the mantle 
+  below the Moho at k=NumLayers-1) is a contiguous array.  Only buffers
+  for requested properties are used and the others can be NULL.  
+  Layer tops are elevations in km (positive up) as in the crust1.0 
+  boundary file.  */
+struct Crust1Buffers
+{
+    double *vp;
+    double *vs;
+    double *rho;
+    double *tops;
+    double *thickness;
+    Crust1Buffers() : vp(NULL),vs(NULL),rho(NULL),tops(NULL),thickness(NULL){};
+};
+/*! \brief Interface to the CRUST1.0 global crustal model.
+
+  The model is distributed as four ascii files (crust1.vp, crust1.vs,
+  crust1.rho, and crust1.bnds) that are slow to parse.   The first 
+  time the model is used the files are parsed and saved to a binary
+  cache file.   Later uses memory map that file so startup is nearly
+  instant and the pages are shared by all processes using the model.
+  Each property is located only when a method first needs it so, 
+  for example, a program that only asks for Moho depths never reads 
+  the velocity tables.   If the cache cannot be written each ascii 
+  file is parsed when its property is first needed.
+
+  Copies share the model data.
+
+  Programs that query the model from several threads should use the
+  process wide instance returned by shared().   It is created the 
+  first time it is requested with every property loaded so all the 
+  query methods (model, evaluate, MohoDepth, etc.) are const and only
+  read the model.  Any number of threads can call them concurrently 
+  without locking.  A private instance loads each property the first 
+  time it is needed and is only safe for concurrent queries after 
+  every property used has been loaded once.
+  */
 class Crust1_0
 {
 public:
-    Crust1_0();
-    //Crust1_0(const Crust1_0& parent);
+    /*! Number of layers (including the mantle) at each grid point. */
+    enum {NumLayers=9};
+    /*! \brief Construct the model.
+
+      \param cachedir is the directory for the binary cache file.  The
+        default (empty string) uses the directory holding the crust1.0
+        data files.  The cache is rebuilt automatically if the data
+        files change.   If the directory is not writable the model is
+        read from the ascii files.
+      \exception SeisppError is thrown if the data files cannot be
+        found.
+      */
+    Crust1_0(string cachedir="");
+    /*! \brief Return the process wide instance of the model.
+
+      The instance is created with the default cache directory on the
+      first call.  Later calls, from any thread, return the same 
+      object.   Its methods are safe to call concurrently.
+
+      \exception SeisppError is thrown if the model cannot be loaded.
+        The next call will try again.
+      */
+    static const Crust1_0& shared();
     /*! \brief Return an interpolated 1d model at a specified point.
 
       This method returns a model component as VelocityModel_1d object
@@ -22,12 +93,34 @@ public:
       \exception - throws a SeisppError for an invalid property or illegal
          point.
       */
-    VelocityModel_1d model(double lat, double lon, string property);
-    double CrustalThickness(double lat, double lon);
-    double MohoDepth(double lat, double lon);
-    double SedimentThickness(double lat, double lon);
-    double WaterDepth(double lat, double lon);
-    double IceThickness(double lat, double lon);
+    VelocityModel_1d model(double lat, double lon, string property) const;
+    double CrustalThickness(double lat, double lon) const;
+    double MohoDepth(double lat, double lon) const;
+    double SedimentThickness(double lat, double lon) const;
+    double WaterDepth(double lat, double lon) const;
+    double IceThickness(double lat, double lon) const;
+    /*! \brief Evaluate the model at many points in one pass.
+
+      This is the efficient interface for building grids.   Each point
+      is located once and every requested property is interpolated for
+      all layers from the same cell without building VelocityModel_1d
+      objects.  Unlike model zero thickness layers are not removed.
+      Values are identical to those used by model and the scalar 
+      methods (e.g. MohoDepth is -tops[(NumLayers-1)*n+p]).  
+
+      \param lat - array of n latitudes (degrees)
+      \param lon - array of n longitudes (degrees)
+      \param n - number of points
+      \param properties - Crust1Property values combined with |
+      \param out - buffers for the requested properties.  Each must
+        have room for NumLayers*n values.
+
+      \return number of points evaluated (n)
+      \exception SeisppError is thrown for an illegal latitude or if
+        a requested buffer is NULL.
+      */
+    int evaluate(const double *lat, const double *lon, int n, 
+            int properties, Crust1Buffers& out) const;
 private:
     /* This set of parameters is presently frozen and defined by the 
        data files for crust1.0.   They are set in the constructor 
@@ -35,16 +128,33 @@ private:
     int nlon,nlat,nlayers; // grid dimensions
     double lat0,lon0;  // location of [0][0] point
     double dlon,dlat;  // grid spacing in degrees
-    /* These simplify lookup.  They return the integer for binlinear
-       interpolation of lon/lat */
-    int lookup_lon(double lon);
-    int lookup_lat(double lat);
-    double ***vp;
-    double ***vs;
-    double ***rho;
-    double ***depth;
-    double ***thickness;
-    void load_crust1file(double ***x,string fname);
+    /* Finds the grid cell holding a point.  i0 and i1 are the west and
+       east longitude indices (i1 wraps at the date line), j is the 
+       latitude index of the south side, and tx and ty are the 
+       normalized (0 to 1) position in the cell.   */
+    void locate(double lat, double lon, int& i0, int& i1, int& j,
+            double& tx, double& ty) const;
+    /* Model properties in the order they are stored in the cache.
+       Each is an nlon by nlat by nlayers array with the layer index
+       varying fastest.  Boundaries are the layer tops as elevations 
+       and thicknesses are computed from them.  */
+    enum {VpGrid=0, VsGrid, RhoGrid, DepthGrid, ThicknessGrid, NumGrids};
+    /* Ascii data file for each property (empty for thickness) */
+    string datafile[NumGrids];
+    /* Property arrays.  NULL until a method first needs them.  These
+       are mutable because the const query methods load them. */
+    mutable const double *grid[NumGrids];
+    /* Storage for grids parsed from ascii files */
+    mutable boost::shared_ptr<vector<double> > storage[NumGrids];
+    /* Mapped cache file when the model was loaded from one */
+    boost::shared_ptr<BinaryCacheReader> cache;
+    const double *get_grid(int property) const;
+    static const Crust1_0& load_shared();
+    void load_crust1file(vector<double>& y, string fname) const;
+    void compute_thickness(const double *depth, vector<double>& dz) const;
+    uint64_t cache_key();
+    bool load_cache(const string fname, uint64_t key);
+    void build_cache(const string fname, uint64_t key);
 };
 /* Generic algorithm to do binlinear interpolator of a gridded 2d data.  
 
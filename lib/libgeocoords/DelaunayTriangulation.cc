@@ -0,0 +1,974 @@
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "DelaunayTriangulation.h"
+using namespace std;
+/* Robust geometric predicates.  These follow Shewchuk (1997, Discrete
+   and Computational Geometry, 18, 305-363).  The fast floating point
+   determinant is used when an error bound shows the sign is certain.
+   Otherwise the determinant is recomputed exactly with expansion
+   arithmetic.  The exact versions here are the simple (nonadaptive)
+   form of Shewchuk's algorithms.  Expansions are held in fixed size
+   arrays on the stack because gridded input can call the exact 
+   versions millions of times.  The sizes are the worst case for 
+   products of two component differences. */
+namespace {
+/* machine epsilon and splitter as defined by Shewchuk */
+double epsilon_value()
+{
+    return(DBL_EPSILON*0.5);
+}
+const double Splitter(134217729.0);   // 2^27+1 for double
+/* Maximum length of an expansion for the two size classes used below */
+const int MaxSmallExpansion(32);
+const int MaxLargeExpansion(2048);
+inline void fast_two_sum(double a, double b, double& x, double& y)
+{
+    x=a+b;
+    double bvirt=x-a;
+    y=b-bvirt;
+}
+inline void two_sum(double a, double b, double& x, double& y)
+{
+    x=a+b;
+    double bvirt=x-a;
+    double avirt=x-bvirt;
+    double bround=b-bvirt;
+    double around=a-avirt;
+    y=around+bround;
+}
+inline void two_diff(double a, double b, double& x, double& y)
+{
+    x=a-b;
+    double bvirt=a-x;
+    double avirt=x+bvirt;
+    double bround=bvirt-b;
+    double around=a-avirt;
+    y=around+bround;
+}
+inline void split(double a, double& ahi, double& alo)
+{
+    double c=Splitter*a;
+    double abig=c-a;
+    ahi=c-abig;
+    alo=a-ahi;
+}
+inline void two_product(double a, double b, double& x, double& y)
+{
+    x=a*b;
+    double ahi,alo,bhi,blo;
+    split(a,ahi,alo);
+    split(b,bhi,blo);
+    double err1=x-(ahi*bhi);
+    double err2=err1-(alo*bhi);
+    double err3=err2-(ahi*blo);
+    y=(alo*blo)-err3;
+}
+/* Sum of two expansions eliminating zero components 
+   (Shewchuk's fast_expansion_sum_zeroelim).  h must have room 
+   for elen+flen values.  Returns length of h. */
+int expansion_sum(int elen, const double *e, int flen, const double *f, 
+        double *h)
+{
+    double q,qnew,hh;
+    int ei(0),fi(0),hi(0);
+    double enow=e[0];
+    double fnow=f[0];
+    if((fnow>enow)==(fnow>-enow))
+    {
+        q=enow;
+        ++ei;
+        if(ei<elen) enow=e[ei];
+    }
+    else
+    {
+        q=fnow;
+        ++fi;
+        if(fi<flen) fnow=f[fi];
+    }
+    if((ei<elen) && (fi<flen))
+    {
+        if((fnow>enow)==(fnow>-enow))
+        {
+            fast_two_sum(enow,q,qnew,hh);
+            ++ei;
+            if(ei<elen) enow=e[ei];
+        }
+        else
+        {
+            fast_two_sum(fnow,q,qnew,hh);
+            ++fi;
+            if(fi<flen) fnow=f[fi];
+        }
+        q=qnew;
+        if(hh!=0.0) h[hi++]=hh;
+        while((ei<elen) && (fi<flen))
+        {
+            if((fnow>enow)==(fnow>-enow))
+            {
+                two_sum(q,enow,qnew,hh);
+                ++ei;
+                if(ei<elen) enow=e[ei];
+            }
+            else
+            {
+                two_sum(q,fnow,qnew,hh);
+                ++fi;
+                if(fi<flen) fnow=f[fi];
+            }
+            q=qnew;
+            if(hh!=0.0) h[hi++]=hh;
+        }
+    }
+    while(ei<elen)
+    {
+        two_sum(q,enow,qnew,hh);
+        ++ei;
+        if(ei<elen) enow=e[ei];
+        q=qnew;
+        if(hh!=0.0) h[hi++]=hh;
+    }
+    while(fi<flen)
+    {
+        two_sum(q,fnow,qnew,hh);
+        ++fi;
+        if(fi<flen) fnow=f[fi];
+        q=qnew;
+        if(hh!=0.0) h[hi++]=hh;
+    }
+    if((q!=0.0) || (hi==0)) h[hi++]=q;
+    return(hi);
+}
+/* Multiply an expansion by a scalar eliminating zero components.
+   h must have room for 2*elen values. */
+int scale_expansion(int elen, const double *e, double b, double *h)
+{
+    double q,hh,product1,product0,sum;
+    int hi(0);
+    two_product(e[0],b,q,hh);
+    if(hh!=0.0) h[hi++]=hh;
+    for(int i=1;i<elen;++i)
+    {
+        two_product(e[i],b,product1,product0);
+        two_sum(q,product0,sum,hh);
+        if(hh!=0.0) h[hi++]=hh;
+        fast_two_sum(product1,sum,q,hh);
+        if(hh!=0.0) h[hi++]=hh;
+    }
+    if((q!=0.0) || (hi==0)) h[hi++]=q;
+    return(hi);
+}
+/* Product of two expansions.   h must have room for 2*elen*flen 
+   values and elen must not exceed MaxSmallExpansion/2.  */
+int expansion_product(int elen, const double *e, int flen, const double *f,
+        double *h)
+{
+    double scaled[MaxSmallExpansion];
+    double work[MaxLargeExpansion];
+    int hlen=scale_expansion(elen,e,f[0],h);
+    for(int i=1;i<flen;++i)
+    {
+        int slen=scale_expansion(elen,e,f[i],scaled);
+        int wlen=expansion_sum(hlen,h,slen,scaled,work);
+        copy(work,work+wlen,h);
+        hlen=wlen;
+    }
+    return(hlen);
+}
+/* Exact difference of two doubles as a two component expansion */
+int difference(double a, double b, double *h)
+{
+    double x,y;
+    two_diff(a,b,x,y);
+    if(y!=0.0)
+    {
+        h[0]=y;
+        h[1]=x;
+        return(2);
+    }
+    h[0]=x;
+    return(1);
+}
+/* Exact value of ad-bc for expansions a,b,c,d of length at most 2.
+   The result has at most 16 components. */
+int cross_difference(int alen, const double *a, int dlen, const double *d,
+        int blen, const double *b, int clen, const double *c, double *h)
+{
+    double ad[8],bc[8];
+    int adlen=expansion_product(alen,a,dlen,d,ad);
+    int bclen=expansion_product(blen,b,clen,c,bc);
+    for(int i=0;i<bclen;++i) bc[i]=-bc[i];
+    return(expansion_sum(adlen,ad,bclen,bc,h));
+}
+/* The sign of an expansion with zeros eliminated is the sign of its
+   largest (last) component */
+double orient2d_exact(const double *a, const double *b, const double *c)
+{
+    double acx[2],acy[2],bcx[2],bcy[2],det[16];
+    int acxlen=difference(a[0],c[0],acx);
+    int acylen=difference(a[1],c[1],acy);
+    int bcxlen=difference(b[0],c[0],bcx);
+    int bcylen=difference(b[1],c[1],bcy);
+    int dlen=cross_difference(acxlen,acx,bcylen,bcy,acylen,acy,bcxlen,bcx,det);
+    return(det[dlen-1]);
+}
+double incircle_exact(const double *a, const double *b, const double *c,
+        const double *d)
+{
+    double adx[2],ady[2],bdx[2],bdy[2],cdx[2],cdy[2];
+    int adxlen=difference(a[0],d[0],adx);
+    int adylen=difference(a[1],d[1],ady);
+    int bdxlen=difference(b[0],d[0],bdx);
+    int bdylen=difference(b[1],d[1],bdy);
+    int cdxlen=difference(c[0],d[0],cdx);
+    int cdylen=difference(c[1],d[1],cdy);
+    /* lift terms are computed as x*x - (-y)*y with cross_difference */
+    double nady[2],nbdy[2],ncdy[2];
+    for(int i=0;i<adylen;++i) nady[i]=-ady[i];
+    for(int i=0;i<bdylen;++i) nbdy[i]=-bdy[i];
+    for(int i=0;i<cdylen;++i) ncdy[i]=-cdy[i];
+    double alift[16],blift[16],clift[16],bc[16],ca[16],ab[16];
+    int aliftlen=cross_difference(adxlen,adx,adxlen,adx,adylen,nady,adylen,ady,alift);
+    int bliftlen=cross_difference(bdxlen,bdx,bdxlen,bdx,bdylen,nbdy,bdylen,bdy,blift);
+    int cliftlen=cross_difference(cdxlen,cdx,cdxlen,cdx,cdylen,ncdy,cdylen,cdy,clift);
+    int bclen=cross_difference(bdxlen,bdx,cdylen,cdy,bdylen,bdy,cdxlen,cdx,bc);
+    int calen=cross_difference(cdxlen,cdx,adylen,ady,cdylen,cdy,adxlen,adx,ca);
+    int ablen=cross_difference(adxlen,adx,bdylen,bdy,adylen,ady,bdxlen,bdx,ab);
+    double aterm[512],bterm[512],cterm[512],abterm[1024],det[1536];
+    int alen=expansion_product(aliftlen,alift,bclen,bc,aterm);
+    int blen=expansion_product(bliftlen,blift,calen,ca,bterm);
+    int clen=expansion_product(cliftlen,clift,ablen,ab,cterm);
+    int ablen2=expansion_sum(alen,aterm,blen,bterm,abterm);
+    int dlen=expansion_sum(ablen2,abterm,clen,cterm,det);
+    return(det[dlen-1]);
+}
+}  // end anonymous namespace
+double orient2d(const double *a, const double *b, const double *c)
+{
+    const double eps=epsilon_value();
+    const double ccwerrboundA=(3.0+16.0*eps)*eps;
+    double detleft=(a[0]-c[0])*(b[1]-c[1]);
+    double detright=(a[1]-c[1])*(b[0]-c[0]);
+    double det=detleft-detright;
+    double detsum;
+    if(detleft>0.0)
+    {
+        if(detright<=0.0) return(det);
+        detsum=detleft+detright;
+    }
+    else if(detleft<0.0)
+    {
+        if(detright>=0.0) return(det);
+        detsum=-detleft-detright;
+    }
+    else
+        return(det);
+    double errbound=ccwerrboundA*detsum;
+    if((det>=errbound) || (-det>=errbound)) return(det);
+    return(orient2d_exact(a,b,c));
+}
+double incircle(const double *a, const double *b, const double *c,
+        const double *d)
+{
+    const double eps=epsilon_value();
+    const double iccerrboundA=(10.0+96.0*eps)*eps;
+    double adx=a[0]-d[0];
+    double bdx=b[0]-d[0];
+    double cdx=c[0]-d[0];
+    double ady=a[1]-d[1];
+    double bdy=b[1]-d[1];
+    double cdy=c[1]-d[1];
+    double bdxcdy=bdx*cdy;
+    double cdxbdy=cdx*bdy;
+    double alift=adx*adx+ady*ady;
+    double cdxady=cdx*ady;
+    double adxcdy=adx*cdy;
+    double blift=bdx*bdx+bdy*bdy;
+    double adxbdy=adx*bdy;
+    double bdxady=bdx*ady;
+    double clift=cdx*cdx+cdy*cdy;
+    double det=alift*(bdxcdy-cdxbdy)
+        + blift*(cdxady-adxcdy)
+        + clift*(adxbdy-bdxady);
+    double permanent=(fabs(bdxcdy)+fabs(cdxbdy))*alift
+        + (fabs(cdxady)+fabs(adxcdy))*blift
+        + (fabs(adxbdy)+fabs(bdxady))*clift;
+    double errbound=iccerrboundA*permanent;
+    if((det>errbound) || (-det>errbound)) return(det);
+    return(incircle_exact(a,b,c,d));
+}
+
+const int DelaunayTriangulation::Ghost(-1);
+
+namespace {
+/* Marks a deleted triangle in the vertex array during the build */
+const int DeadTriangle(-2);
+/* Standard algorithm to convert a position on a 2^16 x 2^16 grid to
+   the distance along a Hilbert curve filling the grid.  Used to sort
+   the points so successive insertions are close together. */
+unsigned int hilbert_index(unsigned int x, unsigned int y)
+{
+    const unsigned int n(65536);
+    unsigned int rx,ry,d(0),s;
+    for(s=n/2;s>0;s/=2)
+    {
+        rx=(x&s)>0 ? 1 : 0;
+        ry=(y&s)>0 ? 1 : 0;
+        d+=s*s*((3*rx)^ry);
+        if(ry==0)
+        {
+            if(rx==1)
+            {
+                x=n-1-x;
+                y=n-1-y;
+            }
+            unsigned int t=x;
+            x=y;
+            y=t;
+        }
+    }
+    return(d);
+}
+/* Work space and algorithms used only while building the triangulation.
+   They are isolated here to keep them out of the public interface. */
+class DelaunayBuilder
+{
+public:
+    DelaunayBuilder(const vector<double>& x, const vector<double>& y,
+            vector<int>& tvin, vector<int>& tnin)
+        : px(x),py(y),tv(tvin),tn(tnin),
+          startmap(x.size()+1,-1),stamp(0)
+    {};
+    void run();
+private:
+    const vector<double>& px;
+    const vector<double>& py;
+    vector<int>& tv;
+    vector<int>& tn;
+    vector<int> freelist;
+    /* conflict marks for triangles in the cavity.  Uses a stamp
+       to avoid clearing the array for every insertion. */
+    vector<int> mark;
+    /* Indexed by vertex+1 (ghost is 0).  Holds new triangle starting
+       at that vertex while the cavity is retriangulated. */
+    vector<int> startmap;
+    int stamp;
+    vector<int> cavity;
+    vector<int> boundary_tri;
+    vector<int> boundary_edge;
+    vector<int> newtri;
+    int new_triangle(int a, int b, int c);
+    void kill_triangle(int t);
+    bool in_conflict(int t, int p);
+    int walk(int p, int start);
+    int insert(int p, int start);
+    void point(int i, double *xy)
+    {
+        xy[0]=px[i];
+        xy[1]=py[i];
+    };
+};
+int DelaunayBuilder::new_triangle(int a, int b, int c)
+{
+    int t;
+    /* Rotate a ghost so the point at infinity is always vertex 2 */
+    if(a==DelaunayTriangulation::Ghost)
+    {
+        a=b; b=c; c=DelaunayTriangulation::Ghost;
+    }
+    else if(b==DelaunayTriangulation::Ghost)
+    {
+        b=a; a=c; c=DelaunayTriangulation::Ghost;
+    }
+    if(freelist.empty())
+    {
+        t=tv.size()/3;
+        tv.push_back(a); tv.push_back(b); tv.push_back(c);
+        tn.push_back(-1); tn.push_back(-1); tn.push_back(-1);
+        mark.push_back(0);
+    }
+    else
+    {
+        t=freelist.back();
+        freelist.pop_back();
+        tv[3*t]=a; tv[3*t+1]=b; tv[3*t+2]=c;
+        tn[3*t]=-1; tn[3*t+1]=-1; tn[3*t+2]=-1;
+        mark[t]=0;
+    }
+    return(t);
+}
+void DelaunayBuilder::kill_triangle(int t)
+{
+    tv[3*t]=DeadTriangle;
+    freelist.push_back(t);
+}
+/* A real triangle is in conflict with point p if p is inside its
+   circumcircle.  A ghost triangle is in conflict if p is strictly
+   outside its hull edge or is in the interior of the edge itself. */
+bool DelaunayBuilder::in_conflict(int t, int p)
+{
+    double a[2],b[2],c[2],pp[2];
+    point(p,pp);
+    point(tv[3*t],a);
+    point(tv[3*t+1],b);
+    if(tv[3*t+2]==DelaunayTriangulation::Ghost)
+    {
+        /* hull edge is a->b with the outside on the left */
+        double o=orient2d(a,b,pp);
+        if(o>0.0) return true;
+        if(o<0.0) return false;
+        /* collinear - conflict only if strictly between a and b */
+        if(a[0]!=b[0])
+            return( (pp[0]>min(a[0],b[0])) && (pp[0]<max(a[0],b[0])) );
+        else
+            return( (pp[1]>min(a[1],b[1])) && (pp[1]<max(a[1],b[1])) );
+    }
+    point(tv[3*t+2],c);
+    return(incircle(a,b,c,pp)>0.0);
+}
+/* Visibility walk from start toward point p.  Returns a real triangle
+   containing p or a ghost triangle whose hull edge p is outside of. */
+int DelaunayBuilder::walk(int p, int t)
+{
+    double pp[2],a[2],b[2];
+    point(p,pp);
+    if(tv[3*t+2]==DelaunayTriangulation::Ghost) t=tn[3*t+2];
+    int k,kk;
+    int step(0);
+    while(true)
+    {
+        bool moved(false);
+        for(kk=0;kk<3;++kk)
+        {
+            /* rotate starting edge to avoid pathological cycles */
+            k=(kk+step)%3;
+            point(tv[3*t+(k+1)%3],a);
+            point(tv[3*t+(k+2)%3],b);
+            if(orient2d(a,b,pp)<0.0)
+            {
+                t=tn[3*t+k];
+                moved=true;
+                break;
+            }
+        }
+        if(!moved) return(t);
+        if(tv[3*t+2]==DelaunayTriangulation::Ghost) return(t);
+        ++step;
+    }
+}
+/* Bowyer-Watson insertion of point p.  Returns one of the new
+   triangles to use as the start of the next walk. */
+int DelaunayBuilder::insert(int p, int start)
+{
+    int t=walk(p,start);
+    /* Drop exact duplicates.  A duplicate is always a vertex of the
+       triangle where the walk ends. */
+    int k;
+    for(k=0;k<3;++k)
+    {
+        int v=tv[3*t+k];
+        if(v==DelaunayTriangulation::Ghost) continue;
+        if((px[v]==px[p]) && (py[v]==py[p])) return(t);
+    }
+    ++stamp;
+    cavity.clear();
+    boundary_tri.clear();
+    boundary_edge.clear();
+    cavity.push_back(t);
+    mark[t]=stamp;
+    size_t ic;
+    /* depth first search for all triangles in conflict with p. The
+       cavity vector doubles as the stack */
+    for(ic=0;ic<cavity.size();++ic)
+    {
+        int tc=cavity[ic];
+        for(k=0;k<3;++k)
+        {
+            int nb=tn[3*tc+k];
+            if(mark[nb]==stamp) continue;
+            if(in_conflict(nb,p))
+            {
+                mark[nb]=stamp;
+                cavity.push_back(nb);
+            }
+            else
+            {
+                boundary_tri.push_back(tc);
+                boundary_edge.push_back(k);
+            }
+        }
+    }
+    /* Connect each boundary edge of the cavity to p */
+    newtri.clear();
+    size_t ib;
+    for(ib=0;ib<boundary_tri.size();++ib)
+    {
+        int tc=boundary_tri[ib];
+        k=boundary_edge[ib];
+        int u=tv[3*tc+(k+1)%3];
+        int w=tv[3*tc+(k+2)%3];
+        int nb=tn[3*tc+k];
+        int tnew=new_triangle(u,w,p);
+        int kp;
+        for(kp=0;kp<3;++kp) if(tv[3*tnew+kp]==p) break;
+        tn[3*tnew+kp]=nb;
+        int kk;
+        for(kk=0;kk<3;++kk)
+            if(tn[3*nb+kk]==tc)
+            {
+                tn[3*nb+kk]=tnew;
+                break;
+            }
+        startmap[u+1]=tnew;
+        newtri.push_back(tnew);
+    }
+    /* Link the new triangles to each other.  For new triangle (u,w,p)
+       the neighbor across edge w-p is the new triangle starting at w*/
+    for(ib=0;ib<newtri.size();++ib)
+    {
+        int tnew=newtri[ib];
+        int kp;
+        for(kp=0;kp<3;++kp) if(tv[3*tnew+kp]==p) break;
+        int w=tv[3*tnew+(kp+2)%3];
+        int x=startmap[w+1];
+        int kpx;
+        for(kpx=0;kpx<3;++kpx) if(tv[3*x+kpx]==p) break;
+        tn[3*tnew+(kp+1)%3]=x;
+        tn[3*x+(kpx+2)%3]=tnew;
+    }
+    for(ib=0;ib<newtri.size();++ib)
+    {
+        int tnew=newtri[ib];
+        int kp;
+        for(kp=0;kp<3;++kp) if(tv[3*tnew+kp]==p) break;
+        startmap[tv[3*tnew+(kp+1)%3]+1]=-1;
+    }
+    for(ic=0;ic<cavity.size();++ic) kill_triangle(cavity[ic]);
+    /* Return a real triangle if possible to start the next walk */
+    for(ib=0;ib<newtri.size();++ib)
+        if(tv[3*newtri[ib]+2]!=DelaunayTriangulation::Ghost)
+            return(newtri[ib]);
+    return(newtri[0]);
+}
+void DelaunayBuilder::run()
+{
+    const string base_error("DelaunayTriangulation constructor:  ");
+    int npts=px.size();
+    int i;
+    /* Sort points along a Hilbert curve */
+    double xmin,xmax,ymin,ymax;
+    xmin=xmax=px[0];
+    ymin=ymax=py[0];
+    for(i=1;i<npts;++i)
+    {
+        xmin=min(xmin,px[i]);
+        xmax=max(xmax,px[i]);
+        ymin=min(ymin,py[i]);
+        ymax=max(ymax,py[i]);
+    }
+    double xscale=(xmax>xmin) ? 65535.0/(xmax-xmin) : 0.0;
+    double yscale=(ymax>ymin) ? 65535.0/(ymax-ymin) : 0.0;
+    vector< pair<unsigned int,int> > order;
+    order.reserve(npts);
+    for(i=0;i<npts;++i)
+    {
+        unsigned int ix=static_cast<unsigned int>((px[i]-xmin)*xscale);
+        unsigned int iy=static_cast<unsigned int>((py[i]-ymin)*yscale);
+        order.push_back(pair<unsigned int,int>(hilbert_index(ix,iy),i));
+    }
+    sort(order.begin(),order.end());
+    /* Find three points that are not collinear to make the first
+       triangle */
+    int ia=order[0].second;
+    int ib(-1),ic(-1);
+    int k;
+    for(k=1;k<npts;++k)
+    {
+        int j=order[k].second;
+        if((px[j]!=px[ia]) || (py[j]!=py[ia]))
+        {
+            ib=j;
+            break;
+        }
+    }
+    if(ib<0) throw GeoCoordError(base_error
+            + "all points are identical");
+    double a[2],b[2],c[2];
+    point(ia,a);
+    point(ib,b);
+    double o(0.0);
+    for(k=1;k<npts;++k)
+    {
+        int j=order[k].second;
+        point(j,c);
+        o=orient2d(a,b,c);
+        if(o!=0.0)
+        {
+            ic=j;
+            break;
+        }
+    }
+    if(ic<0) throw GeoCoordError(base_error
+            + "all points are collinear.  Cannot triangulate");
+    if(o<0.0) swap(ib,ic);
+    tv.reserve(6*npts+12);
+    tn.reserve(6*npts+12);
+    mark.reserve(2*npts+4);
+    const int G(DelaunayTriangulation::Ghost);
+    int t0=new_triangle(ia,ib,ic);
+    int g0=new_triangle(ic,ib,G);   // across edge opposite ia
+    int g1=new_triangle(ia,ic,G);   // across edge opposite ib
+    int g2=new_triangle(ib,ia,G);   // across edge opposite ic
+    tn[3*t0]=g0; tn[3*t0+1]=g1; tn[3*t0+2]=g2;
+    /* Ghost (x,y,G):  n[0] is the ghost starting at y, n[1] is the
+       ghost ending at x, and n[2] is the real triangle */
+    tn[3*g0]=g2; tn[3*g0+1]=g1; tn[3*g0+2]=t0;
+    tn[3*g1]=g0; tn[3*g1+1]=g2; tn[3*g1+2]=t0;
+    tn[3*g2]=g1; tn[3*g2+1]=g0; tn[3*g2+2]=t0;
+    int start=t0;
+    for(k=0;k<npts;++k)
+    {
+        int j=order[k].second;
+        if((j==ia) || (j==ib) || (j==ic)) continue;
+        start=insert(j,start);
+    }
+}
+}  // end anonymous namespace
+
+DelaunayTriangulation::DelaunayTriangulation()
+{
+    nreal=0;
+    gxmin=0.0;
+    gymin=0.0;
+    gdx=1.0;
+    gdy=1.0;
+    gnx=0;
+    gny=0;
+}
+DelaunayTriangulation::DelaunayTriangulation(const vector<double>& x,
+        const vector<double>& y, const vector<double>& z)
+    : px(x),py(y),pz(z)
+{
+    const string base_error("DelaunayTriangulation constructor:  ");
+    if((x.size()!=y.size()) || (x.size()!=z.size()))
+        throw GeoCoordError(base_error
+                + "x,y,z vectors must be the same length");
+    if(x.size()<3)
+        throw GeoCoordError(base_error
+                + "insufficient points.  Need at least 3");
+    try {
+        this->build();
+    }catch(...){throw;};
+}
+DelaunayTriangulation::DelaunayTriangulation(BinaryCacheReader& in)
+{
+    const string base_error("DelaunayTriangulation cache file constructor:  ");
+    vector<double> dpar;
+    vector<int> ipar;
+    try {
+        in.read(px);
+        in.read(py);
+        in.read(pz);
+        in.read(tv);
+        in.read(tn);
+        in.read(dpar);
+        in.read(ipar);
+        in.read(bucket);
+    }catch(...){throw;};
+    if((dpar.size()!=4) || (ipar.size()!=3))
+        throw GeoCoordError(base_error
+                + "index parameter arrays have wrong size");
+    gxmin=dpar[0];
+    gymin=dpar[1];
+    gdx=dpar[2];
+    gdy=dpar[3];
+    nreal=ipar[0];
+    gnx=ipar[1];
+    gny=ipar[2];
+    if((gnx<=0) || (gny<=0) || !(gdx>0.0) || !(gdy>0.0))
+        throw GeoCoordError(base_error + "invalid bucket grid parameters");
+    if((py.size()!=px.size()) || (pz.size()!=px.size())
+            || (tn.size()!=tv.size()) || (tv.size()%3!=0)
+            || (bucket.size()!=static_cast<size_t>(gnx)*gny))
+        throw GeoCoordError(base_error + "array sizes are inconsistent");
+    /* A stale or damaged file can have consistent sizes and still
+       contain indices that would make locate read outside the arrays.
+       Check every index so the caller can rebuild instead. */
+    int npts=number_points();
+    int ntri=number_triangles();
+    if((npts<3) || (nreal<=0) || (nreal>ntri))
+        throw GeoCoordError(base_error + "invalid point or triangle count");
+    int t,k,nr(0);
+    for(t=0;t<ntri;++t)
+    {
+        for(k=0;k<3;++k)
+        {
+            int v=tv[3*t+k];
+            bool ghost_ok=((k==2) && (v==Ghost));
+            if(((v<0) || (v>=npts)) && !ghost_ok)
+                throw GeoCoordError(base_error 
+                        + "triangle vertex index out of range");
+            if((tn[3*t+k]<0) || (tn[3*t+k]>=ntri))
+                throw GeoCoordError(base_error 
+                        + "triangle neighbor index out of range");
+        }
+        if(tv[3*t+2]!=Ghost) ++nr;
+    }
+    if(nr!=nreal)
+        throw GeoCoordError(base_error 
+                + "real triangle count does not match triangle list");
+    for(size_t ib=0;ib<bucket.size();++ib)
+        if((bucket[ib]<0) || (bucket[ib]>=ntri) 
+                || (tv[3*bucket[ib]+2]==Ghost))
+            throw GeoCoordError(base_error 
+                    + "bucket grid entry is not a real triangle");
+}
+void DelaunayTriangulation::write(BinaryCacheWriter& out) const
+{
+    double dpar[4];
+    int ipar[3];
+    dpar[0]=gxmin;
+    dpar[1]=gymin;
+    dpar[2]=gdx;
+    dpar[3]=gdy;
+    ipar[0]=nreal;
+    ipar[1]=gnx;
+    ipar[2]=gny;
+    out.write(px);
+    out.write(py);
+    out.write(pz);
+    out.write(tv);
+    out.write(tn);
+    out.write(dpar,4);
+    out.write(ipar,3);
+    out.write(bucket);
+}
+DelaunayTriangulation::DelaunayTriangulation(const DelaunayTriangulation& parent)
+    : px(parent.px),py(parent.py),pz(parent.pz),tv(parent.tv),tn(parent.tn),
+      bucket(parent.bucket)
+{
+    nreal=parent.nreal;
+    gxmin=parent.gxmin;
+    gymin=parent.gymin;
+    gdx=parent.gdx;
+    gdy=parent.gdy;
+    gnx=parent.gnx;
+    gny=parent.gny;
+}
+DelaunayTriangulation& DelaunayTriangulation::operator=
+        (const DelaunayTriangulation& parent)
+{
+    if(this!=&parent)
+    {
+        px=parent.px;
+        py=parent.py;
+        pz=parent.pz;
+        tv=parent.tv;
+        tn=parent.tn;
+        nreal=parent.nreal;
+        gxmin=parent.gxmin;
+        gymin=parent.gymin;
+        gdx=parent.gdx;
+        gdy=parent.gdy;
+        gnx=parent.gnx;
+        gny=parent.gny;
+        bucket=parent.bucket;
+    }
+    return(*this);
+}
+/* Build the triangulation and then compact the triangle arrays to
+   remove triangles deleted during the build */
+void DelaunayTriangulation::build()
+{
+    vector<int> worktv,worktn;
+    DelaunayBuilder builder(px,py,worktv,worktn);
+    builder.run();
+    int nwork=worktv.size()/3;
+    vector<int> newindex(nwork,-1);
+    int t,nlive(0);
+    for(t=0;t<nwork;++t)
+        if(worktv[3*t]!=DeadTriangle) newindex[t]=nlive++;
+    tv.resize(3*nlive);
+    tn.resize(3*nlive);
+    nreal=0;
+    for(t=0;t<nwork;++t)
+    {
+        int tt=newindex[t];
+        if(tt<0) continue;
+        for(int k=0;k<3;++k)
+        {
+            tv[3*tt+k]=worktv[3*t+k];
+            tn[3*tt+k]=newindex[worktn[3*t+k]];
+        }
+        if(tv[3*tt+2]!=Ghost) ++nreal;
+    }
+    this->build_index();
+}
+void DelaunayTriangulation::cell(double x, double y, int& i, int& j) const
+{
+    double di=floor((x-gxmin)/gdx);
+    double dj=floor((y-gymin)/gdy);
+    /* Clamp in floating point to avoid int overflow for points far
+       outside the grid */
+    if(di<0.0) di=0.0;
+    if(di>static_cast<double>(gnx-1)) di=static_cast<double>(gnx-1);
+    if(dj<0.0) dj=0.0;
+    if(dj>static_cast<double>(gny-1)) dj=static_cast<double>(gny-1);
+    i=static_cast<int>(di);
+    j=static_cast<int>(dj);
+}
+/* Build the bucket grid.  The grid covers the bounding box of the
+   points with about two points per cell. */
+void DelaunayTriangulation::build_index()
+{
+    int npts=px.size();
+    int i,j,k,t;
+    double xmin,xmax,ymin,ymax;
+    xmin=xmax=px[0];
+    ymin=ymax=py[0];
+    for(i=1;i<npts;++i)
+    {
+        xmin=min(xmin,px[i]);
+        xmax=max(xmax,px[i]);
+        ymin=min(ymin,py[i]);
+        ymax=max(ymax,py[i]);
+    }
+    double wx=xmax-xmin;
+    double wy=ymax-ymin;
+    /* The points are not collinear so at least one width is nonzero.
+       Sizing by area handles very elongated point sets. */
+    double cellsize=sqrt(2.0*wx*wy/static_cast<double>(npts));
+    if(cellsize<=0.0) cellsize=max(wx,wy)/static_cast<double>(npts);
+    gnx=min(static_cast<int>(wx/cellsize)+1,npts);
+    gny=min(static_cast<int>(wy/cellsize)+1,npts);
+    gxmin=xmin;
+    gymin=ymin;
+    gdx=(wx>0.0) ? wx/static_cast<double>(gnx) : 1.0;
+    gdy=(wy>0.0) ? wy/static_cast<double>(gny) : 1.0;
+    /* Add a tiny margin so points on the max edge fall in the last cell */
+    gdx*=(1.0+FLT_EPSILON);
+    gdy*=(1.0+FLT_EPSILON);
+    bucket.assign(gnx*gny,-1);
+    int ntri=number_triangles();
+    for(t=0;t<ntri;++t)
+    {
+        if(tv[3*t+2]==Ghost) continue;
+        for(k=0;k<3;++k)
+        {
+            int v=tv[3*t+k];
+            cell(px[v],py[v],i,j);
+            if(bucket[j*gnx+i]<0) bucket[j*gnx+i]=t;
+        }
+    }
+    /* Empty cells get the triangle of the closest filled cell in 
+       the same row or, failing that, the nearest filled row */
+    int last;
+    for(j=0;j<gny;++j)
+    {
+        last=-1;
+        for(i=0;i<gnx;++i)
+        {
+            if(bucket[j*gnx+i]>=0)
+                last=bucket[j*gnx+i];
+            else if(last>=0)
+                bucket[j*gnx+i]=last;
+        }
+        last=-1;
+        for(i=gnx-1;i>=0;--i)
+        {
+            if(bucket[j*gnx+i]>=0)
+                last=bucket[j*gnx+i];
+            else if(last>=0)
+                bucket[j*gnx+i]=last;
+        }
+    }
+    for(j=1;j<gny;++j)
+        if(bucket[j*gnx]<0)
+            copy(bucket.begin()+(j-1)*gnx,bucket.begin()+j*gnx,
+                    bucket.begin()+j*gnx);
+    for(j=gny-2;j>=0;--j)
+        if(bucket[j*gnx]<0)
+            copy(bucket.begin()+(j+1)*gnx,bucket.begin()+(j+2)*gnx,
+                    bucket.begin()+j*gnx);
+}
+/* Same algorithm as the walk used in the build, but returns any
+   ghost triangle reached as -1 */
+int DelaunayTriangulation::walk(double x, double y, int t) const
+{
+    double pp[2],a[2],b[2];
+    pp[0]=x;
+    pp[1]=y;
+    if(tv[3*t+2]==Ghost) t=tn[3*t+2];
+    int k,kk;
+    int step(0);
+    /* The walk cannot cycle in a Delaunay triangulation, but guard
+       against it anyway.  Falls back to a brute force search. */
+    int maxsteps=number_triangles()+3;
+    while(step<maxsteps)
+    {
+        bool moved(false);
+        for(kk=0;kk<3;++kk)
+        {
+            k=(kk+step)%3;
+            int ia=tv[3*t+(k+1)%3];
+            int ib=tv[3*t+(k+2)%3];
+            a[0]=px[ia]; a[1]=py[ia];
+            b[0]=px[ib]; b[1]=py[ib];
+            if(orient2d(a,b,pp)<0.0)
+            {
+                t=tn[3*t+k];
+                moved=true;
+                break;
+            }
+        }
+        if(!moved) return(t);
+        if(tv[3*t+2]==Ghost) return(-1);
+        ++step;
+    }
+    int ntri=number_triangles();
+    for(t=0;t<ntri;++t)
+    {
+        if(tv[3*t+2]==Ghost) continue;
+        for(k=0;k<3;++k)
+        {
+            int ia=tv[3*t+(k+1)%3];
+            int ib=tv[3*t+(k+2)%3];
+            a[0]=px[ia]; a[1]=py[ia];
+            b[0]=px[ib]; b[1]=py[ib];
+            if(orient2d(a,b,pp)<0.0) break;
+        }
+        if(k==3) return(t);
+    }
+    return(-1);
+}
+int DelaunayTriangulation::locate(double x, double y, int hint) const
+{
+    if(tv.empty()) return(-1);
+    int i,j;
+    cell(x,y,i,j);
+    int start=bucket[j*gnx+i];
+    /* Use the hint only if its first vertex is within two cells of
+       x,y.  Otherwise the bucket is a better place to start. */
+    if((hint>=0) && (hint<number_triangles()))
+    {
+        int v=tv[3*hint];
+        int iv,jv;
+        cell(px[v],py[v],iv,jv);
+        if((abs(iv-i)<=2) && (abs(jv-j)<=2)) start=hint;
+    }
+    return(this->walk(x,y,start));
+}
+double DelaunayTriangulation::interpolate(int tri, double x, double y) const
+{
+    int ia=tv[3*tri];
+    int ib=tv[3*tri+1];
+    int ic=tv[3*tri+2];
+    /* Barycentric coordinates from signed areas */
+    double area=(px[ib]-px[ia])*(py[ic]-py[ia])
+        - (py[ib]-py[ia])*(px[ic]-px[ia]);
+    double wa=(px[ib]-x)*(py[ic]-y) - (py[ib]-y)*(px[ic]-x);
+    double wb=(px[ic]-x)*(py[ia]-y) - (py[ic]-y)*(px[ia]-x);
+    double wc=area-wa-wb;
+    return((wa*pz[ia]+wb*pz[ib]+wc*pz[ic])/area);
+}
@@ -0,0 +1,157 @@
+#ifndef _DELAUNAYTRIANGULATION_H_
+#define _DELAUNAYTRIANGULATION_H_
+#include <vector>
+#include "GeoCoordError.h"
+#include "BinaryCacheFile.h"
+using namespace std;
+/*! \brief Delaunay triangulation of a set of points in a plane.
+
+  This object builds a Delaunay triangulation of a random set of
+points in 2d with a function value (z) attached to each point.  It
+replaces the delaunay_On4 procedure from the antelope cgeom library
+that has O(n^4) running time.  The algorithm used here is incremental
+insertion (Bowyer-Watson) with points inserted in order along a
+Hilbert curve and point location by walking from the last triangle
+created.  That makes the expected build time O(n log n).
+
+All geometric decisions are made with the orientation and incircle
+predicates of Shewchuk.   A fast floating point version is used
+when the result is certain and an exact version with expansion
+arithmetic is used otherwise.  This makes the algorithm robust for
+collinear and cocircular points that are common in gridded input.
+
+The convex hull is handled with "ghost" triangles that link each
+hull edge to a point at infinity.   Ghost triangles are kept
+after the build because they make point location simple:  a walk
+that ends in a ghost triangle is outside the convex hull.
+
+Point location uses a uniform bucket grid built with the triangulation.
+Each bucket stores a triangle near that bucket so a query can jump
+to a nearby triangle and walk only a short distance.   A caller
+with coherent queries (e.g. samples along a path) can instead pass
+the result of the previous query as a hint.   Either way the cost of
+a query is close to O(1).
+
+Duplicate points are silently dropped.   The object does not care
+about units, but like the rest of this library it is used with x
+as longitude and y as latitude.
+\author Gary L. Pavlis
+*/
+class DelaunayTriangulation
+{
+public:
+    /*! Default constructor.  Creates an empty triangulation. */
+    DelaunayTriangulation();
+    /*! \brief Primary constructor.
+
+      Builds the triangulation of a set of points defined by three
+      parallel vectors.
+      \param x is the vector of x coordinates of the points.
+      \param y is the vector of y coordinates of the points.
+      \param z is the vector of function values at each point that
+        will be interpolated by the interpolate method.
+
+      \exception GeoCoordError is thrown if the vectors are not the same
+        length, there are fewer than 3 points, or all the points are
+        collinear.
+      */
+    DelaunayTriangulation(const vector<double>& x, const vector<double>& y,
+            const vector<double>& z);
+    /*! \brief Construct from a cache file.
+
+      Loads a triangulation saved with the write method.  This is
+      much faster than building the triangulation.
+      \exception GeoCoordError is thrown for read errors or if the
+        file contents are inconsistent.
+      */
+    DelaunayTriangulation(BinaryCacheReader& in);
+    /*! Standard copy constructor. */
+    DelaunayTriangulation(const DelaunayTriangulation& parent);
+    /*! Standard assignment operator. */
+    DelaunayTriangulation& operator=(const DelaunayTriangulation& parent);
+    /*! Return the number of input points (including any duplicates) */
+    int number_points() const {return(static_cast<int>(px.size()));};
+    /*! Return the number of triangles including ghost triangles. */
+    int number_triangles() const {return(static_cast<int>(tv.size()/3));};
+    /*! Return the number of real (not ghost) triangles. */
+    int number_real_triangles() const {return(nreal);};
+    /*! \brief Find the triangle containing a point.
+
+      Walks the triangulation to the point x,y.   Points on the 
+      boundary of the convex hull are treated as inside.  The walk 
+      starts from the hint triangle if it is close to x,y.  Otherwise
+      it starts from the triangle stored in the bucket grid for x,y.
+      \param x is the x coordinate of the point to locate.
+      \param y is the y coordinate of the point to locate.
+      \param hint is a triangle index to use as the start of the walk.
+        Normally the result of a previous call.   Any value outside 
+        the valid range (the default) means use only the bucket grid.
+      \return index of the triangle containing x,y or -1 if the
+        point is outside the convex hull of the points.
+      */
+    int locate(double x, double y, int hint=-1) const;
+    /*! Return true if x,y is inside the convex hull of the points. */
+    bool contains(double x, double y) const {return(locate(x,y)>=0);};
+    /*! \brief Linear interpolation inside a triangle.
+
+      The function value at x,y is computed from the plane defined
+      by the three vertices of triangle tri.   Caller is responsible
+      for assuring tri is a real triangle (normally the result of
+      locate) as this method does no error checking.
+      */
+    double interpolate(int tri, double x, double y) const;
+    /*! Return true if triangle tri is a ghost triangle.*/
+    bool is_ghost(int tri) const {return(tv[3*tri+2]==Ghost);};
+    /*! \brief Return the vertices of a triangle.
+
+      Vertex indices refer to the input point vectors.   Vertices
+      are returned in counterclockwise order.  For a ghost triangle
+      the third vertex is the point at infinity (negative).
+      */
+    void vertices(int tri, int& a, int& b, int& c) const
+    {
+        a=tv[3*tri]; b=tv[3*tri+1]; c=tv[3*tri+2];
+    };
+    /*! Return x coordinate of point i. */
+    double x(int i) const {return(px[i]);};
+    /*! Return y coordinate of point i. */
+    double y(int i) const {return(py[i]);};
+    /*! Return function value attached to point i. */
+    double z(int i) const {return(pz[i]);};
+    /*! Save the triangulation to a cache file. */
+    void write(BinaryCacheWriter& out) const;
+    /*! Index used for the point at infinity in ghost triangles. */
+    static const int Ghost;
+private:
+    vector<double> px,py,pz;
+    /* Triangles are stored as flat arrays.  tv[3*t+k] is vertex k of
+       triangle t (counterclockwise) and tn[3*t+k] is the triangle
+       across the edge opposite vertex k.   Ghost triangles always
+       have the point at infinity as vertex 2. */
+    vector<int> tv,tn;
+    int nreal;
+    /* Bucket grid for point location.  Cell (i,j) covers x from
+       gxmin+i*gdx to gxmin+(i+1)*gdx (similarly for y) and bucket[j*gnx+i]
+       is a real triangle with a vertex in or near that cell. */
+    double gxmin,gymin,gdx,gdy;
+    int gnx,gny;
+    vector<int> bucket;
+    void build();
+    void build_index();
+    void cell(double x, double y, int& i, int& j) const;
+    int walk(double x, double y, int start) const;
+};
+/*! \brief Robust orientation predicate.
+
+  Returns a positive value if a, b, and c are in counterclockwise order,
+  a negative value if they are clockwise, and zero if collinear.  The
+  sign is always correct.  */
+double orient2d(const double *a, const double *b, const double *c);
+/*! \brief Robust incircle predicate.
+
+  Returns a positive value if d is inside the circle through a, b,
+  and c (which must be in counterclockwise order), a negative value
+  if outside, and zero if on the circle.  The sign is always correct. */
+double incircle(const double *a, const double *b, const double *c,
+        const double *d);
+#endif
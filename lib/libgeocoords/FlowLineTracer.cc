@@ -0,0 +1,296 @@
+#include <math.h>
+#include <string>
+#include <sstream>
+#include "coords.h"
+#include "FlowLineTracer.h"
+#include "GeoCoordError.h"
+#include "seispp.h"
+using namespace std;
+namespace {
+/* Great circle distance (radians) between two points */
+double GeoDistance(const Geographic_point& gp0, const Geographic_point& gp1)
+{
+    double delta,az;
+    dist(gp0.lat,gp0.lon,gp1.lat,gp1.lon,&delta,&az);
+    return(delta);
+}
+/* 3d distance from gp0 to gp1 with horizontal distance measured at
+   the radius of gp0 */
+double distance_increment(const Geographic_point& gp0,
+        const Geographic_point& gp1)
+{
+    double delta;
+    delta=GeoDistance(gp0,gp1);
+    delta*=gp0.r;
+    return(hypot(delta,fabs(gp1.r-gp0.r)));
+}
+/* Time step dt corrected for the ratio of 3d length to length on the
+   reference ellipsoid */
+double adjustedtime(const Geographic_point& gp0, const Geographic_point& gp1,
+        double dt)
+{
+    double delta;
+    delta=GeoDistance(gp0,gp1);
+    delta*=r0_ellipse(gp0.lat);
+    double ds=hypot(delta,fabs(gp1.r-gp0.r));
+    return(dt*ds/delta);
+}
+/* Position at the reference ellipsoid of unit vector x rotated by R */
+Geographic_point rotated_position(const double *R, const double *x)
+{
+    double y[3];
+    y[0]=R[0]*x[0]+R[1]*x[1]+R[2]*x[2];
+    y[1]=R[3]*x[0]+R[4]*x[1]+R[5]*x[2];
+    y[2]=R[6]*x[0]+R[7]*x[1]+R[8]*x[2];
+    Geographic_point result;
+    result.lat=atan2(y[2],hypot(y[0],y[1]));
+    result.lon=atan2(y[1],y[0]);
+    result.r=r0_ellipse(result.lat);
+    return(result);
+}
+}  // end anonymous namespace
+SurfaceFlowLineDepth::SurfaceFlowLineDepth(const GeoSurface& surf)
+{
+    surface=surf.clone();
+}
+SurfaceFlowLineDepth::SurfaceFlowLineDepth(const SurfaceFlowLineDepth& parent)
+{
+    surface=parent.surface->clone();
+}
+SurfaceFlowLineDepth::~SurfaceFlowLineDepth()
+{
+    delete surface;
+}
+FlowLineDepthModel *SurfaceFlowLineDepth::clone() const
+{
+    return(new SurfaceFlowLineDepth(*this));
+}
+bool SurfaceFlowLineDepth::radius(double lat, double lon, double, double& r)
+{
+    return(surface->radius_if_defined(lat,lon,r));
+}
+ProfileFlowLineDepth::ProfileFlowLineDepth(const PLGeoPath& master)
+    : profile(master)
+{
+    length=profile.send();
+}
+FlowLineDepthModel *ProfileFlowLineDepth::clone() const
+{
+    return(new ProfileFlowLineDepth(*this));
+}
+bool ProfileFlowLineDepth::radius(double lat, double, double s, double& r)
+{
+    if(s>=length) return false;
+    Geographic_point gp=profile.position(s);
+    /* Depth is relative to the ellipsoid at the master curve latitude
+       and is converted to radius at the latitude of the flow line */
+    double masterz=r0_ellipse(gp.lat)-gp.r;
+    r=r0_ellipse(lat)-masterz;
+    return true;
+}
+FlowLine::FlowLine()
+{
+    origin_defined=true;
+    extension_start=-1;
+    extension_dip=0.0;
+    extension_origin.lat=0.0;
+    extension_origin.lon=0.0;
+    extension_origin.r=0.0;
+}
+FlowLineTracer::FlowLineTracer(const StagePoleModel& spm, double dt,
+        double endtime, int oversampling)
+{
+    const string base_error("FlowLineTracer constructor:  ");
+    if(dt<=0.0) throw GeoCoordError(base_error
+            + "time sample interval must be positive");
+    if(endtime<0.0) throw GeoCoordError(base_error
+            + "end time must be nonnegative");
+    if(oversampling<=0) throw GeoCoordError(base_error
+            + "oversampling count must be positive");
+    this->dt=dt;
+    this->endtime=endtime;
+    this->oversampling=oversampling;
+    int npoints=SEISPP::nint(endtime/dt)+1;
+    nsteps=npoints*oversampling;
+    double sdt=dt/static_cast<double>(oversampling);
+    rotations.resize(9*(nsteps+1));
+    try{
+        for(int j=0;j<=nsteps;++j)
+            spm.rotation_matrix(static_cast<double>(j)*sdt,
+                    &(rotations[9*j]));
+    }catch(...){throw;};
+    extend=false;
+    mindip=0.0;
+    maxdip=90.0;
+    use_local_dip=false;
+}
+void FlowLineTracer::set_extension(double mindip, double maxdip,
+        bool use_local_dip)
+{
+    extend=true;
+    this->mindip=mindip;
+    this->maxdip=maxdip;
+    this->use_local_dip=use_local_dip;
+}
+void FlowLineTracer::clear_extension()
+{
+    extend=false;
+}
+int FlowLineTracer::number_steps() const
+{
+    return(nsteps);
+}
+/* The point with index j (the live index) is normally at step j but is
+   at step j+1 when the origin is undefined.   When a line is extended
+   the extension restarts at step j from the point before the last valid
+   point.   This is the behaviour of the serial loops this replaced and
+   is retained so models do not change. */
+FlowLine FlowLineTracer::trace_line(const Geographic_point& origin,
+        FlowLineDepthModel& dm) const
+{
+    FlowLine result;
+    double x0[3];
+    dsphcar(origin.lon,origin.lat,x0);
+    double sdt=dt/static_cast<double>(oversampling);
+    vector<Geographic_point> oversampledpath;
+    vector<double> corrected_time,path_s;
+    oversampledpath.reserve(nsteps+1);
+    corrected_time.reserve(nsteps+1);
+    path_s.reserve(nsteps+1);
+    Geographic_point gp,lastgp;
+    double current_time(0.0),current_s(0.0);
+    try{
+        for(int jloop=0,j=0;jloop<(nsteps+1);++j,++jloop)
+        {
+            gp=rotated_position(&(rotations[9*jloop]),x0);
+            if(!dm.radius(gp.lat,gp.lon,current_s,gp.r))
+            {
+                if(jloop==0)
+                {
+                    result.origin_defined=false;
+                    lastgp=gp;
+                    --j;
+                    continue;
+                }
+                else if(j<2)
+                    break;
+                else if(extend)
+                {
+                    /* Dip from the last two points.  dz is in km and
+                       ddelta in radians. */
+                    double dzdx=oversampledpath[j-2].r
+                                        - oversampledpath[j-1].r;
+                    double ddelta=GeoDistance(oversampledpath[j-2],
+                            oversampledpath[j-1]);
+                    dzdx/=ddelta;
+                    double R0(oversampledpath[j-1].r);
+                    double dipdeg=deg(atan(dzdx/R0));
+                    if(dipdeg>maxdip)
+                    {
+                        dzdx=tan(rad(maxdip))*R0;
+                        dipdeg=maxdip;
+                    }
+                    else if(dipdeg<mindip)
+                    {
+                        dzdx=tan(rad(mindip))*R0;
+                        dipdeg=mindip;
+                    }
+                    result.extension_start=j;
+                    result.extension_dip=dipdeg;
+                    result.extension_origin=oversampledpath[j-1];
+                    lastgp=oversampledpath[j-2];
+                    for(int jj=j;jj<(nsteps+1);++jj)
+                    {
+                        gp=rotated_position(&(rotations[9*jj]),x0);
+                        ddelta=GeoDistance(lastgp,gp);
+                        /* Corrects delta for shrinking length with depth */
+                        if(use_local_dip) ddelta *= lastgp.r/R0;
+                        gp.r=lastgp.r-dzdx*ddelta;
+                        oversampledpath.push_back(gp);
+                        current_time += adjustedtime(lastgp,gp,sdt);
+                        current_s += distance_increment(lastgp,gp);
+                        corrected_time.push_back(current_time);
+                        path_s.push_back(current_s);
+                        lastgp=gp;
+                    }
+                    break;
+                }
+                else
+                    break;
+            }
+            if(j>0)
+            {
+                current_time += adjustedtime(lastgp,gp,sdt);
+                current_s += distance_increment(lastgp,gp);
+            }
+            corrected_time.push_back(current_time);
+            path_s.push_back(current_s);
+            oversampledpath.push_back(gp);
+            lastgp=gp;
+        }
+        if(oversampledpath.size()>1)
+        {
+            PLGeoPath plop(oversampledpath,0);
+            result.path=timesample_PLGeoPath(plop,corrected_time,path_s,
+                    dt,endtime);
+        }
+    }catch(...){throw;};
+    return(result);
+}
+FlowLine FlowLineTracer::trace(const Geographic_point& origin,
+        const FlowLineDepthModel& depth) const
+{
+    FlowLineDepthModel *dm=depth.clone();
+    FlowLine result;
+    try{
+        result=this->trace_line(origin,*dm);
+    }catch(...)
+    {
+        delete dm;
+        throw;
+    };
+    delete dm;
+    return(result);
+}
+vector<FlowLine> FlowLineTracer::trace(const vector<Geographic_point>& origins,
+        const FlowLineDepthModel& depth, bool threaded) const
+{
+    int nlines=origins.size();
+    vector<FlowLine> result(nlines);
+    /* Exceptions cannot leave a parallel region.  Messages are saved
+       and the first failure in origins order is thrown after the loop
+       so the error does not depend on thread scheduling. */
+    vector<string> errors(nlines);
+    vector<int> failed(nlines,0);
+    int i;
+    /* Every line works on its own clone of the depth model so each
+       starts from the same search state.  Clones are cheap because 
+       surface data are shared.  Lines vary a lot in length so work is 
+       handed out one line at a time. */
+#pragma omp parallel for schedule(dynamic) if(threaded)
+    for(i=0;i<nlines;++i)
+    {
+        try{
+            result[i]=this->trace(origins[i],depth);
+        }catch(std::exception& err)
+        {
+            errors[i]=err.what();
+            failed[i]=1;
+        }catch(...)
+        {
+            errors[i]="unknown exception";
+            failed[i]=1;
+        }
+    }
+    for(i=0;i<nlines;++i)
+    {
+        if(failed[i])
+        {
+            stringstream ss;
+            ss << "FlowLineTracer::trace:  line "<<i<<" failed"<<endl
+                << errors[i];
+            throw GeoCoordError(ss.str());
+        }
+    }
+    return(result);
+}
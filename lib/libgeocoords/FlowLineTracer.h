@@ -0,0 +1,172 @@
+#ifndef _FLOWLINETRACER_H_
+#define _FLOWLINETRACER_H_
+#include <vector>
+#include "gclgrid.h"
+#include "GeoSurface.h"
+#include "PLGeoPath.h"
+#include "StagePoleModel.h"
+using namespace std;
+/*! \brief Abstract interface for the depth of a flow line.
+
+  A FlowLineTracer moves a point along the earth's surface with a plate
+  motion model and asks an object of this type for the radius of the
+  flow line at each step.  Implementations are allowed to keep search
+  state so the tracer gives every flow line its own copy made with
+  clone.  One prototype can thus be shared read only by all threads.
+  */
+class FlowLineDepthModel
+{
+public:
+    virtual ~FlowLineDepthModel(){};
+    /*! Return a copy allocated with new.  The caller owns the result.*/
+    virtual FlowLineDepthModel *clone() const=0;
+    /*! \brief Radius of the flow line at a point.
+
+      \param lat is latitude (radians) of the surface position.
+      \param lon is longitude (radians) of the surface position.
+      \param s is the 3d distance (km) along the flow line to the
+        previous accepted point (0 for the first point).
+      \param r is set to the radius of the flow line when it is defined
+        at this point.  It is not altered otherwise.
+      \return true if the flow line is defined at this point. */
+    virtual bool radius(double lat, double lon, double s, double& r)=0;
+};
+/*! \brief Flow line depth taken from a GeoSurface.
+
+  Used by the slab modeling programs.  The flow line is defined where
+  the surface is defined (convex hull and optional boundary polygon).
+  */
+class SurfaceFlowLineDepth : public FlowLineDepthModel
+{
+public:
+    /*! Construct from a surface.  The surface is copied with its
+      clone method. */
+    SurfaceFlowLineDepth(const GeoSurface& surf);
+    SurfaceFlowLineDepth(const SurfaceFlowLineDepth& parent);
+    ~SurfaceFlowLineDepth();
+    FlowLineDepthModel *clone() const;
+    bool radius(double lat, double lon, double s, double& r);
+private:
+    GeoSurface *surface;
+    /* Not implemented.  Objects are not assignable. */
+    SurfaceFlowLineDepth& operator=(const SurfaceFlowLineDepth& parent);
+};
+/*! \brief Flow line depth taken from a master depth profile.
+
+  Every flow line is given the depth of a master curve at the same
+  distance along the path.   The master curve is a PLGeoPath
+  parameterized by distance from its origin.  Depth is measured
+  from the reference ellipsoid at the latitude of the master curve
+  so the master can be at a completely different latitude than the
+  flow lines.   The depth is converted to radius with the reference
+  ellipsoid at the latitude of the flow line point.  The flow line is 
+  undefined past the end of the master curve.  */
+class ProfileFlowLineDepth : public FlowLineDepthModel
+{
+public:
+    ProfileFlowLineDepth(const PLGeoPath& master);
+    FlowLineDepthModel *clone() const;
+    bool radius(double lat, double lon, double s, double& r);
+private:
+    PLGeoPath profile;
+    double length;
+};
+/*! \brief Result of tracing one flow line.  */
+class FlowLine
+{
+public:
+    /*! Flow line sampled at uniform time intervals.   Empty (no
+      points) if the traced line had less than two points. */
+    PLGeoPath path;
+    /*! False if the depth model was not defined at the origin.
+      The first point of the line is then displaced one oversampled
+      time step from the origin. */
+    bool origin_defined;
+    /*! Index of the oversampled point where the line was extended
+      at constant dip.   -1 if the line was not extended.  */
+    int extension_start;
+    /*! Dip (degrees) used for the extension. */
+    double extension_dip;
+    /*! Last oversampled point before the extension. */
+    Geographic_point extension_origin;
+    FlowLine();
+};
+/*! \brief Traces flow lines through a plate motion model.
+
+  Slab models are built by moving points of a trench line with a
+  stage pole model and assigning each position the depth of a surface
+  (or of a master profile).   This object holds everything that does
+  not depend on the starting point:  the rotation matrix for every
+  oversampled time step is computed once at construction and shared
+  by all lines.
+
+  Each line is traced at time steps dt/oversampling out to the end
+  time.  Where the depth model becomes undefined the line either ends
+  or, when extension is enabled, is continued to the end time at a
+  constant dip estimated from the last two points and clipped to
+  a range.   Times are corrected for the 3d length of each step and
+  the line is resampled at uniform intervals of dt.
+
+  The many line method traces lines on multiple threads.  The depth
+  model is only read by the tracer (each line works on a clone) so
+  results are identical for any number of threads.
+  */
+class FlowLineTracer
+{
+public:
+    /*! \brief Constructor.
+
+      \param spm is the stage pole model defining motion.
+      \param dt is the output time sample interval.  Must use the
+        time units of spm.
+      \param endtime is the total time of each line.
+      \param oversampling is the number of trace steps per dt.
+      \exception GeoCoordError is thrown if dt or oversampling are not
+        positive or endtime is negative.
+      */
+    FlowLineTracer(const StagePoleModel& spm, double dt, double endtime,
+            int oversampling);
+    /*! \brief Enable constant dip extension of lines.
+
+      \param mindip is the smallest dip (degrees) allowed.
+      \param maxdip is the largest dip (degrees) allowed.
+      \param use_local_dip when true the horizontal distance of each
+        extension step is scaled by radius so the dip is constant
+        relative to the local vertical. */
+    void set_extension(double mindip, double maxdip, bool use_local_dip);
+    /*! Disable extension (the default). */
+    void clear_extension();
+    /*! Return number of oversampled steps in a complete line. */
+    int number_steps() const;
+    /*! \brief Trace one flow line.
+
+      \param origin is the starting point.  Only lat and lon are used.
+      \param depth defines depth along the line.  It is cloned so the
+        method is safe to call from multiple threads.
+      \exception GeoCoordError is thrown for inconsistent path data.
+      */
+    FlowLine trace(const Geographic_point& origin,
+            const FlowLineDepthModel& depth) const;
+    /*! \brief Trace a set of flow lines.
+
+      Lines are traced on multiple threads when threaded is true.
+      result[i] is the line starting at origins[i].
+      \exception GeoCoordError is thrown if any line fails.  The
+        message is that of the first failed line in origins order. */
+    vector<FlowLine> trace(const vector<Geographic_point>& origins,
+            const FlowLineDepthModel& depth, bool threaded=true) const;
+private:
+    /* Trace one line with a working copy of the depth model */
+    FlowLine trace_line(const Geographic_point& origin,
+            FlowLineDepthModel& dm) const;
+    double dt;
+    double endtime;
+    int oversampling;
+    int nsteps;
+    /* Rotation matrix for each step (9*(nsteps+1) values) */
+    vector<double> rotations;
+    bool extend;
+    double mindip,maxdip;
+    bool use_local_dip;
+};
+#endif
@@ -1,12 +1,93 @@
 #include <float.h>
+#include <math.h>
 #include "dmatrix.h"
 #include "GCLMVFSmoother.h"
+namespace {
+/* Grids smaller than this are never split between threads */
+const int GCLMVFSThreadThreshold(16384);
+/* Tolerance relative to the largest coefficient for the rank 1 test */
+const double SeparableTolerance(1000.0*DBL_EPSILON);
+/* Correlate each row (constant i) of an n1 by n2 array with w.
+   out[i][j]=sum_k w[k]*in[i][j-off+k] with terms outside the grid
+   dropped.  Arrays are stored by rows. */
+void correlate_rows(const double *in, double *out, int n1, int n2,
+        const double *w, int nw, int off, bool threaded)
+{
+    int i;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(i=0;i<n1;++i)
+    {
+        const double *inrow=in+static_cast<size_t>(i)*n2;
+        double *outrow=out+static_cast<size_t>(i)*n2;
+        for(int j=0;j<n2;++j)
+        {
+            int ks=off-j;
+            if(ks<0) ks=0;
+            int ke=n2+off-j;
+            if(ke>nw) ke=nw;
+            double sum=0.0;
+            for(int k=ks;k<ke;++k) sum+=w[k]*inrow[j-off+k];
+            outrow[j]=sum;
+        }
+    }
+}
+/* Same as correlate_rows but along each column (constant j).  The
+   inner loop runs along rows so memory is accessed sequentially. */
+void correlate_columns(const double *in, double *out, int n1, int n2,
+        const double *w, int nw, int off, bool threaded)
+{
+    int i;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(i=0;i<n1;++i)
+    {
+        double *outrow=out+static_cast<size_t>(i)*n2;
+        int j,k;
+        for(j=0;j<n2;++j) outrow[j]=0.0;
+        int ks=off-i;
+        if(ks<0) ks=0;
+        int ke=n1+off-i;
+        if(ke>nw) ke=nw;
+        for(k=ks;k<ke;++k)
+        {
+            const double *inrow=in+static_cast<size_t>(i-off+k)*n2;
+            for(j=0;j<n2;++j) outrow[j]+=w[k]*inrow[j];
+        }
+    }
+}
+/* Replace an n1 by n2 array by its summed area table.  The table has
+   size (n1+1) by (n2+1) with a leading row and column of zeros so
+   s[i][j] is the sum of in[0..i-1][0..j-1]. */
+void summed_area_table(const double *in, double *s, int n1, int n2,
+        bool threaded)
+{
+    int i,j;
+    int ns2=n2+1;
+    for(j=0;j<ns2;++j) s[j]=0.0;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(i=0;i<n1;++i)
+    {
+        const double *inrow=in+static_cast<size_t>(i)*n2;
+        double *srow=s+static_cast<size_t>(i+1)*ns2;
+        srow[0]=0.0;
+        for(int jj=0;jj<n2;++jj) srow[jj+1]=srow[jj]+inrow[jj];
+    }
+    /* Accumulating down columns is a recursion in i so it is done
+       with whole rows at a time */
+    for(i=1;i<=n1;++i)
+    {
+        double *srow=s+static_cast<size_t>(i)*ns2;
+        const double *sprev=srow-ns2;
+        for(j=1;j<ns2;++j) srow[j]+=sprev[j];
+    }
+}
+}  // end anonymous namespace
 GCLMVFSmoother::GCLMVFSmoother() : firfilter()
 {
     nrow=0;
     ncol=0;
     i0=0;
     j0=0;
+    method=DirectFilter;
 }
 GCLMVFSmoother::GCLMVFSmoother(dmatrix& fircoef, int i0in, int j0in)
          : firfilter(fircoef)
@@ -15,56 +96,199 @@ GCLMVFSmoother::GCLMVFSmoother(dmatrix& fircoef, int i0in, int j0in)
     ncol=firfilter.columns();
     i0=i0in;
     j0=j0in;
+    this->analyze_filter();
 }
-GCLMaskedScalarField GCLMVFSmoother::apply(GCLMaskedScalarField& parent)
+/* Sets method and the filter factors.  A filter is rank 1 if every
+   coefficient is the product of the column and row through the
+   largest coefficient divided by that coefficient. */
+void GCLMVFSmoother::analyze_filter()
+{
+    int k,l;
+    method=DirectFilter;
+    ufilter.clear();
+    vfilter.clear();
+    if((nrow<=0) || (ncol<=0)) return;
+    double wmax(0.0);
+    int kmax(0),lmax(0);
+    bool constant(true);
+    for(k=0;k<nrow;++k)
+        for(l=0;l<ncol;++l)
+        {
+            double w=firfilter(k,l);
+            if(fabs(w)>wmax)
+            {
+                wmax=fabs(w);
+                kmax=k;
+                lmax=l;
+            }
+            if(w!=firfilter(0,0)) constant=false;
+        }
+    if(wmax==0.0) return;
+    if(constant)
+    {
+        method=BoxFilter;
+        ufilter.push_back(firfilter(0,0));
+        return;
+    }
+    double pivot=firfilter(kmax,lmax);
+    ufilter.resize(nrow);
+    vfilter.resize(ncol);
+    for(k=0;k<nrow;++k) ufilter[k]=firfilter(k,lmax);
+    for(l=0;l<ncol;++l) vfilter[l]=firfilter(kmax,l)/pivot;
+    for(k=0;k<nrow;++k)
+        for(l=0;l<ncol;++l)
+        {
+            if(fabs(firfilter(k,l)-ufilter[k]*vfilter[l])
+                    > SeparableTolerance*wmax)
+            {
+                ufilter.clear();
+                vfilter.clear();
+                return;
+            }
+        }
+    method=SeparableFilter;
+}
+/* All three methods compute the same normalized convolution.  The
+   masked field (value times the 0/1 mask indicator) and the indicator
+   itself are filtered the same way.  The smoothed value is the ratio
+   of the two at each valid point.  */
+GCLMaskedScalarField GCLMVFSmoother::apply(GCLMaskedScalarField& parent,
+        bool threaded)
 {
     try{
         GCLMaskedScalarField field(parent);
+        int n1=field.n1;
+        int n2=field.n2;
+        if((n1<=0) || (n2<=0)) return(field);
+        size_t npts=static_cast<size_t>(n1)*n2;
+        threaded=threaded && (npts>GCLMVFSThreadThreshold);
         int i,j;
-        int ii,jj;
-        int is,js;  // variable start for averaging
-        int ie,je;  // variable end
-        int ifilt,jfilt;  // index in firfilter
-        /* to handle variable hits we have to normalize each point
-           independently.  This variable holds that sum for each point */
-        double sumwt;  
-        double smoothval;
-        for(i=0;i<field.n1;++i)
-            for(j=0;j<field.n2;++j)
+        vector<double> fval(npts),fmask(npts);
+        for(i=0;i<n1;++i)
+            for(j=0;j<n2;++j)
             {
+                size_t k=static_cast<size_t>(i)*n2+j;
                 if(field.point_is_valid(i,j))
                 {
-                    is=i-i0;
+                    fval[k]=parent.val[i][j];
+                    fmask[k]=1.0;
+                }
+                else
+                {
+                    fval[k]=0.0;
+                    fmask[k]=0.0;
+                }
+            }
+        /* num and den are the filtered value and mask at each point */
+        vector<double> num(npts,0.0),den(npts,0.0);
+        switch(method)
+        {
+        case BoxFilter:
+            {
+                /* Summed area tables give the window sums in 4 lookups */
+                int ns2=n2+1;
+                vector<double> sval((n1+1)*static_cast<size_t>(ns2));
+                vector<double> smask((n1+1)*static_cast<size_t>(ns2));
+                summed_area_table(&(fval[0]),&(sval[0]),n1,n2,threaded);
+                summed_area_table(&(fmask[0]),&(smask[0]),n1,n2,threaded);
+                double w=ufilter[0];
+#pragma omp parallel for schedule(static) if(threaded)
+                for(i=0;i<n1;++i)
+                {
+                    int is=i-i0;
                     if(is<0) is=0;
-                    js=j-j0;
-                    if(js<0) js=0;
-                    ie=i+nrow;
-                    if(ie>field.n2) ie=field.n1;
-                    je=j+ncol;
-                    if(je>field.n2) je=field.n2;
-                    sumwt=0.0;
-                    smoothval=0.0;
-                    /*loops intentionally focus on ii and jj as 
-                      this is safer*/
-                    for(ii=is,ifilt=0;ii<ie;++i,++ifilt)
-                        for(jj=js,jfilt=0;jj<je;++jj,++jfilt)
+                    int ie=i-i0+nrow;
+                    if(ie>n1) ie=n1;
+                    if(is>=ie) continue;
+                    size_t r0=static_cast<size_t>(is)*ns2;
+                    size_t r1=static_cast<size_t>(ie)*ns2;
+                    for(int jj=0;jj<n2;++jj)
+                    {
+                        int js=jj-j0;
+                        if(js<0) js=0;
+                        int je=jj-j0+ncol;
+                        if(je>n2) je=n2;
+                        if(js>=je) continue;
+                        size_t k=static_cast<size_t>(i)*n2+jj;
+                        num[k]=w*(sval[r1+je]-sval[r0+je]
+                                -sval[r1+js]+sval[r0+js]);
+                        den[k]=w*(smask[r1+je]-smask[r0+je]
+                                -smask[r1+js]+smask[r0+js]);
+                    }
+                }
+            }
+            break;
+        case SeparableFilter:
+            {
+                vector<double> work(npts);
+                correlate_rows(&(fval[0]),&(work[0]),n1,n2,
+                        &(vfilter[0]),ncol,j0,threaded);
+                correlate_columns(&(work[0]),&(num[0]),n1,n2,
+                        &(ufilter[0]),nrow,i0,threaded);
+                correlate_rows(&(fmask[0]),&(work[0]),n1,n2,
+                        &(vfilter[0]),ncol,j0,threaded);
+                correlate_columns(&(work[0]),&(den[0]),n1,n2,
+                        &(ufilter[0]),nrow,i0,threaded);
+            }
+            break;
+        default:
+            {
+                /* Copy the coefficients to a plain array so the inner
+                   loop does not go through the dmatrix interface */
+                vector<double> w(static_cast<size_t>(nrow)*ncol);
+                for(int k=0;k<nrow;++k)
+                    for(int l=0;l<ncol;++l) w[k*ncol+l]=firfilter(k,l);
+#pragma omp parallel for schedule(dynamic) if(threaded)
+                for(i=0;i<n1;++i)
+                {
+                    int ks=i0-i;
+                    if(ks<0) ks=0;
+                    int ke=n1+i0-i;
+                    if(ke>nrow) ke=nrow;
+                    for(int jj=0;jj<n2;++jj)
+                    {
+                        if(!field.point_is_valid(i,jj)) continue;
+                        int ls=j0-jj;
+                        if(ls<0) ls=0;
+                        int le=n2+j0-jj;
+                        if(le>ncol) le=ncol;
+                        double sumval(0.0),sumwt(0.0);
+                        for(int k=ks;k<ke;++k)
                         {
-                            if(field.point_is_valid(ii,jj))
+                            long row=static_cast<long>(i-i0+k)*n2+jj-j0;
+                            const double *wrow=&(w[k*ncol]);
+                            for(int l=ls;l<le;++l)
                             {
-                                sumwt+=firfilter(ifilt,jfilt);
-                                smoothval+=firfilter(ifilt,jfilt)
-                                            *parent.val[ii][jj];
+                                sumval+=wrow[l]*fval[row+l];
+                                sumwt+=wrow[l]*fmask[row+l];
                             }
                         }
-                    /*Careful of null values.  Possible if user gives 0
-                    coefficients in firfilter when smoother interacts 
-                    with irregular shapes */
-                    if(fabs(sumwt)<FLT_EPSILON)
-                        field.val[i][j]=GCLFieldNullValue;
-                    else
-                        field.val[i][j]=smoothval/sumwt;
+                        size_t kout=static_cast<size_t>(i)*n2+jj;
+                        num[kout]=sumval;
+                        den[kout]=sumwt;
+                    }
                 }
             }
+        }
+        /* Only valid points are smoothed.  next_valid_run skips masked
+           regions a word at a time */
+        int nrun,irunend;
+        i=0;
+        j=0;
+        while((nrun=field.next_valid_run(i,j))>0)
+        {
+            for(irunend=i+nrun;i<irunend;++i)
+            {
+                size_t k=static_cast<size_t>(i)*n2+j;
+                /*Careful of null values.  Possible if user gives 0
+                coefficients in firfilter when smoother interacts
+                with irregular shapes */
+                if(fabs(den[k])<FLT_EPSILON)
+                    field.val[i][j]=GCLFieldNullValue;
+                else
+                    field.val[i][j]=num[k]/den[k];
+            }
+        }
         return(field);
     }catch(...){throw;};
 }
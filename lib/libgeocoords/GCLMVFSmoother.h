@@ -1,7 +1,22 @@
 #ifndef _GCLMVFSMOOTHER_H_
 #define _GCLMVFSMOOTHER_H_
+#include <vector>
 #include "GCLMasked.h"
 #include "dmatrix.h"
+/*! \brief Smoother for masked scalar fields.
+
+  Applies a rectangular fir filter to a GCLMaskedScalarField.  Masked
+  points do not contribute to the result and the filter weights are
+  renormalized at each point by the sum of the weights that hit valid
+  points (normalized convolution).  Only valid points are altered.
+
+  The filter is analyzed when the object is constructed.  A box filter
+  (all coefficients equal) is applied with summed area tables in a time
+  independent of the filter size.   A filter that is the outer product
+  of two vectors (rank 1) is applied as two one dimensional passes.
+  Other filters are applied directly.  All three give the same result
+  to rounding error.
+  */
 class GCLMVFSmoother
 {
     public:
@@ -10,17 +25,37 @@ class GCLMVFSmoother
 
            This defines a rectangular fir filter for the grid
            input with a dmatrix.  i will run on x1 axis while
-           j will run over x2 axis.  
+           j will run over x2 axis.
            \param firfilter contains the fir coefficients (normalization
              is not required)
            \param i0 offset in i (x1) direction for 0 lag.  C indexing.
            \param j0 offset in j (x2) direction for 0 lag.  C indexing.
            */
         GCLMVFSmoother(dmatrix& firfilter,int i0in, int j0in);
-        GCLMaskedScalarField apply(GCLMaskedScalarField& parent);
+        /*! \brief Smooth a field.
+
+          The value at valid point i,j of the result is the weighted
+          average of valid points i-i0+k, j-j0+l of parent using weight
+          k,l of the filter.  Points where the sum of the weights is
+          near zero are set to GCLFieldNullValue.
+
+          \param parent is the field to smooth.
+          \param threaded when true (default) large grids are split
+            between threads by rows.
+          \return copy of parent with valid points smoothed.
+          */
+        GCLMaskedScalarField apply(GCLMaskedScalarField& parent,
+                bool threaded=true);
     private:
         dmatrix firfilter;
         int nrow,ncol;
         int i0,j0;  //Offset of 0 value
+        /* Algorithm selected by the constructor from the filter shape */
+        enum SmootherMethod {DirectFilter, SeparableFilter, BoxFilter};
+        SmootherMethod method;
+        /* Factors of a rank 1 filter:  firfilter(k,l)=ufilter[k]*vfilter[l].
+           For a box filter ufilter[0] holds the constant coefficient. */
+        vector<double> ufilter,vfilter;
+        void analyze_filter();
 };
 #endif
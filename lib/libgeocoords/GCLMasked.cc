@@ -1,66 +1,378 @@
 #include "fstream"
+#include <sys/stat.h>
 #include "GCLgridError.h"
 #include "gclgrid.h"
 #include "dmatrix.h"
 #include "GCLMasked.h"
 /* First in this file - GCLMask code. */
+namespace {
+/* Bit scanning.  Use the compiler builtins when available. */
+inline int popcount64(uint64_t w)
+{
+#ifdef __GNUC__
+    return(__builtin_popcountll(w));
+#else
+    int n(0);
+    while(w) 
+    {
+        w&=(w-1);
+        ++n;
+    }
+    return(n);
+#endif
+}
+/* Index of lowest set bit.  w must not be 0 */
+inline int lowbit64(uint64_t w)
+{
+#ifdef __GNUC__
+    return(__builtin_ctzll(w));
+#else
+    int n(0);
+    while(!(w&1))
+    {
+        w>>=1;
+        ++n;
+    }
+    return(n);
+#endif
+}
+/* Index of highest set bit.  w must not be 0 */
+inline int highbit64(uint64_t w)
+{
+#ifdef __GNUC__
+    return(63-__builtin_clzll(w));
+#else
+    int n(0);
+    while(w>>=1) ++n;
+    return(n);
+#endif
+}
+/* Mask of the bits used in the last word of a line of n bits */
+inline uint64_t lastwordmask(int n)
+{
+    int nr=n&63;
+    if(nr==0) return(~static_cast<uint64_t>(0));
+    return((static_cast<uint64_t>(1)<<nr)-1);
+}
+/* Key stored in the header of binary mask files.   Mask files are not
+   a cache so the key only serves as a check on the file contents. */
+const uint64_t GCLMaskFileKey(0x47434c4d61736b31ULL);
+}  // end anonymous namespace
 GCLMask::GCLMask()
 {
     n1_mask=0;
     n2_mask=0;
+    nwords=0;
 }
 GCLMask::GCLMask(string base_name)
 {
-    string fname;
-    fname=base_name+".mask";
-    std::ifstream ifs(fname.c_str(),ios::in);
-    boost::archive::text_iarchive ia(ifs);
-    ia >> *this;
+    string bname,tname;
+    struct stat bsb,tsb;
+    bname=base_name+".bmask";
+    tname=base_name+".mask";
+    bool have_binary=(stat(bname.c_str(),&bsb)==0);
+    bool have_text=(stat(tname.c_str(),&tsb)==0);
+    /* When both exist the newer file wins.  A stale binary file left
+       behind after the text archive was rewritten is otherwise 
+       silently used. */
+    if(have_binary && have_text && (tsb.st_mtime>bsb.st_mtime))
+        have_binary=false;
+    if(have_binary)
+    {
+        try{
+            BinaryCacheReader in(bname,GCLMASK_FILE,GCLMaskFileKey);
+            *this=GCLMask(in);
+        }catch(GeoCoordError& err)
+        {
+            throw GCLgridError(string("GCLMask file constructor:  ")
+                    + err.what());
+        }
+    }
+    else
+    {
+        /* Fall back to the boost text archive used by older versions */
+        std::ifstream ifs(tname.c_str(),ios::in);
+        if(ifs.fail())
+            throw GCLgridError(string("GCLMask file constructor:  ")
+                    + "cannot open "+bname+" or "+tname);
+        boost::archive::text_iarchive ia(ifs);
+        ia >> *this;
+    }
+}
+GCLMask::GCLMask(BinaryCacheReader& in)
+{
+    size_t n;
+    const int *sizes=in.next_int(n);
+    if((n!=2) || (sizes[0]<0) || (sizes[1]<0))
+        throw GCLgridError(string("GCLMask binary file constructor:  ")
+                + "invalid grid size record");
+    n1_mask=sizes[0];
+    n2_mask=sizes[1];
+    nwords=(n1_mask+63)/64;
+    const uint64_t *words=in.next_uint64(n);
+    if(n!=static_cast<size_t>(nwords)*n2_mask)
+        throw GCLgridError(string("GCLMask binary file constructor:  ")
+                + "mask size does not match grid size");
+    /* Bits past n1 in the last word of each line must be clear.  Set
+       padding bits would be counted by the bit scanning methods. */
+    if(nwords>0)
+    {
+        uint64_t padmask=~lastwordmask(n1_mask);
+        for(int j=0;j<n2_mask;++j)
+            if(words[j*nwords+nwords-1] & padmask)
+                throw GCLgridError(string("GCLMask binary file constructor:  ")
+                        + "padding bits set in mask file");
+    }
+    bits.assign(words,words+n);
 }
 GCLMask::GCLMask(GCLgrid& parent)
 {
     n1_mask=parent.n1;
     n2_mask=parent.n2;
-    int ntotal=parent.n1*parent.n2;
-    valid.reserve(ntotal);
-    int k;
-    for(k=0;k<ntotal;++k)valid.push_back(false);
+    nwords=(n1_mask+63)/64;
+    bits.assign(nwords*n2_mask,0);
+}
+GCLMask::GCLMask(int n1, int n2, bool initial)
+{
+    if(n1<0) n1=0;
+    if(n2<0) n2=0;
+    n1_mask=n1;
+    n2_mask=n2;
+    nwords=(n1_mask+63)/64;
+    bits.assign(nwords*n2_mask,0);
+    if(initial) this->enable_all();
 }
-GCLMask::GCLMask(const GCLMask& parent) : valid(parent.valid)
+GCLMask::GCLMask(const GCLMask& parent) : bits(parent.bits)
 {
     n1_mask=parent.n1_mask;
     n2_mask=parent.n2_mask;
+    nwords=parent.nwords;
 }
 GCLMask& GCLMask::operator=(const GCLMask& parent)
 {
     if(this != & parent)
     {
-        this->valid=parent.valid;
+        this->bits=parent.bits;
         n1_mask=parent.n1_mask;
         n2_mask=parent.n2_mask;
+        nwords=parent.nwords;
     }
     return(*this);
 }
-bool GCLMask::mask_point(int i, int j)
+void GCLMask::write(BinaryCacheWriter& out) const
+{
+    int sizes[2];
+    sizes[0]=n1_mask;
+    sizes[1]=n2_mask;
+    out.write(sizes,2);
+    out.write(bits);
+}
+void GCLMask::save_mask(string base_name) const
+{
+    try{
+        BinaryCacheWriter out(base_name+".bmask",GCLMASK_FILE,
+                GCLMaskFileKey);
+        this->write(out);
+        out.close();
+    }catch(GeoCoordError& err)
+    {
+        throw GCLgridError(string("GCLMask::save_mask:  ")+err.what());
+    }
+}
+void GCLMask::check_size(const GCLMask& other, const string op) const
+{
+    if((n1_mask!=other.n1_mask) || (n2_mask!=other.n2_mask))
+        throw GCLgridError(string("GCLMask::operator")+op
+                + ":  masks are not the same size");
+}
+GCLMask& GCLMask::operator&=(const GCLMask& other)
+{
+    this->check_size(other,"&=");
+    int n=bits.size();
+    for(int k=0;k<n;++k) bits[k] &= other.bits[k];
+    return(*this);
+}
+GCLMask& GCLMask::operator|=(const GCLMask& other)
+{
+    this->check_size(other,"|=");
+    int n=bits.size();
+    for(int k=0;k<n;++k) bits[k] |= other.bits[k];
+    return(*this);
+}
+GCLMask& GCLMask::operator^=(const GCLMask& other)
+{
+    this->check_size(other,"^=");
+    int n=bits.size();
+    for(int k=0;k<n;++k) bits[k] ^= other.bits[k];
+    return(*this);
+}
+void GCLMask::check_archive_size(size_t n, size_t nexpected) const
+{
+    const string base_error("GCLMask text file reader:  ");
+    if((n1_mask<0) || (n2_mask<0))
+        throw GCLgridError(base_error + "invalid grid size record");
+    if(n!=nexpected)
+        throw GCLgridError(base_error 
+                + "mask size does not match grid size");
+}
+void GCLMask::clear_padding()
+{
+    if(nwords==0) return;
+    uint64_t lastmask=lastwordmask(n1_mask);
+    for(int j=0;j<n2_mask;++j) bits[j*nwords+nwords-1] &= lastmask;
+}
+void GCLMask::invert()
+{
+    if(nwords==0) return;
+    uint64_t lastmask=lastwordmask(n1_mask);
+    for(int j=0;j<n2_mask;++j)
+    {
+        uint64_t *row=&(bits[j*nwords]);
+        for(int w=0;w<nwords;++w) row[w]=~row[w];
+        row[nwords-1] &= lastmask;
+    }
+}
+void GCLMask::enable_all()
+{
+    if(nwords==0) return;
+    bits.assign(bits.size(),~static_cast<uint64_t>(0));
+    uint64_t lastmask=lastwordmask(n1_mask);
+    for(int j=0;j<n2_mask;++j) bits[j*nwords+nwords-1]=lastmask;
+}
+void GCLMask::mask_all()
+{
+    bits.assign(bits.size(),0);
+}
+int GCLMask::number_valid() const
+{
+    int count(0);
+    int n=bits.size();
+    for(int k=0;k<n;++k) count+=popcount64(bits[k]);
+    return(count);
+}
+bool GCLMask::valid_bounding_box(int& imin, int& imax, int& jmin, 
+        int& jmax) const
+{
+    int i0(n1_mask),i1(-1),j0(n2_mask),j1(-1);
+    for(int j=0;j<n2_mask;++j)
+    {
+        const uint64_t *row=&(bits[j*nwords]);
+        int w;
+        for(w=0;w<nwords;++w) if(row[w]) break;
+        if(w>=nwords) continue;
+        int ifirst=64*w+lowbit64(row[w]);
+        for(w=nwords-1;w>=0;--w) if(row[w]) break;
+        int ilast=64*w+highbit64(row[w]);
+        if(ifirst<i0) i0=ifirst;
+        if(ilast>i1) i1=ilast;
+        if(j<j0) j0=j;
+        j1=j;
+    }
+    if(j1<0) return false;
+    imin=i0;
+    imax=i1;
+    jmin=j0;
+    jmax=j1;
+    return true;
+}
+int GCLMask::next_valid_run(int& i, int& j) const
+{
+    if(i<0) i=0;
+    if(j<0) 
+    {
+        j=0;
+        i=0;
+    }
+    while(j<n2_mask)
+    {
+        if(i<n1_mask)
+        {
+            const uint64_t *row=&(bits[j*nwords]);
+            /* Find the first valid point */
+            int w=i>>6;
+            uint64_t word=row[w] & ((~static_cast<uint64_t>(0))<<(i&63));
+            while(word==0)
+            {
+                ++w;
+                if(w>=nwords) break;
+                word=row[w];
+            }
+            if(w<nwords)
+            {
+                i=64*w+lowbit64(word);
+                /* Now find the first masked point after i.  Padding 
+                   bits are zero so this always stops by n1_mask */
+                w=i>>6;
+                word=(~row[w]) & ((~static_cast<uint64_t>(0))<<(i&63));
+                while(word==0)
+                {
+                    ++w;
+                    if(w>=nwords) break;
+                    word=~row[w];
+                }
+                int iend;
+                if(w>=nwords)
+                    iend=n1_mask;
+                else
+                    iend=64*w+lowbit64(word);
+                if(iend>n1_mask) iend=n1_mask;
+                return(iend-i);
+            }
+        }
+        ++j;
+        i=0;
+    }
+    return(0);
+}
+/* A cell is valid if rows j and j+1 are both valid at i and i+1.  
+   With a=row(j)&row(j+1) that is a & (a>>1) where the shift carries 
+   the low bit of the next word into the top of the current word. */
+GCLMask GCLMask::cell_mask() const
+{
+    int nc1=n1_mask-1;
+    int nc2=n2_mask-1;
+    if((nc1<=0) || (nc2<=0)) return(GCLMask(0,0));
+    GCLMask result(nc1,nc2);
+    int j,w;
+    for(j=0;j<nc2;++j)
+    {
+        const uint64_t *row0=&(bits[j*nwords]);
+        const uint64_t *row1=&(bits[(j+1)*nwords]);
+        uint64_t *out=&(result.bits[j*result.nwords]);
+        for(w=0;w<result.nwords;++w)
+        {
+            uint64_t a=row0[w] & row1[w];
+            uint64_t anext(0);
+            if(w+1<nwords) anext=row0[w+1] & row1[w+1];
+            out[w]=a & ((a>>1) | (anext<<63));
+        }
+        out[result.nwords-1] &= lastwordmask(nc1);
+    }
+    return(result);
+}
+GCLMask operator&(const GCLMask& a, const GCLMask& b)
+{
+    GCLMask result(a);
+    result&=b;
+    return(result);
+}
+GCLMask operator|(const GCLMask& a, const GCLMask& b)
 {
-    if(i<0 || (i>=n1_mask)) return false;
-    if(j<0 || (j>=n2_mask)) return false;
-    valid[this->voffset(i,j)] = false;
-    return(true);
+    GCLMask result(a);
+    result|=b;
+    return(result);
 }
-bool GCLMask::enable_point(int i, int j)
+GCLMask operator^(const GCLMask& a, const GCLMask& b)
 {
-    if(i<0 || (i>=n1_mask)) return false;
-    if(j<0 || (j>=n2_mask)) return false;
-    valid[this->voffset(i,j)] = true;
-    return(true);
+    GCLMask result(a);
+    result^=b;
+    return(result);
 }
-bool GCLMask::point_is_valid(int i, int j)
+GCLMask operator~(const GCLMask& a)
 {
-    if(i<0 || (i>=n1_mask)) return false;
-    if(j<0 || (j>=n2_mask)) return false;
-    int k=voffset(i,j);
-    return(valid[k]);
+    GCLMask result(a);
+    result.invert();
+    return(result);
 }
 
 
@@ -68,6 +380,9 @@ bool GCLMask::point_is_valid(int i, int j)
 GCLMaskedGrid::GCLMaskedGrid(string fname) 
     : GCLgrid(fname),GCLMask(fname)
 {
+    if((n1!=n1_mask) || (n2!=n2_mask))
+        throw GCLgridError(string("GCLMaskedGrid file constructor:  ")
+                + "mask size does not match grid size for "+fname);
 }
 GCLMaskedGrid::GCLMaskedGrid(GCLgrid& parent) : GCLgrid(parent), GCLMask(parent)
 {
@@ -76,7 +391,7 @@ GCLMaskedGrid::GCLMaskedGrid(GCLgrid& g,GCLMask& mask) : GCLgrid(g), GCLMask(mas
 {
 }
 GCLMaskedGrid::GCLMaskedGrid(GCLgrid& parent, dmatrix& mask, double maskmin)
-                        : GCLgrid(parent)
+                        : GCLgrid(parent), GCLMask(parent)
 {
     const string base_error("GCLMaskedGrid constructor with dmatrix mask:  ");
     if(mask.columns()!=parent.n2) throw GCLgridError(base_error
@@ -116,16 +431,10 @@ void GCLMaskedGrid::save(string fname)
        store base data.  Limitation here is I don't allow use
      of a directory as in GCLgrid library.  Alway current directory*/
         this->GCLgrid::save(fname,string("."));
-        /* we have a boost serialization to save the mask data.
-           We store that in a name derived from fname.  This 
-           assume format with fname+".dat" as data and fname+".pf" 
-           to store metadata. */
-        string maskfile=fname+".mask";
-        std::ofstream ofs(maskfile.c_str(),ios::out);
-        boost::archive::text_oarchive oa(ofs);
-        GCLMask *mask=dynamic_cast<GCLMask*>(this);
-        oa << *mask;
-        ofs.close();
+        /* The mask is stored in a binary file with a name derived
+           from fname.  The grid files use fname+".dat" as data and 
+           fname+".pf" to store metadata. */
+        this->save_mask(fname);
     }catch(...){throw;};
 }
 GCLMaskedVectorField::GCLMaskedVectorField(GCLvectorfield& f, GCLMask& m) 
@@ -157,21 +466,18 @@ void GCLMaskedVectorField::save(string fname)
        store base data.  Limitation here is I don't allow use
      of a directory as in GCLgrid library.  Alway current directory*/
         this->GCLvectorfield::save(fname,string("."));
-        /* we have a boost serialization to save the mask data.
-           We store that in a name derived from fname.  This 
-           assume format with fname+".dat" as data and fname+".pf" 
-           to store metadata. */
-        string maskfile=fname+".mask";
-        std::ofstream ofs(maskfile.c_str(),ios::out);
-        boost::archive::text_oarchive oa(ofs);
-        GCLMask *mask=dynamic_cast<GCLMask*>(this);
-        oa << *mask;
-        ofs.close();
+        /* The mask is stored in a binary file with a name derived
+           from fname.  The grid files use fname+".dat" as data and 
+           fname+".pf" to store metadata. */
+        this->save_mask(fname);
     }catch(...){throw;};
 }
 GCLMaskedScalarField::GCLMaskedScalarField(string fname) 
     : GCLscalarfield(fname,default_output_format,false),GCLMask(fname)
 {
+    if((n1!=n1_mask) || (n2!=n2_mask))
+        throw GCLgridError(string("GCLMaskedScalarField file constructor:  ")
+                + "mask size does not match grid size for "+fname);
 }
 GCLMaskedScalarField::GCLMaskedScalarField(GCLscalarfield& f, GCLMask& m) 
     : GCLscalarfield(f), GCLMask(m)
@@ -202,15 +508,9 @@ void GCLMaskedScalarField::save(string fname)
        store base data.  Limitation here is I don't allow use
      of a directory as in GCLgrid library.  Alway current directory*/
         this->GCLscalarfield::save(fname,string("."));
-        /* we have a boost serialization to save the mask data.
-           We store that in a name derived from fname.  This 
-           assume format with fname+".dat" as data and fname+".pf" 
-           to store metadata. */
-        string maskfile=fname+".mask";
-        std::ofstream ofs(maskfile.c_str(),ios::out);
-        boost::archive::text_oarchive oa(ofs);
-        GCLMask *mask=dynamic_cast<GCLMask*>(this);
-        oa << *mask;
-        ofs.close();
+        /* The mask is stored in a binary file with a name derived
+           from fname.  The grid files use fname+".dat" as data and 
+           fname+".pf" to store metadata. */
+        this->save_mask(fname);
     }catch(...){throw;};
 }
@@ -1,10 +1,14 @@
 #ifndef _GCLMASK_H_
 #define _GCLMASK_H_
 #include <vector>
+#include <stdint.h>
 #include "dmatrix.h"
 #include "gclgrid.h"
+#include "BinaryCacheFile.h"
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 /*! Undefined values in a field are set to this magic value */
@@ -15,6 +19,23 @@ const double GCLFieldNullValue(-9.99999e-99);
   extent to a distorted square in 3 space.  A mask is one way to 
   build a more complex shape.   Grid cells are defined as either valid
   or invalid (true or false respectively).   
+
+  The mask is stored as a bitset packed in 64 bit words.  Each x2 index
+  (j) starts a new word so each grid line with constant j is a word
+  aligned run of bits with x1 (i) varying fastest.   That allows whole 
+  masks to be combined with boolean operators a word at a time and 
+  allows loops over the grid to skip masked regions 64 points at a 
+  time with the next_valid_run method.   A typical loop over all 
+  valid points is:
+
+  \code
+  int i(0),j(0),n;
+  while((n=mask.next_valid_run(i,j))>0)
+  {
+      for(int k=i;k<i+n;++k)  do something with point k,j
+      i+=n;
+  }
+  \endcode
   */
 class GCLMask
 {
@@ -23,14 +44,27 @@ class GCLMask
         GCLMask();
         /*! \brief Construct from a file.
 
-          This constructs the object from a file name.  This 
-          implementation uses boost's serialization to create 
-          the object from a file name convention.  
+          This constructs the object from a file name.  The binary 
+          file base_name + ".bmask" written by save_mask is memory 
+          mapped and the packed mask words copied directly so the load 
+          time is independent of the number of masked points.   If 
+          that file does not exist, or the older boost serialization 
+          text file base_name + ".mask" is newer, the text file is read 
+          instead.  Text files written before the mask was stored as a 
+          bitset are read correctly.
 
-          \param base_name is used to construct the file name for
-            data as base_name + ".mask"
+          \param base_name is the root name of the mask file.
+          \exception GCLgridError is thrown if neither file can be read
+            or the binary file is corrupt (including padding bits set
+            past the end of a line).
             */
         GCLMask(string base_name);
+        /*! \brief Construct from an open binary file.
+
+          Reads the next mask from a file written with the write method.
+          \exception GCLgridError is thrown if the data are not 
+            consistent.  GeoCoordError can be thrown by the reader. */
+        GCLMask(BinaryCacheReader& in);
         /*! \brief Build an initial mask based on a pattern grid.
 
           A GCLMask object is used to turn components on or off of a GCLgrod
@@ -38,6 +72,14 @@ class GCLMask
           builds a pattern based on g and initializes all cells to
           invalid.   Use enable_point method to turn points back on. */
         GCLMask(GCLgrid& g);
+        /*! \brief Build a mask of a specified size.
+
+          \param n1 is the number of points in the x1 direction.
+          \param n2 is the number of points in the x2 direction.
+          \param initial is the value of all points (default false 
+            meaning all points are masked).
+          */
+        GCLMask(int n1, int n2, bool initial=false);
         /*! Standard copy constructor. */
         GCLMask(const GCLMask& parent);
         GCLMask& operator=(const GCLMask& parent);
@@ -48,7 +90,13 @@ class GCLMask
            \param j is x2 index of point to mask
            \return true on success.  false if failed (outside range implied)
            */
-        bool mask_point(int i, int j);
+        bool mask_point(int i, int j)
+        {
+            if(i<0 || (i>=n1_mask)) return false;
+            if(j<0 || (j>=n2_mask)) return false;
+            bits[woffset(i,j)] &= ~bitmask(i);
+            return(true);
+        };
         /*! \brief  Define point i,j of the grid as valid.
 
            When building a mask point by point this is a core method.
@@ -57,7 +105,13 @@ class GCLMask
            \param j is x2 index of point to mask
            \return true on success.  false if failed (outside range implied)
            */
-        bool enable_point(int i, int j);
+        bool enable_point(int i, int j)
+        {
+            if(i<0 || (i>=n1_mask)) return false;
+            if(j<0 || (j>=n2_mask)) return false;
+            bits[woffset(i,j)] |= bitmask(i);
+            return(true);
+        };
         /*! \brief Query if a point is marked as visible.
 
            This is a core method.  Returns true if the point at grid
@@ -68,34 +122,152 @@ class GCLMask
            \param j is x2 index of point to query
 
            */
-        bool point_is_valid(int i, int j);
-        int nx1(){return n1_mask;};
-        int nx2(){return n2_mask;};
+        bool point_is_valid(int i, int j) const
+        {
+            if(i<0 || (i>=n1_mask)) return false;
+            if(j<0 || (j>=n2_mask)) return false;
+            return((bits[woffset(i,j)] & bitmask(i)) != 0);
+        };
+        int nx1() const {return n1_mask;};
+        int nx2() const {return n2_mask;};
+        /*! \brief Logical and with another mask.
+
+          A point is valid in the result only if it is valid in both.
+          \exception GCLgridError is thrown if the masks are not the 
+            same size.  */
+        GCLMask& operator&=(const GCLMask& other);
+        /*! Logical or with another mask.  Throws a GCLgridError if the
+          masks are not the same size.*/
+        GCLMask& operator|=(const GCLMask& other);
+        /*! Logical exclusive or with another mask.  Throws a GCLgridError 
+          if the masks are not the same size.*/
+        GCLMask& operator^=(const GCLMask& other);
+        /*! Invert the mask.  Valid points become masked and vice versa. */
+        void invert();
+        /*! Define all points as valid. */
+        void enable_all();
+        /*! Define all points as masked. */
+        void mask_all();
+        /*! Return the number of valid points. */
+        int number_valid() const;
+        /*! \brief Find the range of indices containing all valid points.
+
+          \param imin is set to the smallest i of any valid point.
+          \param imax is set to the largest i of any valid point.
+          \param jmin is set to the smallest j of any valid point.
+          \param jmax is set to the largest j of any valid point.
+          \return false if there are no valid points, in which case the
+            arguments are not altered.  Returns true otherwise.
+          */
+        bool valid_bounding_box(int& imin, int& imax, int& jmin, 
+                int& jmax) const;
+        /*! \brief Find the next run of valid points.
+
+          Searches the mask in storage order (i varies fastest) for the 
+          first valid point at or after i,j.   Runs of masked points are
+          skipped a word at a time.   A run never continues past the 
+          end of the line of constant j.
+
+          \param i is the x1 index to start the search.  On return it 
+            is the x1 index of the first point of the run.
+          \param j is the x2 index to start the search.  On return it 
+            is the x2 index of the run.
+          \return number of valid points in the run starting at i,j.  
+            Returns 0 when there are no more valid points.
+          */
+        int next_valid_run(int& i, int& j) const;
+        /*! \brief Build the mask of valid cells.
+
+          A grid cell is the quadrilateral with corners i,j and i+1,j+1.
+          This returns a mask of size (nx1()-1) by (nx2()-1) in which 
+          cell i,j is valid only if all four corners are valid in this 
+          mask.  This is what is needed to draw a masked surface.*/
+        GCLMask cell_mask() const;
+        /*! \brief Write the mask to an open binary file.
+
+          The grid size is written followed by the packed mask words 
+          in native byte order. */
+        void write(BinaryCacheWriter& out) const;
+        /*! \brief Save the mask to a binary file.
+
+          Writes base_name + ".bmask" with a fixed header (see 
+          BinaryCacheWriter) followed by the output of the write method.
+          This is the file read by the file name constructor.
+          \exception GCLgridError is thrown if the file cannot be written.
+          */
+        void save_mask(string base_name) const;
     protected:
-        /* Created as a single array, easily indexed 
-           because GCLgrid is n1xn2 */
-        vector<bool> valid;
+        /* Validity bits.  Point i,j is bit i%64 of word bits[woffset(i,j)].
+           Each j starts a new word and bits past n1_mask in the last 
+           word of a line are always zero.   */
+        vector<uint64_t> bits;
         /* These are the sizes used to create mask.  Constructors check these for 
            consistency when applied to a parent GCLgrid */
         int n1_mask, n2_mask;
+        /* Number of words for each line of constant j */
+        int nwords;
+        /* convenience routines */
+        int woffset(int i, int j) const
+        {
+            return(j*nwords+(i>>6));
+        }
+        static uint64_t bitmask(int i)
+        {
+            return(static_cast<uint64_t>(1)<<(i&63));
+        }
     private:
+        void check_size(const GCLMask& other, const string op) const;
+        /* Used by load.  Throws a GCLgridError if the sizes read are 
+           negative or an array of length n read from an archive does 
+           not have the length nexpected implied by them. */
+        void check_archive_size(size_t n, size_t nexpected) const;
+        /* Used by load to zero bits past n1_mask in the last word of 
+           each line */
+        void clear_padding();
         /* These are used for input and output of this object. Uses base class definitions
-           from gclgrid */
+           from gclgrid.  Version 0 files stored the mask as a vector<bool> */
         friend class boost::serialization::access;
-        template<class Archive>void serialize(Archive & ar, const unsigned int version)
+        template<class Archive>void save(Archive & ar, const unsigned int version) const
         {
             ar & n1_mask;
             ar & n2_mask;
-            ar & valid;
+            ar & bits;
         };
-        /* convenience routine */
-        int voffset(int i, int j)
+        template<class Archive>void load(Archive & ar, const unsigned int version)
         {
-            int result;
-            result=j*n1_mask+i;
-            return(result);
-        }
+            ar & n1_mask;
+            ar & n2_mask;
+            nwords=(n1_mask+63)/64;
+            if(version==0)
+            {
+                vector<bool> valid;
+                ar & valid;
+                this->check_archive_size(valid.size(),
+                        static_cast<size_t>(n1_mask)*n2_mask);
+                bits.assign(nwords*n2_mask,0);
+                for(int j=0;j<n2_mask;++j)
+                    for(int i=0;i<n1_mask;++i)
+                        if(valid[j*n1_mask+i]) bits[woffset(i,j)] |= bitmask(i);
+            }
+            else
+            {
+                ar & bits;
+                this->check_archive_size(bits.size(),
+                        static_cast<size_t>(nwords)*n2_mask);
+                this->clear_padding();
+            }
+        };
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
+BOOST_CLASS_VERSION(GCLMask,1)
+/*! Logical and of two masks.*/
+GCLMask operator&(const GCLMask& a, const GCLMask& b);
+/*! Logical or of two masks.*/
+GCLMask operator|(const GCLMask& a, const GCLMask& b);
+/*! Logical exclusive or of two masks.*/
+GCLMask operator^(const GCLMask& a, const GCLMask& b);
+/*! Return the inverse of a mask.*/
+GCLMask operator~(const GCLMask& a);
 class GCLMaskedGrid : public GCLgrid, public GCLMask
 {
     public:
@@ -105,9 +277,12 @@ class GCLMaskedGrid : public GCLgrid, public GCLMask
 
           This constructor will read the output of the save
           method and recreate a clone of the file saved previously.
-          This implementation uses boost serialization in a text file. 
+          The grid is read with the GCLgrid file constructor and the 
+          mask with the GCLMask file name constructor.
 
           \param fname is the file name where data is stored. 
+          \exception GCLgridError is thrown if the mask size does not
+            match the grid.
           */
         GCLMaskedGrid(string fname);
         /* \brief Construct with no original mask.
@@ -150,7 +325,8 @@ class GCLMaskedGrid : public GCLgrid, public GCLMask
 class GCLMaskedScalarField : public GCLscalarfield, public GCLMask
 {
     public:
-        /*! Construct from a file with root hame fname. */
+        /*! Construct from a file with root hame fname.  
+          Throws a GCLgridError if the mask size does not match the grid.*/
         GCLMaskedScalarField(string fname);
         GCLMaskedScalarField(GCLscalarfield& g, GCLMask& m);
         GCLMaskedScalarField(GCLMaskedGrid& g);
@@ -175,4 +351,22 @@ class TiePoint
         double radius;
         int i_tie, j_tie;
 };
+/*! \brief Compute unit normals to a masked grid surface.
+
+  Normals are the normalized cross product of differences along the
+  x1 and x2 grid directions in the grid's cartesian frame.  Forward
+  differences are used except on the last row and column and next to 
+  masked points.   Masked points and points with no valid neighbor are 
+  set to GCLFieldNullValue.
+  \exception GCLgridError is thrown if either grid dimension is less 
+    than 2.
+  */
+GCLMaskedVectorField ComputeNormals(GCLMaskedGrid& raw);
+/*! \brief Compute unit local vertical vectors at each point of a grid.
+
+  The local vertical is the radial direction from the earth's center
+  expressed in the grid's cartesian frame.  It is computed directly 
+  from the cartesian coordinates and is defined for all points.
+  */
+GCLMaskedVectorField ComputeLocalVerticals(GCLMaskedGrid& raw);
 #endif
@@ -5,67 +5,268 @@ double CartesianDistance(Cartesian_point& cp1, Cartesian_point& cp2)
 {
     double x,dx;
     dx=cp2.x1-cp1.x1;
-    x+=dx*dx;
+    x=dx*dx;
     dx=cp2.x2-cp1.x2;
     x+=dx*dx;
     dx=cp2.x3-cp1.x3;
     x+=dx*dx;
     return(sqrt(x));
 }
-// These procedures should probably set values outside mask to some
-// stock not define value 
+namespace {
+/* Grids smaller than this are never split between threads */
+const int GMPThreadThreshold(16384);
+/* Radius and unit direction from the earth's center of every point of
+   a grid expressed in the grid's cartesian frame.  The procedures 
+   below work at constant radius along lines of constant j.  With these
+   arrays that needs no ctog/gtoc calls:  a point with the direction of
+   point k and radius r is center+r*u[k].  Arrays are stored with i 
+   varying fastest so each line of constant j is contiguous. */
+class RadialGridGeometry
+{
+public:
+    RadialGridGeometry(GCLgrid& g, bool threaded);
+    int index(int i, int j) const {return(j*n1+i);};
+    /* Distance from point k to the point with the direction of k+1
+       (i+1,j) and the radius of k.   This is the dx1 of dx1_offset. */
+    double dx1(int k) const
+    {
+        const double *a=&(u[3*k]);
+        double d0=a[3]-a[0];
+        double d1=a[4]-a[1];
+        double d2=a[5]-a[2];
+        return(r[k]*sqrt(d0*d0+d1*d1+d2*d2));
+    };
+    /* Cartesian coordinates of the point with direction k at radius rk*/
+    void point(int k, double rk, double *x) const
+    {
+        x[0]=center.x1+rk*u[3*k];
+        x[1]=center.x2+rk*u[3*k+1];
+        x[2]=center.x3+rk*u[3*k+2];
+    };
+    int n1,n2;
+    Cartesian_point center;
+    vector<double> r;
+    vector<double> u;
+};
+RadialGridGeometry::RadialGridGeometry(GCLgrid& g, bool threaded)
+{
+    n1=g.n1;
+    n2=g.n2;
+    /* gtoc of a zero radius is the earth's center for any lat,lon */
+    center=g.gtoc(0.0,0.0,0.0);
+    size_t npts=static_cast<size_t>(n1)*n2;
+    r.resize(npts);
+    u.resize(3*npts);
+    int j;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(j=0;j<n2;++j)
+    {
+        for(int i=0;i<n1;++i)
+        {
+            int k=j*n1+i;
+            double v0=g.x1[i][j]-center.x1;
+            double v1=g.x2[i][j]-center.x2;
+            double v2=g.x3[i][j]-center.x3;
+            double rk=sqrt(v0*v0+v1*v1+v2*v2);
+            r[k]=rk;
+            if(rk>0.0)
+            {
+                u[3*k]=v0/rk;
+                u[3*k+1]=v1/rk;
+                u[3*k+2]=v2/rk;
+            }
+            else
+            {
+                u[3*k]=0.0;
+                u[3*k+1]=0.0;
+                u[3*k+2]=1.0;
+            }
+        }
+    }
+}
+}  // end anonymous namespace
+namespace {
+/* Unit normal at i,j from one sided differences for the cases the row
+   kernel in ComputeNormals cannot handle because of the mask.  Uses a 
+   forward difference when that neighbor is valid and a backward 
+   difference otherwise.  Returns false if neither is valid in one of 
+   the two directions. */
+bool masked_normal(GCLMaskedGrid& g, int i, int j, double *n)
+{
+    int ia,ib,ja,jb;
+    if((i<g.n1-1) && g.point_is_valid(i+1,j))
+    {
+        ia=i;  ib=i+1;
+    }
+    else if((i>0) && g.point_is_valid(i-1,j))
+    {
+        ia=i-1;  ib=i;
+    }
+    else
+        return(false);
+    if((j<g.n2-1) && g.point_is_valid(i,j+1))
+    {
+        ja=j;  jb=j+1;
+    }
+    else if((j>0) && g.point_is_valid(i,j-1))
+    {
+        ja=j-1;  jb=j;
+    }
+    else
+        return(false);
+    double dx1[3],dx2[3];
+    dx1[0]=g.x1[ib][j]-g.x1[ia][j];
+    dx1[1]=g.x2[ib][j]-g.x2[ia][j];
+    dx1[2]=g.x3[ib][j]-g.x3[ia][j];
+    dx2[0]=g.x1[i][jb]-g.x1[i][ja];
+    dx2[1]=g.x2[i][jb]-g.x2[i][ja];
+    dx2[2]=g.x3[i][jb]-g.x3[i][ja];
+    dr3cros(dx1,dx2,n);
+    double nmag=dr3mag(n);
+    if(nmag<=0.0) return(false);
+    for(int k=0;k<3;++k) n[k]/=nmag;
+    return(true);
+}
+}  // end anonymous namespace
+/* Computes unit normals to the surface defined by a grid as the cross
+   product of differences along x1 and x2.  Forward differences are used
+   except on the last row and column and next to masked points where a
+   backward difference is used.  Masked points and valid points with 
+   no valid neighbor in one of the directions are set to 
+   GCLFieldNullValue.  
+
+   Each row (constant i) is computed with simple loops over j on 
+   contiguous arrays so the compiler can vectorize them, and rows are 
+   split between threads. */
 GCLMaskedVectorField ComputeNormals(GCLMaskedGrid& raw)
 {
     try {
+        int n1=raw.n1;
+        int n2=raw.n2;
+        if((n1<2) || (n2<2))
+            throw GCLgridError(string("ComputeNormals:  ")
+                    + "grid must have at least 2 points in each direction");
         GCLMaskedVectorField result(raw,3);
-        int i,j,k;
-        double dx1[3],dx2[3],x1crossx2[3];
-        for(i=0;i<(raw.n1-1);++i)
-            for(j=0;j<(raw.n2-1);++i)
+        int i;
+        bool threaded=((n1*n2)>GMPThreadThreshold);
+#pragma omp parallel if(threaded)
+        {
+            vector<double> d1x(n2),d1y(n2),d1z(n2);
+            vector<double> nx(n2),ny(n2),nz(n2);
+            int j,k;
+#pragma omp for schedule(static)
+            for(i=0;i<n1;++i)
             {
-                dx1[0]=raw.x1[i+1][j]-raw.x1[i][j];
-                dx1[1]=raw.x2[i+2][j]-raw.x2[i][j];
-                dx1[2]=raw.x3[i+3][j]-raw.x3[i][j];
-                dx2[0]=raw.x1[i][j+1]-raw.x1[i][j];
-                dx2[1]=raw.x2[i][j+1]-raw.x2[i][j];
-                dx2[2]=raw.x3[i][j+1]-raw.x3[i][j];
-                dr3cros(dx1,dx2,x1crossx2);
-                double nmag;
-                nmag=dr3mag(x1crossx2); // to make unit normals 
-                for(k=0;k<3;++k) result.val[i][j][k]=x1crossx2[k]/nmag;
+                /* x1 direction neighbor used for the whole row */
+                int ia,ib;
+                if(i<n1-1)
+                {
+                    ia=i;  ib=i+1;
+                }
+                else
+                {
+                    ia=i-1;  ib=i;
+                }
+                const double *xa=raw.x1[ia];
+                const double *ya=raw.x2[ia];
+                const double *za=raw.x3[ia];
+                const double *xb=raw.x1[ib];
+                const double *yb=raw.x2[ib];
+                const double *zb=raw.x3[ib];
+                const double *x=raw.x1[i];
+                const double *y=raw.x2[i];
+                const double *z=raw.x3[i];
+                for(j=0;j<n2;++j)
+                {
+                    d1x[j]=xb[j]-xa[j];
+                    d1y[j]=yb[j]-ya[j];
+                    d1z[j]=zb[j]-za[j];
+                }
+                for(j=0;j<n2;++j)
+                {
+                    /* forward difference in x2 except on the last column */
+                    int ja=(j<n2-1) ? j : j-1;
+                    double d2x=x[ja+1]-x[ja];
+                    double d2y=y[ja+1]-y[ja];
+                    double d2z=z[ja+1]-z[ja];
+                    double cx=d1y[j]*d2z-d1z[j]*d2y;
+                    double cy=d1z[j]*d2x-d1x[j]*d2z;
+                    double cz=d1x[j]*d2y-d1y[j]*d2x;
+                    double nmag=sqrt(cx*cx+cy*cy+cz*cz);
+                    nx[j]=cx/nmag;
+                    ny[j]=cy/nmag;
+                    nz[j]=cz/nmag;
+                }
+                for(j=0;j<n2;++j)
+                {
+                    double *v=result.val[i][j];
+                    int jb=(j<n2-1) ? j+1 : j-1;
+                    if(!raw.point_is_valid(i,j))
+                    {
+                        for(k=0;k<3;++k) v[k]=GCLFieldNullValue;
+                    }
+                    else if(raw.point_is_valid(ib==i ? ia : ib,j)
+                            && raw.point_is_valid(i,jb)
+                            && (nx[j]==nx[j]))
+                    {
+                        v[0]=nx[j];
+                        v[1]=ny[j];
+                        v[2]=nz[j];
+                    }
+                    else if(!masked_normal(raw,i,j,v))
+                    {
+                        for(k=0;k<3;++k) v[k]=GCLFieldNullValue;
+                    }
+                }
             }
+        }
         return(result);
     } catch(...){throw;};
 }
+/* Computes unit vectors in the local vertical (radial) direction at 
+   each grid point.   The vertical at a point is the direction from the
+   earth's center, which in the grid's cartesian frame is gtoc of any
+   point with zero radius, to the point.   This is exact and needs no 
+   coordinate conversions per point.  Values are computed for all 
+   points, including masked ones, since they depend only on position. */
 GCLMaskedVectorField ComputeLocalVerticals(GCLMaskedGrid& raw)
 {
     try {
         GCLMaskedVectorField result(raw,3);
-        int i,j,k;
-        const double Roffset(20.0);  // radius offset to compute normal 
-        Cartesian_point cp;
-        Geographic_point gp;
-        double rawvector[3];
-        for(i=0;i<(raw.n1-1);++i)
-            for(j=0;j<(raw.n2-1);++i)
+        int n1=raw.n1;
+        int n2=raw.n2;
+        Cartesian_point center=raw.gtoc(0.0,0.0,0.0);
+        int i;
+        bool threaded=((n1*n2)>GMPThreadThreshold);
+#pragma omp parallel if(threaded)
+        {
+            vector<double> ux(n2),uy(n2),uz(n2);
+            int j;
+#pragma omp for schedule(static)
+            for(i=0;i<n1;++i)
             {
-                gp=raw.ctog(raw.x1[i][j],raw.x2[i][j],raw.x3[i][j]);
-                gp.r+=Roffset;
-                cp=raw.gtoc(gp);
-                rawvector[0]=cp.x1-raw.x1[i][j];
-                rawvector[1]=cp.x2-raw.x2[i][j];
-                rawvector[2]=cp.x3-raw.x3[i][j];
-                double nrmraw;
-                nrmraw=dr3mag(rawvector);
-                for(k=0;k<3;++k) result.val[i][j][k]=rawvector[k]/nrmraw;
+                const double *x=raw.x1[i];
+                const double *y=raw.x2[i];
+                const double *z=raw.x3[i];
+                for(j=0;j<n2;++j)
+                {
+                    double vx=x[j]-center.x1;
+                    double vy=y[j]-center.x2;
+                    double vz=z[j]-center.x3;
+                    double rinv=1.0/sqrt(vx*vx+vy*vy+vz*vz);
+                    ux[j]=vx*rinv;
+                    uy[j]=vy*rinv;
+                    uz[j]=vz*rinv;
+                }
+                for(j=0;j<n2;++j)
+                {
+                    double *v=result.val[i][j];
+                    v[0]=ux[j];
+                    v[1]=uy[j];
+                    v[2]=uz[j];
+                }
             }
-        // fill outer border using last valid value
-        j=raw.n2-1;
-        for(i=0;i<raw.n1;++i)
-            for(k=0;k<3;++k) result.val[i][j][k]=result.val[i][j-1][k];
-        i=raw.n1-1;
-        for(j=0;j<raw.n2;++j)
-            for(k=0;k<3;++k) result.val[i][j][k]=result.val[i-1][j][k];
+        }
         return result;
     } catch(...){throw;};
 }
@@ -165,9 +366,10 @@ GCLMaskedScalarField compute_drdx1(GCLMaskedGrid& raw,double mindip)
     try{
         GCLMaskedScalarField result(raw);
         int i,j;
-        Cartesian_point cp1,cp2r1;
-        Geographic_point gp1,gp2,gp2r1;
-        double dx1;
+        int n1=result.n1;
+        int n2=result.n2;
+        bool threaded=((n1*n2)>GMPThreadThreshold);
+        RadialGridGeometry geom(raw,threaded);
         //dx1/dr is a tangent.  For efficiency we run mindip compare
         // against the tangent
         double mindiptan;
@@ -177,18 +379,21 @@ GCLMaskedScalarField compute_drdx1(GCLMaskedGrid& raw,double mindip)
             mindiptan=-99999999.9;
         else
             mindiptan=tan(mindip);
-        for(j=0;j<result.n2;++j)
-            for(i=0;i<(result.n1-1);++i)
+        /* Lines of constant j are independent */
+#pragma omp parallel for private(i) schedule(static) if(threaded)
+        for(j=0;j<n2;++j)
+        {
+            for(i=0;i<(n1-1);++i)
             {
-                /* ASsumes this procedure returns a negative
-                   value when one of the points is masked*/
-                dx1=dx1_offset(&result,i,j);
+                int k=geom.index(i,j);
+                double dx1(-1.0);
+                if(result.point_is_valid(i,j) 
+                        && result.point_is_valid(i+1,j))
+                    dx1=geom.dx1(k);
                 if(dx1>0.0)
                 {
-                    gp1=result.geo_coordinates(i,j);
-                    gp2=result.geo_coordinates(i+1,j);
                     /* notice this is normally negative */
-                    result.val[i][j]=(gp2.r-gp1.r)/dx1;
+                    result.val[i][j]=(geom.r[k+1]-geom.r[k])/dx1;
                     if(-result.val[i][j]<mindiptan)
                         result.val[i][j]=mindiptan;
                 }
@@ -198,11 +403,9 @@ GCLMaskedScalarField compute_drdx1(GCLMaskedGrid& raw,double mindip)
                     result.val[i][j]=GCLFieldNullValue;
                 }
             }
-        /* Fill i=n1-1 with copies of n1-2 */
-        i=result.n1-1;
-        for(j=0;j<result.n2;++j)
-        {
-            if(result.point_is_valid(i,j))
+            /* Fill i=n1-1 with copies of n1-2 */
+            i=n1-1;
+            if(result.point_is_valid(i,j) && (i>0))
                 result.val[i][j]=result.val[i-1][j];
             else
                 result.val[i][j]=GCLFieldNullValue;
@@ -211,35 +414,41 @@ GCLMaskedScalarField compute_drdx1(GCLMaskedGrid& raw,double mindip)
     } catch(...){throw;};
 }
 
+/* Integrates drdx1field along lines of constant j starting from i=0.
+   Each point keeps the direction (lat,lon) of parent and gets the 
+   radius of the previous point plus drdx1*dx1.  Points where i-1 or i 
+   are masked are not altered and restart the integration. */
 GCLMaskedScalarField x1_integrator(GCLMaskedGrid& parent,
                 GCLMaskedScalarField& drdx1field)
 {
     try {
-        double dx1,dr;
-        Geographic_point gp0,newgp;
-        Cartesian_point cp;
         GCLMaskedScalarField ifld(parent);
         int i,j;
-        for(j=0;j<ifld.n2;++j)
-            for(i=1;i<ifld.n1;++i)
+        int n1=ifld.n1;
+        int n2=ifld.n2;
+        bool threaded=((n1*n2)>GMPThreadThreshold);
+        RadialGridGeometry geom(parent,threaded);
+#pragma omp parallel for private(i) schedule(static) if(threaded)
+        for(j=0;j<n2;++j)
+        {
+            /* Radius of point i-1 after integration */
+            double rprev=geom.r[geom.index(0,j)];
+            for(i=1;i<n1;++i)
             {
-                /* if this first several points are masked this
-                   will skip until both points are valid */
-                if(ifld.point_is_valid(i-1,j))
+                int k=geom.index(i-1,j);
+                if(ifld.point_is_valid(i-1,j) && ifld.point_is_valid(i,j))
                 {
-                    dx1=dx1_offset(&parent,i-1,j);
-                    /* do nothing when i,j is masked */
-                    if(dx1<0.0) continue;
-                    gp0=ifld.geo_coordinates(i-1,j);
-                    newgp=ifld.geo_coordinates(i,j);
-                    dr=drdx1field.val[i-1][j]*dx1;
-                    newgp.r=gp0.r+dr;
-                    cp=ifld.gtoc(newgp);
-                    ifld.x1[i][j]=cp.x1;
-                    ifld.x2[i][j]=cp.x2;
-                    ifld.x3[i][j]=cp.x3;
+                    double x[3];
+                    rprev+=drdx1field.val[i-1][j]*geom.dx1(k);
+                    geom.point(k+1,rprev,x);
+                    ifld.x1[i][j]=x[0];
+                    ifld.x2[i][j]=x[1];
+                    ifld.x3[i][j]=x[2];
                 }
+                else
+                    rprev=geom.r[k+1];
             }
+        }
         return(ifld);
     } catch(...){throw;};
 }
@@ -254,11 +463,15 @@ Cartesian_point get_point(GCLgrid& g, int i, int j)
     cp.x3=g.x3[i][j];
     return(cp);
 }
+/* Applies a correction to the radius of each valid point of line j 
+   proportional to the arc length from the first valid point of the 
+   line.  The correction is scaled so the tie point tpv[j] ends up at 
+   the tie point radius.  If the tie point is not on line j the total 
+   arc length of the line is used for scaling. */
 GCLMaskedGrid LinearDepthCorrection(GCLMaskedGrid& raw, 
                 vector<TiePoint>& tpv)
 {
     try{
-        GCLMaskedGrid result;
         if(tpv.size()!=raw.n2) 
         {
             ostringstream sserr;
@@ -268,71 +481,79 @@ GCLMaskedGrid LinearDepthCorrection(GCLMaskedGrid& raw,
                 <<"They must match-cannot continue"<<endl;
             throw GCLgridError(sserr.str());
         }
-        Geographic_point gp,gptie;
-        Cartesian_point cp1,cp2;
-        /* This stores total arc lengths used as basis for linear 
-           drift like correction to points to match each tie point */
-        vector<double> arclengths;
-        arclengths.reserve(raw.n1);
-        int i,j;
-        for(j=0;j<raw.n2;++j)
+        GCLMaskedGrid result(raw);
+        int n1=raw.n1;
+        int n2=raw.n2;
+        bool threaded=((n1*n2)>GMPThreadThreshold);
+        RadialGridGeometry geom(raw,threaded);
+        /* Lines with a masked tie point are flagged here and reported 
+           after the parallel loop */
+        vector<char> masked_tie(n2,0);
+#pragma omp parallel if(threaded)
         {
-            arclengths.clear();
-            double arc,dr,drds;
-            for(i=0,arc=-1.0;i<raw.n1;++i)
+            /* This stores total arc lengths used as basis for linear 
+               drift like correction to points to match each tie point */
+            vector<double> arclengths(n1);
+            int i,j;
+#pragma omp for schedule(static)
+            for(j=0;j<n2;++j)
             {
-                if(raw.point_is_valid(i,j))
-                {
-                    if(arc<0.0)
-                    {
-                        arclengths.push_back(0.0);
-                        cp1=get_point(raw,i,j);
-                    }
-                    else
-                    {
-                        cp2=get_point(raw,i,j);
-                        arc += CartesianDistance(cp1,cp2);
-                        arclengths.push_back(arc);
-                        cp1=cp2;
-                    }
-                }
-                else
+                int itie=tpv[j].i_tie;
+                int jtie=tpv[j].j_tie;
+                if(!raw.point_is_valid(itie,jtie))
                 {
-                /*Push a negative number for any masked point */
-                    arclengths.push_back(-1.0);
+                    masked_tie[j]=1;
+                    continue;
                 }
-            }
-            if(raw.point_is_valid(tpv[j].i_tie,tpv[j].j_tie))
-            {
-                gptie=raw.geo_coordinates(tpv[j].i_tie,tpv[j].j_tie);
-                dr=gptie.r-tpv[j].radius;
-                drds=dr/arc;
-                for(i=0;i<raw.n1;++i)
+                double arc(-1.0);
+                int ilast(0);
+                for(i=0;i<n1;++i)
                 {
                     if(raw.point_is_valid(i,j))
                     {
-                        gp=raw.geo_coordinates(i,j);
-                        gp.r += arclengths[i]*drds;
-                        cp1=raw.gtoc(gp);
-                        result.x1[i][j]=cp1.x1;
-                        result.x2[i][j]=cp1.x2;
-                        result.x3[i][j]=cp1.x3;
+                        if(arc<0.0)
+                            arc=0.0;
+                        else
+                        {
+                            /* Distance from the last valid point */
+                            double d0=raw.x1[i][j]-raw.x1[ilast][j];
+                            double d1=raw.x2[i][j]-raw.x2[ilast][j];
+                            double d2=raw.x3[i][j]-raw.x3[ilast][j];
+                            arc+=sqrt(d0*d0+d1*d1+d2*d2);
+                        }
+                        arclengths[i]=arc;
+                        ilast=i;
                     }
+                    else
+                    /*Use a negative number for any masked point */
+                        arclengths[i]=-1.0;
+                }
+                double scale=arc;
+                if((jtie==j) && (arclengths[itie]>0.0)) scale=arclengths[itie];
+                if(scale<=0.0) continue;
+                double dr=geom.r[geom.index(itie,jtie)]-tpv[j].radius;
+                double drds=dr/scale;
+                for(i=0;i<n1;++i)
+                {
+                    if(arclengths[i]<0.0) continue;
+                    double x[3];
+                    int k=geom.index(i,j);
+                    geom.point(k,geom.r[k]-arclengths[i]*drds,x);
+                    result.x1[i][j]=x[0];
+                    result.x2[i][j]=x[1];
+                    result.x3[i][j]=x[2];
                 }
             }
-            else
-            {
+        }
+        for(int j=0;j<n2;++j)
+        {
+            if(masked_tie[j])
                 cerr << "LinearDepthCorrection procedure (WARNING):  "
                     <<"tie point at grid position ("<<tpv[j].i_tie<<","
                        <<tpv[j].j_tie<<") is in a masked region"<<endl
                        <<"x2=const curve on grid line with j="
                        <<j<< " may contain an offset"<<endl;
-            }
         }
         return(result);
     } catch(...){throw;};
 }
-
-
-
-
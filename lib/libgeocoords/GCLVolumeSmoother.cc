@@ -0,0 +1,222 @@
+#include <math.h>
+#include "GCLVolumeSmoother.h"
+namespace {
+/* Fields smaller than this are never split between threads */
+const int GVSThreadThreshold(32768);
+/* Number of contiguous values filtered together.  Keeps the input
+   lines used for one block of output in cache. */
+const int GVSBlockSize(1024);
+/* Gaussian kernels are truncated at this many standard deviations */
+const double GaussianTruncation(3.0);
+/* Correlate an array viewed as [nouter][naxis][ninner] with w along
+   the middle index.  out[o][a][m]=sum_l w[l]*in[o][a-off+l][m] with
+   terms outside the grid dropped.  When normalize is true each output
+   is divided by the sum of the weights used.  */
+void correlate_axis(const double *in, double *out, int nouter, int naxis,
+        int ninner, const vector<double>& w, int off, bool normalize,
+        bool threaded)
+{
+    int nw=w.size();
+    int a;
+    vector<double> scale(naxis,1.0);
+    if(normalize)
+    {
+        for(a=0;a<naxis;++a)
+        {
+            int ls=off-a;
+            if(ls<0) ls=0;
+            int le=naxis+off-a;
+            if(le>nw) le=nw;
+            double sumwt(0.0);
+            for(int l=ls;l<le;++l) sumwt+=w[l];
+            if(sumwt!=0.0) scale[a]=1.0/sumwt;
+        }
+    }
+    if(ninner==1)
+    {
+        /* The axis is contiguous (the x3 pass).  Blocks would hold a 
+           single value so threads are given whole lines instead and
+           each line is filtered serially. */
+        int o;
+#pragma omp parallel for schedule(static) if(threaded)
+        for(o=0;o<nouter;++o)
+        {
+            const double *src=in+static_cast<long>(o)*naxis;
+            double *dst=out+static_cast<long>(o)*naxis;
+            for(int ia=0;ia<naxis;++ia)
+            {
+                int ls=off-ia;
+                if(ls<0) ls=0;
+                int le=naxis+off-ia;
+                if(le>nw) le=nw;
+                double sum(0.0);
+                for(int l=ls;l<le;++l) sum+=w[l]*src[ia-off+l];
+                if(normalize) sum*=scale[ia];
+                dst[ia]=sum;
+            }
+        }
+        return;
+    }
+    int nblocks=(ninner+GVSBlockSize-1)/GVSBlockSize;
+    long nitems=static_cast<long>(nouter)*naxis*nblocks;
+    long item;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(item=0;item<nitems;++item)
+    {
+        int b=item%nblocks;
+        long line=item/nblocks;
+        int ia=line%naxis;
+        long o=line/naxis;
+        int m0=b*GVSBlockSize;
+        int nb=ninner-m0;
+        if(nb>GVSBlockSize) nb=GVSBlockSize;
+        double *dst=out+(o*naxis+ia)*ninner+m0;
+        int m;
+        for(m=0;m<nb;++m) dst[m]=0.0;
+        int ls=off-ia;
+        if(ls<0) ls=0;
+        int le=naxis+off-ia;
+        if(le>nw) le=nw;
+        for(int l=ls;l<le;++l)
+        {
+            const double *src=in+(o*naxis+ia-off+l)*ninner+m0;
+            double wl=w[l];
+            for(m=0;m<nb;++m) dst[m]+=wl*src[m];
+        }
+        if(normalize)
+            for(m=0;m<nb;++m) dst[m]*=scale[ia];
+    }
+}
+}  // end anonymous namespace
+GCLVolumeSmoother::GCLVolumeSmoother()
+{
+    for(int axis=0;axis<3;++axis) offset[axis]=0;
+    masked=false;
+    nullvalue=0.0;
+}
+GCLVolumeSmoother::GCLVolumeSmoother(VolumeSmootherKernel type,
+        double l1, double l2, double l3)
+{
+    this->set_kernel(0,type,l1);
+    this->set_kernel(1,type,l2);
+    this->set_kernel(2,type,l3);
+    masked=false;
+    nullvalue=0.0;
+}
+/* An empty kernel means the axis is skipped.  A single point kernel
+   does nothing either so it is also left empty.  */
+void GCLVolumeSmoother::set_kernel(int axis, VolumeSmootherKernel type,
+        double len)
+{
+    int half,l;
+    w[axis].clear();
+    offset[axis]=0;
+    if(len<=0.0) return;
+    if(type==GaussianKernel)
+    {
+        half=static_cast<int>(ceil(GaussianTruncation*len));
+        if(half<1) return;
+        for(l=-half;l<=half;++l)
+        {
+            double x=static_cast<double>(l)/len;
+            w[axis].push_back(exp(-0.5*x*x));
+        }
+    }
+    else
+    {
+        half=static_cast<int>(ceil(len))/2;
+        if(half<1) return;
+        w[axis].assign(2*half+1,1.0);
+    }
+    offset[axis]=half;
+}
+void GCLVolumeSmoother::set_null_value(double nv)
+{
+    nullvalue=nv;
+    masked=true;
+}
+void GCLVolumeSmoother::clear_null_value()
+{
+    masked=false;
+}
+/* Without a mask the separable filter with edge renormalization is the
+   product of three renormalized one dimensional filters.  With a mask
+   the masked field and the 0/1 mask indicator are filtered without
+   normalization and divided at the end.  */
+int GCLVolumeSmoother::apply(GCLscalarfield3d& f, bool threaded)
+{
+    int n1=f.n1;
+    int n2=f.n2;
+    int n3=f.n3;
+    if((n1<=0) || (n2<=0) || (n3<=0)) return(0);
+    size_t npts=static_cast<size_t>(n1)*n2*n3;
+    threaded=threaded && (npts>GVSThreadThreshold);
+    int i,j,k;
+    size_t kk;
+    int nlive(0);
+    vector<double> val(npts),work(npts);
+    vector<double> ind,indwork;
+    if(masked)
+    {
+        ind.resize(npts);
+        indwork.resize(npts);
+    }
+    for(i=0,kk=0;i<n1;++i)
+        for(j=0;j<n2;++j)
+            for(k=0;k<n3;++k,++kk)
+            {
+                if(masked)
+                {
+                    if(f.val[i][j][k]==nullvalue)
+                    {
+                        val[kk]=0.0;
+                        ind[kk]=0.0;
+                    }
+                    else
+                    {
+                        val[kk]=f.val[i][j][k];
+                        ind[kk]=1.0;
+                        ++nlive;
+                    }
+                }
+                else
+                {
+                    val[kk]=f.val[i][j][k];
+                    ++nlive;
+                }
+            }
+    /* Shape of the array for a pass along each axis */
+    int nouter[3],naxis[3],ninner[3];
+    nouter[0]=1;      naxis[0]=n1;  ninner[0]=n2*n3;
+    nouter[1]=n1;     naxis[1]=n2;  ninner[1]=n3;
+    nouter[2]=n1*n2;  naxis[2]=n3;  ninner[2]=1;
+    for(int axis=0;axis<3;++axis)
+    {
+        if(w[axis].empty()) continue;
+        correlate_axis(&(val[0]),&(work[0]),nouter[axis],naxis[axis],
+                ninner[axis],w[axis],offset[axis],!masked,threaded);
+        val.swap(work);
+        if(masked)
+        {
+            correlate_axis(&(ind[0]),&(indwork[0]),nouter[axis],
+                    naxis[axis],ninner[axis],w[axis],offset[axis],
+                    false,threaded);
+            ind.swap(indwork);
+        }
+    }
+    for(i=0,kk=0;i<n1;++i)
+        for(j=0;j<n2;++j)
+            for(k=0;k<n3;++k,++kk)
+            {
+                if(masked)
+                {
+                    /* A valid point always has a positive weight from
+                       itself so ind is not zero here */
+                    if(f.val[i][j][k]!=nullvalue)
+                        f.val[i][j][k]=val[kk]/ind[kk];
+                }
+                else
+                    f.val[i][j][k]=val[kk];
+            }
+    return(nlive);
+}
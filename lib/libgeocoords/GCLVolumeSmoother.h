@@ -0,0 +1,71 @@
+#ifndef _GCLVOLUMESMOOTHER_H_
+#define _GCLVOLUMESMOOTHER_H_
+#include <vector>
+#include "gclgrid.h"
+using namespace std;
+/*! Shapes of the one dimensional kernels used by GCLVolumeSmoother. */
+enum VolumeSmootherKernel {GaussianKernel, BoxcarKernel};
+/*! \brief Smoother for 3d scalar fields.
+
+  This is the 3d companion of GCLMVFSmoother.  The filter is the
+  product of three one dimensional kernels, one for each grid index
+  direction, so it is applied as three one dimensional passes.  Each
+  pass works on blocks of contiguous memory and is split between
+  threads.
+
+  Kernel lengths are in grid index units (samples) and can differ
+  for each axis.  A length of zero or less leaves that axis alone.
+  Near the edges of the grid the kernel is truncated and renormalized
+  so smoothing does not bias values toward zero.
+
+  Masking is optional.  When a null value is set points with that value
+  are excluded from the averages and are not altered.  Weights are
+  renormalized at each point by the sum of the weights that hit valid
+  points (normalized convolution) the same as GCLMVFSmoother.
+  */
+class GCLVolumeSmoother
+{
+    public:
+        /*! Default constructor.  Creates an operator that does nothing.*/
+        GCLVolumeSmoother();
+        /*! \brief Define the kernel.
+
+          \param type sets the kernel shape.
+          \param l1 is the kernel length for the x1 index direction.
+          \param l2 is the kernel length for the x2 index direction.
+          \param l3 is the kernel length for the x3 index direction.
+
+          For GaussianKernel lengths are the standard deviation in
+          samples and the kernel is truncated at 3 standard deviations.
+          For BoxcarKernel lengths are the full width in samples and
+          are rounded up to the next odd integer.
+          */
+        GCLVolumeSmoother(VolumeSmootherKernel type, double l1, double l2,
+                double l3);
+        /*! \brief Enable masking.
+
+          Points of a field with value nullvalue are treated as masked.
+          Comparison is exact so this should be the value used to flag
+          undefined points (e.g. GCLFieldNullValue).  */
+        void set_null_value(double nullvalue);
+        /*! Turn off masking set by set_null_value. */
+        void clear_null_value();
+        /*! \brief Smooth a field in place.
+
+          \param f is the field to smooth.   Its val array is replaced by
+            the smoothed values.
+          \param threaded when true (default) large fields are split
+            between threads.
+          \return number of points altered (all points unless masking
+            is enabled).
+          */
+        int apply(GCLscalarfield3d& f, bool threaded=true);
+    private:
+        /* Kernel coefficients and lag 0 offset for each axis */
+        vector<double> w[3];
+        int offset[3];
+        bool masked;
+        double nullvalue;
+        void set_kernel(int axis, VolumeSmootherKernel type, double len);
+};
+#endif
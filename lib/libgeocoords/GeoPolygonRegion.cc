@@ -1,5 +1,6 @@
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include "GeoPolygonRegion.h"
 #include <math.h>
 #define deg(r)    ((r) * 180.0/M_PI)
@@ -167,6 +168,7 @@ bool points_not_valid(vector<double> vlat, vector<double> vlon)
 GeoPolygonRegion::GeoPolygonRegion()
 {
     npoints=0;
+    this->build_index();
 }
 GeoPolygonRegion::GeoPolygonRegion(string fname)
 {
@@ -214,6 +216,7 @@ GeoPolygonRegion::GeoPolygonRegion(string fname)
         lat[i]=rad(lat[i]);
         lon[i]=rad(lon[i]);
     }
+    this->build_index();
 }
 GeoPolygonRegion::GeoPolygonRegion(vector<double> vlat, vector<double> vlon)
     : lat(vlat),lon(vlon)
@@ -227,6 +230,8 @@ GeoPolygonRegion::GeoPolygonRegion(vector<double> vlat, vector<double> vlon)
     if(points_not_valid(lat,lon))
         throw GCLgridError(base_error + "illegal lat or lon values in polygon\n"
             +   "Does not support longitude singularity or across poles");
+    npoints=lat.size();
+    this->build_index();
 }
 GeoPolygonRegion::GeoPolygonRegion(vector<Geographic_point> gpts)
 {
@@ -252,39 +257,188 @@ GeoPolygonRegion::GeoPolygonRegion(vector<Geographic_point> gpts)
     if(points_not_valid(dlat,dlon))
         throw GCLgridError(base_error + "illegal lat or lon values in polygon\n"
                 "Does not support longitude singularity or across poles");
+    npoints=lat.size();
+    this->build_index();
 }
 
 
-bool GeoPolygonRegion::is_inside(double lat0, double lon0)
+/* The slab index is sized so the average slab holds a few edges.  The
+   cap limits memory use for very large polygons. */
+const int MaxPolygonSlabs(65536);
+void GeoPolygonRegion::build_index()
+{
+    slabstart.clear();
+    slabedges.clear();
+    nslabs=0;
+    slabdlat=1.0;
+    latmin=0.0; latmax=0.0; lonmin=0.0; lonmax=0.0;
+    if(npoints<=0) return;
+    int i;
+    latmin=lat[0]; latmax=lat[0];
+    lonmin=lon[0]; lonmax=lon[0];
+    for(i=1;i<npoints;++i)
+    {
+        if(lat[i]<latmin) latmin=lat[i];
+        if(lat[i]>latmax) latmax=lat[i];
+        if(lon[i]<lonmin) lonmin=lon[i];
+        if(lon[i]>lonmax) lonmax=lon[i];
+    }
+    nslabs=npoints/2;
+    if(nslabs<1) nslabs=1;
+    if(nslabs>MaxPolygonSlabs) nslabs=MaxPolygonSlabs;
+    if(latmax>latmin) 
+        slabdlat=(latmax-latmin)/static_cast<double>(nslabs);
+    else
+        nslabs=1;
+    /* Two passes:  count edges in each slab then fill the lists */
+    slabstart.assign(nslabs+1,0);
+    int pass,k,s;
+    vector<int> fill;
+    for(pass=0;pass<2;++pass)
+    {
+        for(k=0;k<npoints;++k)
+        {
+            int k2=(k+1)%npoints;
+            int s0=slab(min(lat[k],lat[k2]));
+            int s1=slab(max(lat[k],lat[k2]));
+            for(s=s0;s<=s1;++s)
+            {
+                if(pass==0)
+                    ++slabstart[s+1];
+                else
+                    slabedges[fill[s]++]=k;
+            }
+        }
+        if(pass==0)
+        {
+            for(s=0;s<nslabs;++s) slabstart[s+1]+=slabstart[s];
+            slabedges.resize(slabstart[nslabs]);
+            fill.assign(slabstart.begin(),slabstart.end()-1);
+        }
+    }
+}
+int GeoPolygonRegion::slab(double lat0) const
+{
+    int s=static_cast<int>(floor((lat0-latmin)/slabdlat));
+    if(s<0) s=0;
+    if(s>=nslabs) s=nslabs-1;
+    return(s);
+}
+/* This is the same winding number calculation as winding_number, but
+   segments are only built for edges in the slab containing the test
+   point.  All other edges have both ends on the same side of the 
+   point's latitude and contribute 0 to the winding number.  */
+bool GeoPolygonRegion::is_inside(double lat0, double lon0) const
 {
     /* Always return true if the polygon is undefined.   Maybe should
        be the other way around, but allows an application to 
        do no boundary checking if the object is null */
     if(npoints <= 0) return true;
-    vector<double> shifted_polygon;
-    /* In Kent's function these are interleaved so we make it that way */
-    shifted_polygon.reserve(npoints*2);
+    if((lat0<latmin) || (lat0>latmax) || (lon0<lonmin) || (lon0>lonmax))
+        return false;
+    int s=slab(lat0);
+    double winding_num(0.0);
+    double segment[4];
     int i;
-    double slat,slon;
-    for(i=0;i<npoints;++i)
+    for(i=slabstart[s];i<slabstart[s+1];++i)
     {
+        int k=slabedges[i];
+        int k2=(k+1)%npoints;
         /* lon is x and y is lat which for winding means this order */
-        slon=lon[i]-lon0;
-        slat=lat[i]-lat0;
-        shifted_polygon.push_back(slon);
-        shifted_polygon.push_back(slat);
+        segment[0]=lon[k]-lon0;
+        segment[1]=lat[k]-lat0;
+        segment[2]=lon[k2]-lon0;
+        segment[3]=lat[k2]-lat0;
+        winding_num += signed_crossing_number(segment);
     }
-    int wn = winding_number(&(shifted_polygon[0]),2*npoints);
+    int wn=static_cast<int>(winding_num);
     if(wn!=0)
         return(true);
     else
         return(false);
 }
+namespace {
+/* Mark nodes of a row with longitude in the closed interval x0 to x1 */
+void fill_span(const vector<double>& lonaxis, unsigned char *row, 
+        double x0, double x1)
+{
+    int i0=lower_bound(lonaxis.begin(),lonaxis.end(),x0)-lonaxis.begin();
+    int i1=upper_bound(lonaxis.begin(),lonaxis.end(),x1)-lonaxis.begin();
+    for(int i=i0;i<i1;++i) row[i]=1;
+}
+}  // end anonymous namespace
+/* Rows are filled with the usual half open rule (an edge crosses a row
+   if one end is on or below it and the other is above) which gives the
+   same winding number as the half crossings used by winding_number.
+   is_inside also treats points on the boundary as inside so nodes on 
+   horizontal edges, at vertices, and at crossings are always marked. */
+void GeoPolygonRegion::rasterize(const vector<double>& lataxis,
+        const vector<double>& lonaxis, vector<unsigned char>& inside) const
+{
+    int nlat=lataxis.size();
+    int nlon=lonaxis.size();
+    if(npoints<=0)
+    {
+        inside.assign(nlat*nlon,1);
+        return;
+    }
+    inside.assign(nlat*nlon,0);
+    if(nlon<=0) return;
+    vector< pair<double,int> > crossings;
+    int ilat,i,k;
+    for(ilat=0;ilat<nlat;++ilat)
+    {
+        double y=lataxis[ilat];
+        if((y<latmin) || (y>latmax)) continue;
+        unsigned char *row=&(inside[ilat*nlon]);
+        int s=slab(y);
+        crossings.clear();
+        for(i=slabstart[s];i<slabstart[s+1];++i)
+        {
+            int k1=slabedges[i];
+            int k2=(k1+1)%npoints;
+            double x1(lon[k1]),y1(lat[k1]),x2(lon[k2]),y2(lat[k2]);
+            if(y1==y) fill_span(lonaxis,row,x1,x1);
+            if(y1==y2)
+            {
+                if(y1==y) fill_span(lonaxis,row,min(x1,x2),max(x1,x2));
+                continue;
+            }
+            if( ((y1<=y) && (y<y2)) || ((y2<=y) && (y<y1)) )
+            {
+                double x=x1+(y-y1)*(x2-x1)/(y2-y1);
+                int direction = (y2>y1) ? 1 : -1;
+                crossings.push_back(pair<double,int>(x,direction));
+            }
+        }
+        sort(crossings.begin(),crossings.end());
+        int wn(0);
+        int ncross=crossings.size();
+        for(k=0;k<ncross;++k)
+        {
+            wn+=crossings[k].second;
+            if((wn!=0) && (k<ncross-1))
+                fill_span(lonaxis,row,crossings[k].first,
+                        crossings[k+1].first);
+            else
+                fill_span(lonaxis,row,crossings[k].first,
+                        crossings[k].first);
+        }
+    }
+}
 GeoPolygonRegion::GeoPolygonRegion(const GeoPolygonRegion& p)
 {
     npoints=p.npoints;
     lat=p.lat;
     lon=p.lon;
+    latmin=p.latmin;
+    latmax=p.latmax;
+    lonmin=p.lonmin;
+    lonmax=p.lonmax;
+    nslabs=p.nslabs;
+    slabdlat=p.slabdlat;
+    slabstart=p.slabstart;
+    slabedges=p.slabedges;
 }
 GeoPolygonRegion& GeoPolygonRegion::operator=(const GeoPolygonRegion& p)
 {
@@ -293,6 +447,14 @@ GeoPolygonRegion& GeoPolygonRegion::operator=(const GeoPolygonRegion& p)
         npoints=p.npoints;
         lat=p.lat;
         lon=p.lon;
+        latmin=p.latmin;
+        latmax=p.latmax;
+        lonmin=p.lonmin;
+        lonmax=p.lonmax;
+        nslabs=p.nslabs;
+        slabdlat=p.slabdlat;
+        slabstart=p.slabstart;
+        slabedges=p.slabedges;
     }
     return(*this);
 }
@@ -29,6 +29,14 @@
    Although the input is required to be in degrees be aware that to be
    consistent with everything else in this library the points are
    stored internally in radians.   
+
+   The constructors build an index used by is_inside.  The polygon's
+   latitude range is divided into uniform slabs and each slab holds a 
+   list of the edges whose latitude range overlaps it.   Only edges 
+   that span the latitude of a test point can change the winding 
+   number so is_inside needs to examine only the edges in one slab.
+   Points outside the bounding box of the polygon are rejected 
+   without examining any edges.
    */
 class GeoPolygonRegion
 {
@@ -84,7 +92,28 @@ class GeoPolygonRegion
            \param lat0 - latitude (degrees) of point to test
            \param lon0 - longitude (degrees) of point to test
            */
-        bool is_inside(double lat0, double lon0);
+        bool is_inside(double lat0, double lon0) const;
+        /* \brief Scan convert the polygon onto a regular lat,lon mesh.
+
+           This computes the same answer as calling is_inside for every
+           node of a mesh, but it is done one row at a time.  The edges 
+           crossing each row are intersected with it and nodes between 
+           crossings with a nonzero winding number are marked inside.  
+           The cost is proportional to the number of nodes plus edge 
+           crossings.   Like is_inside a null polygon marks every node 
+           inside.  
+
+           \param lataxis is the latitude of each mesh row (radians) in 
+             increasing order.
+           \param lonaxis is the longitude of each mesh column (radians) 
+             in increasing order.
+           \param inside is resized to lataxis.size()*lonaxis.size().  
+             inside[ilat*lonaxis.size()+ilon] is set nonzero if node 
+             ilat,ilon is inside the polygon and zero otherwise.
+           */
+        void rasterize(const vector<double>& lataxis, 
+                const vector<double>& lonaxis, 
+                vector<unsigned char>& inside) const;
         /*! Standard assignment operator. */
         GeoPolygonRegion& operator=(const GeoPolygonRegion& parent);
         /*! Standard output stream operator.  List points in degrees.*/
@@ -93,5 +122,16 @@ class GeoPolygonRegion
         int npoints;  // Number of points in polygon
         /* Points stored interleaved x[0],y[0],x[1],y[1],...,y[npoints-1]*/
         vector<double> lon,lat;
+        /* Bounding box of the polygon */
+        double latmin,latmax,lonmin,lonmax;
+        /* Edge index.  Edge k joins point k to point k+1 with the last 
+           edge closing the polygon.  The edges overlapping slab s are
+           slabedges[slabstart[s]] to slabedges[slabstart[s+1]-1]. */
+        int nslabs;
+        double slabdlat;
+        vector<int> slabstart;
+        vector<int> slabedges;
+        void build_index();
+        int slab(double lat0) const;
 };
 #endif
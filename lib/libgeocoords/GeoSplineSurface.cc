@@ -1,10 +1,31 @@
 #include <math.h>
 #include <fstream>
+#include <iostream>
 #include "SeisppError.h"
 #include "GeoCoordError.h"
 #include "GeoSplineSurface.h"
 using namespace std;
 using namespace SEISPP;
+/* Key for the cache file.  Hashes the points and every parameter
+   that changes the spline fit. */
+uint64_t spline_cache_key(vector<Geographic_point>& pts, double *par,
+        int npar, int max_iterations)
+{
+    uint64_t h=FNV1aOffset;
+    vector<Geographic_point>::iterator ppts;
+    for(ppts=pts.begin();ppts!=pts.end();++ppts)
+    {
+        h=fnv1a_hash(&(ppts->lat),sizeof(double),h);
+        h=fnv1a_hash(&(ppts->lon),sizeof(double),h);
+        h=fnv1a_hash(&(ppts->r),sizeof(double),h);
+    }
+    h=fnv1a_hash(par,npar*sizeof(double),h);
+    h=fnv1a_hash(&max_iterations,sizeof(int),h);
+    /* Changes to the solver have to invalidate old cache files */
+    const int solver_version(2);
+    h=fnv1a_hash(&solver_version,sizeof(int),h);
+    return(h);
+}
 
 GeoSplineSurface::GeoSplineSurface(vector<Geographic_point>& pts,
   double minx,
@@ -21,15 +42,17 @@ GeoSplineSurface::GeoSplineSurface(vector<Geographic_point>& pts,
              double overrelaxation,
               double convergence,
                int max_iterations,
-                bool use_cg) : boundary()
+                bool use_cg,
+                 string cachedir) : boundary()
 {
     this->GSSinit(pts,minx,maxx,miny,maxy,dx,dy,lower,upper,
             tension_interior,tension_boundary,aspect_ratio,
-            overrelaxation,convergence,max_iterations);
+            overrelaxation,convergence,max_iterations,cachedir);
     if(use_cg) 
     {
-        trigrid=delaunay_On4(pointset);
-        use_convex_hull=true;
+        try {
+            this->build_convex_hull();
+        }catch(...){throw;};
     };
 }
 void GeoSplineSurface::GSSinit(vector<Geographic_point>& pts,
@@ -46,14 +69,22 @@ void GeoSplineSurface::GSSinit(vector<Geographic_point>& pts,
             double aspect_ratio,
              double overrelaxation,
               double convergence,
-               int max_iterations) 
+               int max_iterations,
+                string cachedir) 
 {
     latmin=rad(miny);
     latmax=rad(maxy);
     lonmin=rad(minx);
     lonmax=rad(maxx);
+    use_convex_hull=false;
+    trigrid.reset();
+    boost::shared_ptr<vector<double> > newlon(new vector<double>);
+    boost::shared_ptr<vector<double> > newlat(new vector<double>);
+    boost::shared_ptr<vector<double> > newdepth(new vector<double>);
+    newlon->reserve(pts.size());
+    newlat->reserve(pts.size());
+    newdepth->reserve(pts.size());
     vector<Geographic_point>::iterator ppts;
-    CGPointset *pointset=cgpointset_new();
     for(ppts=pts.begin();ppts!=pts.end();++ppts)
     {
         /* Note we store the depth so we have to convert r.  
@@ -61,17 +92,56 @@ void GeoSplineSurface::GSSinit(vector<Geographic_point>& pts,
            That currently does not have any flexibility for
            the reference ellipsoid. */
         double dep=r0_ellipse(ppts->lat) - ppts->r;
-        CGPoint *cgpt=cgpoint_new(ppts->lon,ppts->lat,dep);
-        cgpointset_addpoint(pointset,cgpt);
-        cgpoint_free(&cgpt);
+        newlon->push_back(ppts->lon);
+        newlat->push_back(ppts->lat);
+        newdepth->push_back(dep);
+    }
+    ptlon=newlon;
+    ptlat=newlat;
+    ptdepth=newdepth;
+    uint64_t key(0);
+    string cachefile;
+    if(cachedir.length()>0)
+    {
+        double par[13]={minx,maxx,miny,maxy,dx,dy,lower,upper,
+            tension_interior,tension_boundary,aspect_ratio,
+            overrelaxation,convergence};
+        key=spline_cache_key(pts,par,13,max_iterations);
+        cachefile=cache_file_name(cachedir,"spline",key);
+        /* A missing or stale cache file just means we do the fit */
+        try {
+            BinaryCacheReader in(cachefile,SPLINE_SURFACE_CACHE,key);
+            grid=boost::shared_ptr<const RegularGrid2d>(new RegularGrid2d(in));
+            stats=TensionSplineStatistics();
+            return;
+        }catch(GeoCoordError& err){};
+    }
+    int nx=static_cast<int>(rint((maxx-minx)/dx))+1;
+    int ny=static_cast<int>(rint((maxy-miny)/dy))+1;
+    RegularGrid2d *g=new RegularGrid2d(lonmin,latmin,rad(dx),rad(dy),nx,ny);
+    try {
+        TensionSpline ts(tension_interior,tension_boundary,aspect_ratio,
+                overrelaxation,convergence,max_iterations,lower,upper);
+        stats=ts.fit(*ptlon,*ptlat,*ptdepth,*g);
+    }catch(...)
+    {
+        delete g;
+        throw;
+    }
+    grid=boost::shared_ptr<const RegularGrid2d>(g);
+    if(cachefile.length()>0)
+    {
+        try {
+            BinaryCacheWriter out(cachefile,SPLINE_SURFACE_CACHE,key);
+            grid->write(out);
+            out.close();
+        }catch(GeoCoordError& err)
+        {
+            cerr << "GeoSplineSurface:  could not save spline grid "
+                << "to cache file "<<cachefile<<endl
+                << err.what()<<endl;
+        }
     }
-    CGGrid *reggrd=cggrid_new(rad(minx),rad(maxx),rad(miny),rad(maxy),
-            rad(dx),rad(dy));
-    /* This may not be necessary, but worth setting explitly. */
-    strcpy(reggrd->units,"RADIANS");
-    gridptr=cggrid_splinefit_pointset(reggrd,
-            pointset,tension_interior,tension_boundary,aspect_ratio,
-             overrelaxation,convergence,max_iterations,lower,upper);
 }
 GeoSplineSurface::GeoSplineSurface(vector<Geographic_point>& pts,
             Metadata& inpar) : boundary()
@@ -91,17 +161,17 @@ GeoSplineSurface::GeoSplineSurface(vector<Geographic_point>& pts,
         double overrelaxation=inpar.get_double("overrelaxation");
         double convergence=inpar.get_double("convergence");
         int max_iterations=inpar.get_int("max_iterations");
+        /* Caching is optional and off if the key is not defined */
+        string cachedir("");
+        if(inpar.is_attribute("surface_cache_directory"))
+            cachedir=inpar.get_string("surface_cache_directory");
         this->GSSinit(pts,minx,maxx,miny,maxy,dx,dy,lower,upper,
             tension_interior,tension_boundary,aspect_ratio,
-            overrelaxation,convergence,max_iterations);
+            overrelaxation,convergence,max_iterations,cachedir);
         if(inpar.get_bool("use_convex_hull"))
         {
-            cout << "Trying to build delaunay triangularization" << endl
-                << "Kill me if this takes a long time - bug in delaunay_0n4"
-                <<endl;
-            trigrid=delaunay_On4(pointset);
-            cout << "Success:  output will be limited by convex hull"<<endl;
-            use_convex_hull=true;
+            this->build_convex_hull();
+            cout << "Output will be limited by convex hull"<<endl;
         }
     } catch (SeisppError& serr) 
     {
@@ -110,20 +180,41 @@ GeoSplineSurface::GeoSplineSurface(vector<Geographic_point>& pts,
         throw GeoCoordError(serr.what());
     }
 }
+/* Copies share the spline grid, the triangulation, and the control 
+   points.  None are altered after construction so this is safe. */
 GeoSplineSurface::GeoSplineSurface(const GeoSplineSurface& parent)
+    : trigrid(parent.trigrid),ptlon(parent.ptlon),ptlat(parent.ptlat),
+      ptdepth(parent.ptdepth),grid(parent.grid),stats(parent.stats),
+      boundary(parent.boundary)
 {
-    throw GeoCoordError(string("GeoSplineSurface copy constructor not implemented yet"));
+    use_convex_hull=parent.use_convex_hull;
+    latmin=parent.latmin;
+    latmax=parent.latmax;
+    lonmin=parent.lonmin;
+    lonmax=parent.lonmax;
 }
 GeoSplineSurface& GeoSplineSurface::operator=(const GeoSplineSurface& parent)
 {
-    throw GeoCoordError(string("GeoSplineSurface operator = not implemented yet"));
+    if(this!=&parent)
+    {
+        use_convex_hull=parent.use_convex_hull;
+        trigrid=parent.trigrid;
+        ptlon=parent.ptlon;
+        ptlat=parent.ptlat;
+        ptdepth=parent.ptdepth;
+        grid=parent.grid;
+        stats=parent.stats;
+        latmin=parent.latmin;
+        latmax=parent.latmax;
+        lonmin=parent.lonmin;
+        lonmax=parent.lonmax;
+        boundary=parent.boundary;
+    }
+    return(*this);
 }
 
 GeoSplineSurface::~GeoSplineSurface()
 {
-    cggrid_free(&gridptr);
-    cgpointset_free(&pointset);
-    cgpartition_free(&trigrid);
 }
 string depth_error_message(double lat,double lon,string line2)
 {
@@ -149,11 +240,11 @@ double GeoSplineSurface::depth(double lat, double lon)
         throw GeoCoordError(depth_error_message(lat,lon,
             string("Point is outside domain of grid defining this surface.")));
     double result;
-    result=cggrid_probe(gridptr,lon,lat);
+    result=grid->probe(lon,lat);
     //if(is_nan(result)) 
     if(fpclassify(result)==FP_NAN) 
         throw GeoCoordError(depth_error_message(lat,lon,
-            string("lookup method (cggrid_probe) failed for this point.")));
+            string("grid lookup failed for this point.")));
     return(result);
 }
 double GeoSplineSurface::radius(double lat, double lon)
@@ -175,8 +266,7 @@ bool GeoSplineSurface::is_defined(double lat,double lon)
 {
     if(use_convex_hull)
     {
-        CGPolygon *poly=polygon_containing_xy(trigrid,lon,lat);
-        if(poly==NULL)
+        if(!trigrid->contains(lon,lat))
             return false;
     }
     if(boundary.is_inside(lat,lon))
@@ -184,10 +274,76 @@ bool GeoSplineSurface::is_defined(double lat,double lon)
     else
         return false;
 }
+/* Batch evaluation block size and the array size below which work
+   is not split between threads.  The hint for the convex hull test
+   is carried from point to point within a block.  */
+const int GSSBlockSize(512);
+const int GSSThreadThreshold(8192);
+int GeoSplineSurface::batch_evaluate(const double *lat, const double *lon,
+        double *result, bool *defined, int n, bool threaded, 
+        bool return_depth)
+{
+    if(n<=0) return 0;
+    const DelaunayTriangulation *tg=NULL;
+    if(use_convex_hull) tg=trigrid.get();
+    const RegularGrid2d *g=grid.get();
+    int nblocks=(n+GSSBlockSize-1)/GSSBlockSize;
+    int ndefined(0);
+    int ib;
+#pragma omp parallel for schedule(dynamic) reduction(+:ndefined) if(threaded && (n>GSSThreadThreshold))
+    for(ib=0;ib<nblocks;++ib)
+    {
+        int i0=ib*GSSBlockSize;
+        int i1=i0+GSSBlockSize;
+        if(i1>n) i1=n;
+        int hint(-1);
+        for(int i=i0;i<i1;++i)
+        {
+            defined[i]=false;
+            if(lat[i]<latmin || lat[i]>latmax 
+                    || lon[i]<lonmin || lon[i]>lonmax) continue;
+            if(tg!=NULL)
+            {
+                int tri=tg->locate(lon[i],lat[i],hint);
+                if(tri<0) continue;
+                hint=tri;
+            }
+            if(!boundary.is_inside(lat[i],lon[i])) continue;
+            double dval=g->probe(lon[i],lat[i]);
+            if(fpclassify(dval)==FP_NAN) continue;
+            if(return_depth)
+                result[i]=dval;
+            else
+                result[i]=r0_ellipse(lat[i])-dval;
+            defined[i]=true;
+            ++ndefined;
+        }
+    }
+    return(ndefined);
+}
+int GeoSplineSurface::batch_depth(const double *lat, const double *lon,
+        double *d, bool *defined, int n, bool threaded)
+{
+    return(this->batch_evaluate(lat,lon,d,defined,n,threaded,true));
+}
+int GeoSplineSurface::batch_radius(const double *lat, const double *lon,
+        double *r, bool *defined, int n, bool threaded)
+{
+    return(this->batch_evaluate(lat,lon,r,defined,n,threaded,false));
+}
 void GeoSplineSurface::enable_convex_hull()
 {
     // Do nothing if trigrid is already created
-    if(trigrid!=NULL) return;
-    trigrid=delaunay_On4(pointset);
+    if(trigrid) return;
+    try {
+        this->build_convex_hull();
+    }catch(...){throw;};
+}
+void GeoSplineSurface::build_convex_hull()
+{
+    /* The triangulation is only used to test for points inside the
+       convex hull, but saving depth makes it usable for interpolation */
+    trigrid=boost::shared_ptr<const DelaunayTriangulation>
+        (new DelaunayTriangulation(*ptlon,*ptlat,*ptdepth));
     use_convex_hull=true;
 }
@@ -1,9 +1,12 @@
 #ifndef _GEOSPLINESURFACE_H_
 #define _GEOSPLINESURFACE_H_
 
+#include <boost/smart_ptr.hpp>
 #include "gclgrid.h"
 #include "Metadata.h"
-#include "cgeom.h"
+#include "DelaunayTriangulation.h"
+#include "RegularGrid2d.h"
+#include "TensionSpline.h"
 #include "GeoSurface.h"
 #include "GeoPolygonRegion.h"
 using namespace std;
@@ -22,11 +25,13 @@ using namespace SEISPP;
   tension parameters can be used to prevent wild oscillations between
   irregularly sampled data.  
 
-  Be aware this implementation is actually based on Kent Lindquist's cgeom 
-  library in Antelope.  It would be quite feasible to change the implementation
-  to the GMT code, but I chose to use cgeom because I would have had to shred
-  and reassemble the C code in gmt while Lindquist's had already built a clean
-  C api.  This object is little more than a front end to his implementation.
+  This implementation was originally a front end to Kent Lindquist's cgeom 
+  library in Antelope.  The fit is now done by the TensionSpline object in
+  this library that solves the same equations with a multithreaded 
+  coarse to fine algorithm.  The result is stored in a RegularGrid2d 
+  object and interpolated bilinearly.   The grid can optionally be cached 
+  on disk (see the cachedir argument to the constructors) so repeated runs 
+  with the same input skip the fit.
 
   A detail of the implementation the user must recognize is that the way points
   are handled that are defined as outside the region of interest.  There are 
@@ -39,7 +44,13 @@ using namespace SEISPP;
   is_defined method using a totally different algorithm.  That is, the input
   points are passed through a Delaunay triangulation routine.  The is_defined
   method can then be viewed as testing to see if the given point is within
-  the convex hull defined by the triangulation.
+  the convex hull defined by the triangulation.  The triangulation uses
+  the DelaunayTriangulation object in this library, not the cgeom 
+  delaunay_On4 function, so it is fast even for very large point sets.
+
+  The grid, triangulation, and control points are reference counted and 
+  shared by copies of the object.  The query methods do not alter the object so one
+  surface can be queried from multiple threads.
 
   Finally, note some mixed units documented in the detailed description of
   parameters in this object.  That is, some lat,lon parameters are assumed in
@@ -89,12 +100,18 @@ public:
     \param convergence specifies the fraction of the range of the input 
       data that defines convergence (default 0.001)
     \param max_iterations is the maximum number of iterations allowed
-      before giving up. (default 250)
+      on each grid of the coarse to fine sequence before giving up. 
+      (default 250)
     \param use_ch sets if the object should apply the convex hull
       of the collection of points.   When true points outside
       the convex hull will be effectively undefined.  (default is false
-      because implementation in antelope has known problem with an 
-      infinite loop when any 3 points are colinear in the set. )
+      for compatibility with older versions that used an antelope 
+      function that could loop forever when any 3 points were colinear.)
+    \param cachedir is a directory used to cache the spline grid.  If 
+      a cache file built from identical points and parameters exists 
+      in this directory the grid is loaded from it.  Otherwise the fit
+      is computed and saved there.   Default is an empty string which 
+      disables caching.
     */
     GeoSplineSurface(vector<Geographic_point>& pts,
             double minx,
@@ -111,7 +128,8 @@ public:
                double overrelaxation=1.4,
                 double convergence=0.001,
                  int max_iterations=250,
-                  bool use_ch=false);
+                  bool use_ch=false,
+                   string cachedir="");
     /* \brief Construct with control parameters coming from a Metadata object.
 
        In my library I use the Metadata object heavily to encapsulate a set of 
@@ -126,7 +144,9 @@ public:
        grid_latitude_minimum,grid_latitude_maximum, lower_bound_depth,upper_bound_depth,
        tension_interior, tension_boundary, aspect_ratio, overrelaxation, convergence,
        max_iterations.  The max_iterations parameter is integer and the other are
-       all real numbers. 
+       all real numbers.  An optional string parameter with the key
+       surface_cache_directory enables caching of the spline grid 
+       (see the cachedir argument of the fully parameterized constructor).
 
     \param pts - is the irregular grid of points used to defined the surface.
       The radius component of each point is converted internally to depth 
@@ -138,13 +158,20 @@ public:
       missing Metadata components.  
        */
     GeoSplineSurface(vector<Geographic_point>& pts, Metadata& inpar);
-    /*! Standard Copy Constructor */
+    /*! Standard Copy Constructor.
+
+      The spline grid, convex hull triangulation, and control points 
+      are not altered after construction so copies share them.  
+      Copies are cheap.*/
     GeoSplineSurface(const GeoSplineSurface& parent);
     /*! Standard destructor.
 
-      Nontrivial destructor has to free grid data.
+      Grid data are freed when the last copy sharing them is destroyed.
       */
     ~GeoSplineSurface();
+    /*! Return a copy made with the copy constructor.  Cheap because
+      grid data are shared. */
+    GeoSurface *clone() const {return new GeoSplineSurface(*this);};
     /*! Add a polygonal boundary region.
 
       Sometimes we need to build a bounding curve that has an 
@@ -191,18 +218,45 @@ public:
       \param lon is the longitude (in radians) of the point of interest.
       */
     bool is_defined(double lat,double lon);
-    /*! Standard assignment operator */
+    /*! \brief Evaluate depth at an array of points.
+
+      Native implementation of the GeoSurface batch interface.  A point
+      is marked defined if it passes the same tests as is_defined and 
+      is inside the grid.   Points that would cause the depth method to 
+      throw an exception are marked undefined instead so this method 
+      never throws.   When threaded is true large arrays are split 
+      between threads.  See GeoSurface::batch_depth for arguments.*/
+    int batch_depth(const double *lat, const double *lon,
+            double *d, bool *defined, int n, bool threaded=false);
+    /*! \brief Evaluate radius at an array of points.
+
+      Same as batch_depth but returns radius values. */
+    int batch_radius(const double *lat, const double *lon,
+            double *r, bool *defined, int n, bool threaded=false);
+    /*! Standard assignment operator.  Shares grid data with parent. */
     GeoSplineSurface& operator=(const GeoSplineSurface& parent);
     /*! call to enable convex hall editing if not turned on originally.*/
     void enable_convex_hull();
+    /*! \brief Return convergence and timing data for the spline fit.
+
+      If the grid was loaded from a cache file the statistics are empty.*/
+    TensionSplineStatistics fit_statistics() const {return(stats);};
 private:
     bool use_convex_hull;
-    CGPartition *trigrid;
-    CGPointset *pointset;
-    CGGrid *gridptr;
-    /* extents of regular grid stored in gridptr 
+    boost::shared_ptr<const DelaunayTriangulation> trigrid;
+    /* Control point coordinates (radians) and depths.  Saved to allow
+       the convex hull to be built after construction.  Shared by copies
+       like grid and trigrid so a copy does not depend on their size. */
+    boost::shared_ptr<const vector<double> > ptlon,ptlat,ptdepth;
+    boost::shared_ptr<const RegularGrid2d> grid;
+    TensionSplineStatistics stats;
+    /* extents of regular grid stored in grid 
      stored in radians*/
     double latmin,latmax,lonmin,lonmax;
+    /* Common code for batch_depth and batch_radius */
+    int batch_evaluate(const double *lat, const double *lon,
+            double *result, bool *defined, int n, bool threaded,
+            bool return_depth);
     /* This private method contains common code for constructors.  
        Done for maintainability although it confuses things.  Note
        the fully parameterized constructor does nothing but call
@@ -212,7 +266,9 @@ private:
             double dx, double dy, double lower, double upper,
             double tension_interior, double tension_boundary, 
             double aspect_ratio, double overrelexation, 
-            double convergence, int max_iterations);
+            double convergence, int max_iterations, string cachedir);
+    /* Builds trigrid from the saved control points */
+    void build_convex_hull();
     GeoPolygonRegion boundary;
 };
 #endif
@@ -17,6 +17,15 @@ at that position.
 class GeoSurface
 {
 public:
+    virtual ~GeoSurface(){};
+    /*! \brief Return a copy of this surface allocated with new.
+
+      Query methods of some children keep search state and so are not
+      safe to call from multiple threads on one object.  Algorithms 
+      that work through a GeoSurface pointer use this to give each 
+      thread its own copy.  Children are expected to make this cheap.
+      The caller owns the result.  */
+    virtual GeoSurface *clone() const=0;
     /*! Return the radius of the surface at point lat,lon.*/
     virtual double radius(double lat, double lon)=0;
     /*! Return the depth of the surface at point lat,lon.*/
@@ -24,6 +33,72 @@ public:
     /*! Test to see if the surface is defined at this point.  Returns 
       true of the surface is defined at the given point. */
     virtual bool is_defined(double lat,double lon)=0;
+    /*! \brief Combined is_defined and radius query.
+
+      Applications commonly call is_defined followed by radius for
+      the same point.  This method does both at once.  The default 
+      implementation just calls the two methods, but children that 
+      have to search for a point (e.g. a triangulation) should override
+      this method so the search is only done once.
+      \param lat is the latitude of the point of interest.
+      \param lon is the longitude of the point of interest.
+      \param r is set to the radius of the surface at lat,lon when 
+        the surface is defined there.  It is not altered otherwise.
+      \return true if the surface is defined at lat,lon.
+      */
+    virtual bool radius_if_defined(double lat, double lon, double& r)
+    {
+        if(!this->is_defined(lat,lon)) return false;
+        r=this->radius(lat,lon);
+        return true;
+    };
+    /*! \brief Evaluate depth at an array of points.
+
+      Evaluating a surface on a large grid one point at a time costs 
+      two or three virtual calls per point.   This method evaluates
+      a whole set of points in one call.   The default implementation 
+      just loops over is_defined and depth.   Children override it with
+      a native implementation that can split the work between threads.
+      \param lat is an array of n latitudes.
+      \param lon is an array of n longitudes.
+      \param d is the output array (length n) of depths.  d[i] is set 
+        only when defined[i] is true and is not altered otherwise.
+      \param defined is the output array (length n) set true where the
+        surface is defined.
+      \param n is the number of points.
+      \param threaded when true an implementation may split large
+        arrays between threads.  Ignored by the default implementation.
+      \return number of points where the surface is defined.
+      */
+    virtual int batch_depth(const double *lat, const double *lon,
+            double *d, bool *defined, int n, bool /*threaded*/=false)
+    {
+        int ndefined(0);
+        for(int i=0;i<n;++i)
+        {
+            defined[i]=this->is_defined(lat[i],lon[i]);
+            if(defined[i])
+            {
+                d[i]=this->depth(lat[i],lon[i]);
+                ++ndefined;
+            }
+        }
+        return ndefined;
+    };
+    /*! \brief Evaluate radius at an array of points.
+
+      Same as batch_depth but returns radius values in r.*/
+    virtual int batch_radius(const double *lat, const double *lon,
+            double *r, bool *defined, int n, bool /*threaded*/=false)
+    {
+        int ndefined(0);
+        for(int i=0;i<n;++i)
+        {
+            defined[i]=this->radius_if_defined(lat[i],lon[i],r[i]);
+            if(defined[i]) ++ndefined;
+        }
+        return ndefined;
+    };
     virtual void AddBoundary(const GeoPolygonRegion& poly)=0;
 };
 #endif
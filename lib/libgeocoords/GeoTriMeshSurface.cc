@@ -1,10 +1,34 @@
+#include <iostream>
+#include <algorithm>
 #include "coords.h"
 #include "gclgrid.h"
 #include "GeoCoordError.h"
 #include "GeoTriMeshSurface.h"
 using namespace std;
 
-void GeoTriMeshSurface::initialize_private(vector<Geographic_point> pts,string coordunits)
+/* Version of the triangulation algorithm and of the data layout saved
+   by DelaunayTriangulation::write.  It is part of the cache key so 
+   changing either must change this value to make old cache files 
+   stale. */
+const int32_t TriMeshCacheVersion(1);
+/* Key for the cache file.  Hashes the version, the points, and the 
+   units flag */
+uint64_t trimesh_cache_key(vector<Geographic_point>& pts, GeographicUnits units)
+{
+    uint64_t h=fnv1a_hash(&TriMeshCacheVersion,sizeof(int32_t));
+    vector<Geographic_point>::iterator ppts;
+    for(ppts=pts.begin();ppts!=pts.end();++ppts)
+    {
+        h=fnv1a_hash(&(ppts->lat),sizeof(double),h);
+        h=fnv1a_hash(&(ppts->lon),sizeof(double),h);
+        h=fnv1a_hash(&(ppts->r),sizeof(double),h);
+    }
+    int iunits=static_cast<int>(units);
+    h=fnv1a_hash(&iunits,sizeof(int),h);
+    return(h);
+}
+void GeoTriMeshSurface::initialize_private(vector<Geographic_point> pts,
+        string coordunits,string cachedir)
 {
     if(pts.size()<3) 
         throw GeoCoordError(string("GeoTriMeshSurface:")
@@ -13,27 +37,62 @@ void GeoTriMeshSurface::initialize_private(vector<Geographic_point> pts,string c
         units=RADIANS;
     else
         units=DEGREES;
+    lasttri=-1;
+    uint64_t key(0);
+    string cachefile;
+    if(cachedir.length()>0)
+    {
+        key=trimesh_cache_key(pts,units);
+        cachefile=cache_file_name(cachedir,"trimesh",key);
+        /* A missing or stale cache file is not an error.  We just
+           fall through and build the triangulation */
+        try {
+            BinaryCacheReader in(cachefile,TRIMESH_SURFACE_CACHE,key);
+            trigrid=boost::shared_ptr<const DelaunayTriangulation>
+                (new DelaunayTriangulation(in));
+            return;
+        }catch(GeoCoordError& err){};
+    }
     vector<Geographic_point>::iterator ppts;
-    CGPointset *pointset=cgpointset_new();
+    vector<double> x,y,z;
+    x.reserve(pts.size());
+    y.reserve(pts.size());
+    z.reserve(pts.size());
     for(ppts=pts.begin();ppts!=pts.end();++ppts)
     {
-        CGPoint *cgpt=cgpoint_new(ppts->lon,ppts->lat,ppts->r);
-        cgpointset_addpoint(pointset,cgpt);
-        cgpoint_free(&cgpt);
+        x.push_back(ppts->lon);
+        y.push_back(ppts->lat);
+        z.push_back(ppts->r);
+    }
+    try {
+        trigrid=boost::shared_ptr<const DelaunayTriangulation>
+            (new DelaunayTriangulation(x,y,z));
+    }catch(...){throw;};
+    if(cachefile.length()>0)
+    {
+        /* Failure to write the cache is only a warning */
+        try {
+            BinaryCacheWriter out(cachefile,TRIMESH_SURFACE_CACHE,key);
+            trigrid->write(out);
+            out.close();
+        }catch(GeoCoordError& err)
+        {
+            cerr << "GeoTriMeshSurface:  could not save triangulation "
+                << "to cache file "<<cachefile<<endl
+                << err.what()<<endl;
+        }
     }
-    trigrid=delaunay_On4(pointset);
-    cgpointset_free(&pointset);
 }
 GeoTriMeshSurface::GeoTriMeshSurface(vector<Geographic_point> pts,
-        string coordunits) : boundary()
+        string coordunits,string cachedir) : boundary()
 {
     try {
-        initialize_private(pts,coordunits);
+        initialize_private(pts,coordunits,cachedir);
     }catch(...){throw;};
 }
 
 GeoTriMeshSurface::GeoTriMeshSurface(vector<double>lat, vector<double>lon, 
-        vector<double> depth,string coordunits) : boundary()
+        vector<double> depth,string coordunits,string cachedir) : boundary()
 {
     int npts=lat.size();
     if( (lon.size()!=npts) || (depth.size()!=npts)) throw GeoCoordError(
@@ -59,43 +118,32 @@ GeoTriMeshSurface::GeoTriMeshSurface(vector<double>lat, vector<double>lon,
     }
     try {
         if(units==RADIANS)
-            initialize_private(pts,string("radians"));
+            initialize_private(pts,string("radians"),cachedir);
         else
-            initialize_private(pts,string("degrees"));
+            initialize_private(pts,string("degrees"),cachedir);
     } catch(...){throw;};
 }
+/* Copies share the triangulation.  That is safe because it is 
+   immutable once built.  Each copy has its own search hint. */
 GeoTriMeshSurface::GeoTriMeshSurface(const GeoTriMeshSurface& parent)
+    : trigrid(parent.trigrid),boundary(parent.boundary)
 {
-    throw GeoCoordError(string("GeoTriMeshSurface::copy constructor is not implemented yet"));
-    /* This section is impossible to complete until I get info 
-       from Kent */
-    /*
-    void temp;
-    trigrid=cgpartition_new(temp);
-    trigrid->polygons
-    */
-    // This section will not work correctly since trigrid is a pointer.
-    /*
-    trigrid=parent.trigrid;
-    */
     units=parent.units;
-    boundary=parent.boundary;
+    lasttri=parent.lasttri;
 }
 GeoTriMeshSurface::~GeoTriMeshSurface()
 {
-    cgpartition_free(&trigrid);
 }
 GeoTriMeshSurface& GeoTriMeshSurface::operator=(const GeoTriMeshSurface& parent)
 {
-    throw GeoCoordError(string("GeoTriMeshSurface::opertor= is not implemented yet"));
-    /*
     if(this!=&parent)
     {
         trigrid=parent.trigrid;
         units=parent.units;
+        boundary=parent.boundary;
+        lasttri=parent.lasttri;
     }
     return(*this);
-    */
 }
 void GeoTriMeshSurface::AddBoundary(const GeoPolygonRegion& poly)
 {
@@ -103,10 +151,10 @@ void GeoTriMeshSurface::AddBoundary(const GeoPolygonRegion& poly)
 }
 double GeoTriMeshSurface::radius(double lat, double lon)
 {
-    /* We need to fetch the raw pointer from the shared_ptr by this method */
-    CGPolygon *poly=polygon_containing_xy(trigrid,lon,lat);
-    if(poly==NULL) return(a_nan());
-    return(cg_triinterp(poly,lon,lat));
+    int tri=trigrid->locate(lon,lat,lasttri);
+    if(tri<0) return(a_nan());
+    lasttri=tri;
+    return(trigrid->interpolate(tri,lon,lat));
 }
 double GeoTriMeshSurface::depth(double lat, double lon)
 {
@@ -120,11 +168,199 @@ double GeoTriMeshSurface::depth(double lat, double lon)
 }
 bool GeoTriMeshSurface::is_defined(double lat, double lon)
 {
-    CGPolygon *poly=polygon_containing_xy(trigrid,lon,lat);
-    if(poly==NULL) 
+    int tri=trigrid->locate(lon,lat,lasttri);
+    if(tri<0) 
         return false;
+    lasttri=tri;
     if(boundary.is_inside(lat,lon))
         return true;
     else
         return false;
 }
+bool GeoTriMeshSurface::radius_if_defined(double lat, double lon, double& r)
+{
+    int tri=trigrid->locate(lon,lat,lasttri);
+    if(tri<0) 
+        return false;
+    lasttri=tri;
+    if(!boundary.is_inside(lat,lon))
+        return false;
+    r=trigrid->interpolate(tri,lon,lat);
+    return true;
+}
+/* Batch evaluation works on blocks of this many points.  Each block
+   starts its point location from the same hint and then follows the 
+   points in the block so blocks can be handled by different threads.  
+   Arrays smaller than the threshold are not split between threads. */
+const int GTMSBlockSize(512);
+const int GTMSThreadThreshold(8192);
+int GeoTriMeshSurface::batch_evaluate(const double *lat, const double *lon,
+        double *result, bool *defined, int n, bool threaded, 
+        bool return_depth)
+{
+    if(n<=0) return 0;
+    const DelaunayTriangulation *tg=trigrid.get();
+    const int hint0(lasttri);
+    int hintlast(lasttri);
+    int nblocks=(n+GTMSBlockSize-1)/GTMSBlockSize;
+    int ndefined(0);
+    int ib;
+#pragma omp parallel for schedule(dynamic) reduction(+:ndefined) if(threaded && (n>GTMSThreadThreshold))
+    for(ib=0;ib<nblocks;++ib)
+    {
+        int i0=ib*GTMSBlockSize;
+        int i1=i0+GTMSBlockSize;
+        if(i1>n) i1=n;
+        int hint=hint0;
+        for(int i=i0;i<i1;++i)
+        {
+            int tri=tg->locate(lon[i],lat[i],hint);
+            if(tri<0) 
+            {
+                defined[i]=false;
+                continue;
+            }
+            hint=tri;
+            if(!boundary.is_inside(lat[i],lon[i]))
+            {
+                defined[i]=false;
+                continue;
+            }
+            double r=tg->interpolate(tri,lon[i],lat[i]);
+            if(return_depth)
+            {
+                if(units==RADIANS)
+                    result[i]=r0_ellipse(lat[i])-r;
+                else
+                    result[i]=r0_ellipse(rad(lat[i]))-r;
+            }
+            else
+                result[i]=r;
+            defined[i]=true;
+            ++ndefined;
+        }
+        if(ib==(nblocks-1)) hintlast=hint;
+    }
+    lasttri=hintlast;
+    return(ndefined);
+}
+int GeoTriMeshSurface::batch_depth(const double *lat, const double *lon,
+        double *d, bool *defined, int n, bool threaded)
+{
+    return(this->batch_evaluate(lat,lon,d,defined,n,threaded,true));
+}
+int GeoTriMeshSurface::batch_radius(const double *lat, const double *lon,
+        double *r, bool *defined, int n, bool threaded)
+{
+    return(this->batch_evaluate(lat,lon,r,defined,n,threaded,false));
+}
+/* Scan conversion.   For each real triangle we find the grid rows 
+   inside its latitude range.  For each row the edges are intersected 
+   with the row to get the longitude interval covered by the triangle 
+   and the nodes in that interval are assigned to the triangle.  A 
+   small tolerance assures nodes on an edge shared by two triangles are
+   not lost to rounding error.  Such nodes are assigned to the first 
+   triangle found and since the surface is continuous that does not
+   matter.  Interpolation and the boundary test are done in a second 
+   pass over the nodes. */
+int GeoTriMeshSurface::rasterize_depth(GCLscalarfield& f, 
+        double undefined_value)
+{
+    LatLonGridAxes ax;
+    try {
+        ax=LatLonGridAxes(f);
+    }catch(...){throw;};
+    /* Axes are radians.  Convert to the units of the triangulation*/
+    vector<double> xax(ax.lon),yax(ax.lat);
+    int nx=xax.size();
+    int ny=yax.size();
+    int ix,iy;
+    if(units==DEGREES)
+    {
+        for(ix=0;ix<nx;++ix) xax[ix]=deg(xax[ix]);
+        for(iy=0;iy<ny;++iy) yax[iy]=deg(yax[iy]);
+    }
+    double eps=1.0e-9*max(xax[nx-1]-xax[0],yax[ny-1]-yax[0]);
+    const DelaunayTriangulation *tg=trigrid.get();
+    /* cover[iy*nx+ix] is the triangle containing node ix,iy or -1 */
+    vector<int> cover(nx*ny,-1);
+    int ntri=tg->number_triangles();
+    int t,k;
+    for(t=0;t<ntri;++t)
+    {
+        if(tg->is_ghost(t)) continue;
+        int v[3];
+        tg->vertices(t,v[0],v[1],v[2]);
+        double px[3],py[3];
+        for(k=0;k<3;++k)
+        {
+            px[k]=tg->x(v[k]);
+            py[k]=tg->y(v[k]);
+        }
+        double ymin=min(py[0],min(py[1],py[2]));
+        double ymax=max(py[0],max(py[1],py[2]));
+        int iy0=lower_bound(yax.begin(),yax.end(),ymin-eps)-yax.begin();
+        int iy1=upper_bound(yax.begin(),yax.end(),ymax+eps)-yax.begin();
+        for(iy=iy0;iy<iy1;++iy)
+        {
+            double y=yax[iy];
+            double xl(0.0),xr(0.0);
+            bool found(false);
+            for(k=0;k<3;++k)
+            {
+                int k2=(k+1)%3;
+                double x1(px[k]),y1(py[k]),x2(px[k2]),y2(py[k2]);
+                double xa,xb;
+                if(y1==y2)
+                {
+                    if(fabs(y-y1)>eps) continue;
+                    xa=min(x1,x2);
+                    xb=max(x1,x2);
+                }
+                else
+                {
+                    if((y<min(y1,y2)-eps) || (y>max(y1,y2)+eps)) continue;
+                    double s=(y-y1)/(y2-y1);
+                    if(s<0.0) s=0.0;
+                    if(s>1.0) s=1.0;
+                    xa=x1+s*(x2-x1);
+                    xb=xa;
+                }
+                if(found)
+                {
+                    xl=min(xl,xa);
+                    xr=max(xr,xb);
+                }
+                else
+                {
+                    xl=xa;
+                    xr=xb;
+                    found=true;
+                }
+            }
+            if(!found) continue;
+            int ix0=lower_bound(xax.begin(),xax.end(),xl-eps)-xax.begin();
+            int ix1=upper_bound(xax.begin(),xax.end(),xr+eps)-xax.begin();
+            int *row=&(cover[iy*nx]);
+            for(ix=ix0;ix<ix1;++ix)
+                if(row[ix]<0) row[ix]=t;
+        }
+    }
+    int ndefined(0);
+    for(iy=0;iy<ny;++iy)
+        for(ix=0;ix<nx;++ix)
+        {
+            int i,j;
+            ax.node(iy,ix,i,j);
+            t=cover[iy*nx+ix];
+            if((t<0) || !boundary.is_inside(yax[iy],xax[ix]))
+            {
+                f.val[i][j]=undefined_value;
+                continue;
+            }
+            double r=tg->interpolate(t,xax[ix],yax[iy]);
+            f.val[i][j]=r0_ellipse(ax.lat[iy])-r;
+            ++ndefined;
+        }
+    return(ndefined);
+}
@@ -1,10 +1,12 @@
 #ifndef _GEOTRIMESHSURFACE_H_
 #define _GEOTRIMESHSURFACE_H_
 #include <vector>
-#include "cgeom.h"
+#include <boost/smart_ptr.hpp>
 #include "gclgrid.h"
+#include "DelaunayTriangulation.h"
 #include "GeoSurface.h"
 #include "GeoPolygonRegion.h"
+#include "LatLonGridAxes.h"
 
 using namespace std;
 /* This enum is needed to define coordinate units. It may belong in a more 
@@ -20,7 +22,16 @@ defined by the lat and lon coordinates of the points with
 radius values defining a function defined by this group of points.
 The radius and depth methods automate interpolation of points
 inside the convex hull of the set of points used to construct
-the object. 
+the object.  Point location starts from the triangle found by the
+previous query so a series of nearby queries (e.g. along a path) 
+is very fast.
+
+The triangulation is immutable once built and is held through a
+reference counted pointer.  Copies are cheap because they share the
+triangulation.   The query methods of one object are not thread
+safe because they update the search hint, but separate copies of 
+the same surface can be queried concurrently.  The standard 
+approach is to give each thread its own copy.
 
 Users of this code should be sure that all data are consistent in 
 how they handle lat and lon coordinates.  That is, the object can be 
@@ -38,8 +49,10 @@ pole.  Be careful as well if the points cross the longitude wrap
 point.  (i.e. the date line (-180 to 180 convention) or the prime
 meridian (0 to 360 convention)).
 
-This is implemented with Kent Lindquist's Computational Geometry library 
-in antelope contrib.  
+The triangulation is built with the DelaunayTriangulation object 
+in this library.  It originally used delaunay_On4 from Kent Lindquist's 
+Computational Geometry library in antelope contrib, but that 
+algorithm is O(n^4) and was unusable for large point sets.
 \author Gary L. Pavlis
 */
 
@@ -52,11 +65,17 @@ class GeoTriMeshSurface : public GeoSurface
             surface.  
          \param units sets units of lat and lon values (default "radians").  
            If set to ANYTHING else will assume degrees. 
+         \param cachedir is a directory used to cache the triangulation.
+           If a cache file built from identical points exists in this
+           directory the triangulation is loaded from it.  Otherwise the
+           triangulation is built and saved there.  Default is an empty
+           string which disables caching.
          \exception GeoCoordError is thrown if number of points is less than 3.
            This is done since we use triangularization, which is clearly meaningless
            if we have fewer than 3 points 
          */
-        GeoTriMeshSurface(vector<Geographic_point> pts,string units="radians");
+        GeoTriMeshSurface(vector<Geographic_point> pts,string units="radians",
+                string cachedir="");
         /*! Construct from parallel sets of vectors. 
 
           This is a wrapper routine to allow an alternative specification in
@@ -67,21 +86,28 @@ class GeoTriMeshSurface : public GeoSurface
          \param d is a vector of depth values.
          \param units sets units of lat and lon values (default "radians"). 
            If set to ANYTHING else will assume degrees. 
+         \param cachedir is a cache directory (see above).
          \exception GeoCoordError object is thrown if three vectors are not the same 
             length.
          */
         GeoTriMeshSurface(vector<double> lat, vector<double> lon, 
-                vector<double>d,string units="radians");
-        /*! Standard copy constructor. */
+                vector<double>d,string units="radians",string cachedir="");
+        /*! Standard copy constructor. 
+
+          The copy shares the triangulation of the parent so this is 
+          cheap. */
         GeoTriMeshSurface(const GeoTriMeshSurface& parent);
         /*! Destructor. 
 
-          In this implementation the grid triangularization is stored 
-          internally.  The destructor is nontrivial as it has to 
-          release this work space. */
+          The triangulation is released when the last copy sharing it
+          is destroyed. */
         ~GeoTriMeshSurface();
-        /*! Standard assignment operator. */
+        /*! Standard assignment operator.  Shares the triangulation
+          of parent. */
         GeoTriMeshSurface& operator=(const GeoTriMeshSurface& parent);
+        /*! Return a copy made with the copy constructor.  Cheap
+          because the triangulation is shared. */
+        GeoSurface *clone() const {return new GeoTriMeshSurface(*this);};
         /*! Add a polygonal boundary region.
 
           This object always is constrained by the convex hull of the set of points.
@@ -117,12 +143,69 @@ class GeoTriMeshSurface : public GeoSurface
           this method tests to see if a point is inside the convex hull for 
           the triangulation of that surface. */
         bool is_defined(double lat, double lon);
+        /*! Combined is_defined and radius query.
+
+          This method does the point location in the triangulation only
+          once.   Returns true and sets r to the radius at lat,lon if 
+          the point is inside the convex hull and boundary (if defined).
+          Returns false and does not alter r otherwise.*/
+        bool radius_if_defined(double lat, double lon, double& r);
+        /*! \brief Evaluate depth at an array of points.
+
+          Native implementation of the GeoSurface batch interface.
+          Points are processed in blocks.  Each block walks through 
+          the triangulation from the triangle found for the previous 
+          point in that block so points should be ordered so 
+          neighbours in the arrays are close in space (e.g. a grid 
+          in row order).   When threaded is true blocks of large 
+          arrays are divided between threads.  Unlike the scalar 
+          methods this is safe because the search hints are local to 
+          each block.   See GeoSurface::batch_depth for arguments. */
+        int batch_depth(const double *lat, const double *lon,
+                double *d, bool *defined, int n, bool threaded=false);
+        /*! \brief Evaluate radius at an array of points.
+
+          Same as batch_depth but returns radius values. */
+        int batch_radius(const double *lat, const double *lon,
+                double *r, bool *defined, int n, bool threaded=false);
+        /*! \brief Evaluate depth on all nodes of a grid by rasterization.
+
+          This is a fast alternative to evaluating the surface node by
+          node for grids that are rectilinear in latitude and longitude 
+          (see is_latlon_rectilinear).  Instead of locating each node in
+          the triangulation each triangle is scan converted onto the grid
+          rows it spans.  Every node inside a triangle is then 
+          interpolated from that triangle's plane.  The cost is 
+          O(nodes + triangles) with no point location at all.   Results 
+          are the same as the depth method to rounding error.
+
+          \param f is the field to fill.  Its geometry defines the nodes.
+             f.val[i][j] is set to the surface depth at node i,j or to
+             undefined_value where the surface is not defined.  
+             Coordinates are not altered.
+          \param undefined_value is the value stored at nodes where the
+             surface is not defined.
+          \return number of nodes where the surface is defined.
+          \exception GeoCoordError is thrown if f is not rectilinear in 
+             latitude and longitude.
+          */
+        int rasterize_depth(GCLscalarfield& f, double undefined_value);
     private:
-        CGPartition *trigrid;
+        boost::shared_ptr<const DelaunayTriangulation> trigrid;
+        /* Last triangle found by a query.  Used as the start of 
+           the next search because successive queries are usually
+           close together.  This makes the query methods unsafe to
+           call from multiple threads on the same object. Copies 
+           each have their own hint. */
+        int lasttri;
         GeographicUnits units;
-        bool polygon_boundary_defined;
+        /* Set by AddBoundary.  The default empty region contains every
+           point so no separate flag is needed. */
         GeoPolygonRegion boundary;
         void initialize_private(vector<Geographic_point> pts,
-                string units);
+                string units,string cachedir);
+        int batch_evaluate(const double *lat, const double *lon,
+                double *result, bool *defined, int n, bool threaded,
+                bool return_depth);
 };
 #endif
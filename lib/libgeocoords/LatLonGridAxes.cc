@@ -0,0 +1,98 @@
+#include <math.h>
+#include <algorithm>
+#include "LatLonGridAxes.h"
+using namespace std;
+namespace {
+/* Check an axis is strictly monotonic and sort it into increasing order.
+   Returns the smallest spacing or 0 if the axis is not monotonic */
+double sort_axis(vector<double>& a, vector<int>& index)
+{
+    int n=a.size();
+    int i;
+    index.resize(n);
+    for(i=0;i<n;++i) index[i]=i;
+    if(n<2) return 0.0;
+    if(a[n-1]<a[0])
+    {
+        reverse(a.begin(),a.end());
+        reverse(index.begin(),index.end());
+    }
+    double dmin(a[1]-a[0]);
+    for(i=1;i<n;++i)
+    {
+        double d=a[i]-a[i-1];
+        if(d<=0.0) return 0.0;
+        if(d<dmin) dmin=d;
+    }
+    return(dmin);
+}
+bool get_latlon_axes(GCLgrid& g, LatLonGridAxes& ax)
+{
+    if((g.n1<2) || (g.n2<2)) return false;
+    int i,j;
+    vector<double> glat(g.n1*g.n2),glon(g.n1*g.n2);
+    for(i=0;i<g.n1;++i)
+        for(j=0;j<g.n2;++j)
+        {
+            glat[i*g.n2+j]=g.lat(i,j);
+            glon[i*g.n2+j]=g.lon(i,j);
+        }
+    ax.lat_along_n1=(fabs(glat[g.n2]-glat[0]) > fabs(glat[1]-glat[0]));
+    ax.lat.clear();
+    ax.lon.clear();
+    if(ax.lat_along_n1)
+    {
+        for(i=0;i<g.n1;++i) ax.lat.push_back(glat[i*g.n2]);
+        for(j=0;j<g.n2;++j) ax.lon.push_back(glon[j]);
+    }
+    else
+    {
+        for(j=0;j<g.n2;++j) ax.lat.push_back(glat[j]);
+        for(i=0;i<g.n1;++i) ax.lon.push_back(glon[i*g.n2]);
+    }
+    /* Save unsorted axes for the node test below */
+    vector<double> lat0(ax.lat),lon0(ax.lon);
+    double dlatmin=sort_axis(ax.lat,ax.latindex);
+    double dlonmin=sort_axis(ax.lon,ax.lonindex);
+    if((dlatmin<=0.0) || (dlonmin<=0.0)) return false;
+    /* Every node must match the axes to a small fraction of the 
+       node spacing.  lat and lon are computed from cartesian 
+       coordinates so they are never exact */
+    const double fraction(0.001);
+    double lattol=fraction*dlatmin;
+    double lontol=fraction*dlonmin;
+    for(i=0;i<g.n1;++i)
+        for(j=0;j<g.n2;++j)
+        {
+            double la,lo;
+            if(ax.lat_along_n1)
+            {
+                la=lat0[i];
+                lo=lon0[j];
+            }
+            else
+            {
+                la=lat0[j];
+                lo=lon0[i];
+            }
+            if(fabs(glat[i*g.n2+j]-la)>lattol) return false;
+            if(fabs(glon[i*g.n2+j]-lo)>lontol) return false;
+        }
+    return true;
+}
+}  // end anonymous namespace
+LatLonGridAxes::LatLonGridAxes()
+{
+    lat_along_n1=true;
+}
+LatLonGridAxes::LatLonGridAxes(GCLgrid& g)
+{
+    if(!get_latlon_axes(g,*this))
+        throw GeoCoordError(string("LatLonGridAxes constructor:  ")
+                + "grid is not rectilinear in latitude and longitude");
+}
+bool is_latlon_rectilinear(GCLgrid& g)
+{
+    LatLonGridAxes ax;
+    return(get_latlon_axes(g,ax));
+}
@@ -0,0 +1,68 @@
+#ifndef _LATLONGRIDAXES_H_
+#define _LATLONGRIDAXES_H_
+#include <vector>
+#include "gclgrid.h"
+#include "GeoCoordError.h"
+using namespace std;
+/*! \brief Axes of a GCLgrid that is a regular mesh in latitude and longitude.
+
+  Many GCLgrid objects are built as a simple mesh in latitude and
+  longitude.   For such grids latitude varies with only one of the two
+  grid indices and longitude with the other.   Algorithms that scan
+  convert geometry onto a grid (e.g. rasterizing a triangulation or a
+  polygon) need only the two axes.  This object extracts them.
+
+  Axis values are sorted in increasing order.   The index vectors hold
+  the grid index that matches each axis value so the grid node for
+  axis position (ilat,ilon) is found with the node method.  Like the
+  rest of this library all angles are in radians.
+  */
+class LatLonGridAxes
+{
+public:
+    /*! Default constructor.  Creates empty axes. */
+    LatLonGridAxes();
+    /*! \brief Extract the axes of a grid.
+
+      \param g is the grid.
+      \exception GeoCoordError is thrown if g is not rectilinear in
+        latitude and longitude (see is_latlon_rectilinear).
+      */
+    LatLonGridAxes(GCLgrid& g);
+    /*! Return the grid indices i,j of axis position ilat,ilon. */
+    void node(int ilat, int ilon, int& i, int& j) const
+    {
+        if(lat_along_n1)
+        {
+            i=latindex[ilat];
+            j=lonindex[ilon];
+        }
+        else
+        {
+            i=lonindex[ilon];
+            j=latindex[ilat];
+        }
+    };
+    /*! Latitudes of the grid rows sorted in increasing order. */
+    vector<double> lat;
+    /*! Longitudes of the grid columns sorted in increasing order. */
+    vector<double> lon;
+    /*! Grid index of each latitude in lat. */
+    vector<int> latindex;
+    /*! Grid index of each longitude in lon. */
+    vector<int> lonindex;
+    /*! True if latitude varies with the first (x1) grid index. */
+    bool lat_along_n1;
+};
+/*! \brief Test if a grid is rectilinear in latitude and longitude.
+
+  A grid is rectilinear in this sense if latitude varies with only one
+  of the two grid indices, longitude varies with only the other, and
+  both change monotonically along their index.   Grids built as a
+  regular lat,lon mesh satisfy this test while grids built in a
+  rotated cartesian frame normally do not.
+  \param g is the grid to test.
+  \return true if g is rectilinear in lat and lon.
+  */
+bool is_latlon_rectilinear(GCLgrid& g);
+#endif
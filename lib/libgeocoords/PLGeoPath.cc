@@ -1,9 +1,59 @@
+#include <math.h>
+#include <float.h>
+#include "coords.h"
 #include "PLGeoPath.h"
 #include "GeoCoordError.h"
 #include "interpolator1d.h"
 using namespace INTERPOLATOR1D;
+namespace {
+/* Below this value of sin of the angle between two unit vectors slerp
+   is replaced by normalized linear interpolation.  About 6 m at the
+   earth's surface. */
+const double SlerpTolerance(1.0e-6);
+/* Interpolate along the great circle through unit vectors u0 and u1.
+   f=0 gives u0 and f=1 u1.  Other values of f extrapolate along the 
+   same great circle. */
+void slerp(const double *u0, const double *u1, double f, double *u)
+{
+    double c=u0[0]*u1[0]+u0[1]*u1[1]+u0[2]*u1[2];
+    double cr[3];
+    cr[0]=u0[1]*u1[2]-u0[2]*u1[1];
+    cr[1]=u0[2]*u1[0]-u0[0]*u1[2];
+    cr[2]=u0[0]*u1[1]-u0[1]*u1[0];
+    double sn=sqrt(cr[0]*cr[0]+cr[1]*cr[1]+cr[2]*cr[2]);
+    int k;
+    if(sn<SlerpTolerance)
+    {
+        double len(0.0);
+        for(k=0;k<3;++k)
+        {
+            u[k]=(1.0-f)*u0[k]+f*u1[k];
+            len+=u[k]*u[k];
+        }
+        len=sqrt(len);
+        for(k=0;k<3;++k) u[k]/=len;
+    }
+    else
+    {
+        double omega=atan2(sn,c);
+        double a=sin((1.0-f)*omega)/sn;
+        double b=sin(f*omega)/sn;
+        for(k=0;k<3;++k) u[k]=a*u0[k]+b*u1[k];
+    }
+}
+/* Normalize a 3 vector.  Returns the length and leaves x alone if
+   the length is 0 */
+double normalize3(double *x)
+{
+    double len=sqrt(x[0]*x[0]+x[1]*x[1]+x[2]*x[2]);
+    if(len>0.0)
+        for(int k=0;k<3;++k) x[k]/=len;
+    return(len);
+}
+}  // end anonymous namespace
 PLGeoPath::PLGeoPath() : coordxyz(0.0,0.0,0.0,0.0)
 {
+    for(int k=0;k<3;++k) center[k]=0.0;
     lat.reserve(1);
     lon.reserve(1);
     r.reserve(1);
@@ -11,6 +61,7 @@ PLGeoPath::PLGeoPath() : coordxyz(0.0,0.0,0.0,0.0)
     s0.lat=0.0;
     s0.lon=0.0;
     s0.r=6371.0;
+    this->build_cache();
 }
 
 PLGeoPath::PLGeoPath(vector<Geographic_point>& pts,int i0,double az0)
@@ -45,8 +96,9 @@ PLGeoPath::PLGeoPath(vector<Geographic_point>& pts,int i0,double az0)
     {
         dist(lat[i+1],lon[i+1],lat[i],lon[i],&ddelta,&az);
         ddkm=ddelta*EarthRadius;
-        s[i]=s[i+1]-hypot(ddkm,r[i]-r[i-1]);
+        s[i]=s[i+1]-hypot(ddkm,r[i+1]-r[i]);
     }
+    this->build_cache();
 }
 PLGeoPath::PLGeoPath(const PLGeoPath& parent) : coordxyz(parent.coordxyz)
 {
@@ -55,6 +107,10 @@ PLGeoPath::PLGeoPath(const PLGeoPath& parent) : coordxyz(parent.coordxyz)
     r=parent.r;
     s=parent.s;
     s0=parent.s0;
+    unit_geo=parent.unit_geo;
+    unit_xyz=parent.unit_xyz;
+    xyz=parent.xyz;
+    for(int k=0;k<3;++k) center[k]=parent.center[k];
 }
 PLGeoPath& PLGeoPath::operator=(const PLGeoPath& parent)
 {
@@ -66,44 +122,128 @@ PLGeoPath& PLGeoPath::operator=(const PLGeoPath& parent)
         s=parent.s;
         s0=parent.s0;
         coordxyz=parent.coordxyz;
+        unit_geo=parent.unit_geo;
+        unit_xyz=parent.unit_xyz;
+        xyz=parent.xyz;
+        for(int k=0;k<3;++k) center[k]=parent.center[k];
     }
     return(*this);
 }
+/* Node geometry is computed with the array version of the 
+   RegionalCoordinates transformation.  The earth's center in the 
+   coordxyz frame is the transformation of a point with zero radius. */
+void PLGeoPath::build_cache()
+{
+    int npts=lat.size();
+    unit_geo.resize(3*npts);
+    unit_xyz.resize(3*npts);
+    xyz.resize(3*npts);
+    Cartesian_point cp=coordxyz.cartesian(0.0,0.0,0.0);
+    center[0]=cp.x1;
+    center[1]=cp.x2;
+    center[2]=cp.x3;
+    if(npts>0)
+    {
+        vector<double> x1(npts),x2(npts),x3(npts);
+        coordxyz.cartesian(&(lat[0]),&(lon[0]),&(r[0]),&(x1[0]),&(x2[0]),
+                &(x3[0]),npts);
+        for(int i=0;i<npts;++i)
+        {
+            double *x=&(xyz[3*i]);
+            double *u=&(unit_xyz[3*i]);
+            x[0]=x1[i];
+            x[1]=x2[i];
+            x[2]=x3[i];
+            for(int k=0;k<3;++k) u[k]=(x[k]-center[k])/r[i];
+            dsphcar(lon[i],lat[i],&(unit_geo[3*i]));
+        }
+    }
+}
+/* Great circle interpolation on segment is.   The longitude is kept
+   within pi of the first node of the segment so paths given with 0 to 
+   2pi longitudes stay that way. */
+Geographic_point PLGeoPath::interpolate(int is, double sp)
+{
+    Geographic_point result;
+    double f=(sp-s[is])/(s[is+1]-s[is]);
+    double u[3];
+    slerp(&(unit_geo[3*is]),&(unit_geo[3*is+3]),f,u);
+    result.lat=atan2(u[2],hypot(u[0],u[1]));
+    result.lon=atan2(u[1],u[0]);
+    result.lon+=2.0*M_PI*floor((lon[is]-result.lon)/(2.0*M_PI)+0.5);
+    result.r=linear_scalar(sp,s[is],r[is],s[is+1],r[is+1]);
+    return(result);
+}
+Cartesian_point PLGeoPath::interpolate_xyz(int is, double sp)
+{
+    Cartesian_point result;
+    double f=(sp-s[is])/(s[is+1]-s[is]);
+    double u[3];
+    slerp(&(unit_xyz[3*is]),&(unit_xyz[3*is+3]),f,u);
+    double rsp=linear_scalar(sp,s[is],r[is],s[is+1],r[is+1]);
+    result.x1=center[0]+rsp*u[0];
+    result.x2=center[1]+rsp*u[1];
+    result.x3=center[2]+rsp*u[2];
+    return(result);
+}
 /* This method should do a linear extrapolation for points beyond
    the endpoints */
 Geographic_point PLGeoPath::position(double sp)
 {
-    Geographic_point result;
     int npts=s.size();
+    if(npts<2) return(this->begin());
     int is;
     is=irregular_lookup(sp,&(s[0]),npts);
-    if(is<=0)
-    {
-        result.lat=linear_scalar(sp,s[0],lat[0],s[1],lat[1]);
-        result.lon=linear_scalar(sp,s[0],lon[0],s[1],lon[1]);
-        result.r=linear_scalar(sp,s[0],r[0],s[1],r[1]);
-    }
-    else if(is>=(npts-2))
+    if(is<0) is=0;
+    if(is>(npts-2)) is=npts-2;
+    return(this->interpolate(is,sp));
+}
+Cartesian_point  PLGeoPath::position_xyz(double sp)
+{
+    int npts=s.size();
+    if(npts<2) return(this->coordxyz.cartesian(this->begin()));
+    int is;
+    is=irregular_lookup(sp,&(s[0]),npts);
+    if(is<0) is=0;
+    if(is>(npts-2)) is=npts-2;
+    return(this->interpolate_xyz(is,sp));
+}
+/* Segments are selected the same way as position:  the segment 
+   starting at the last node with s at or below sp with the first and 
+   last segments extended for extrapolation. */
+int PLGeoPath::find_segment(double sp, int is)
+{
+    int nseg=s.size()-1;
+    while((is<(nseg-1)) && (sp>=s[is+1])) ++is;
+    while((is>0) && (sp<s[is])) --is;
+    return(is);
+}
+vector<Geographic_point> PLGeoPath::positions(const vector<double>& sp)
+{
+    vector<Geographic_point> result;
+    int nsp=sp.size();
+    result.reserve(nsp);
+    if(s.size()<2)
     {
-        result.lat=linear_scalar(sp,s[npts-2],lat[npts-2],
-                s[npts-1],lat[npts-1]);
-        result.lon=linear_scalar(sp,s[npts-2],lon[npts-2],
-                s[npts-1],lon[npts-1]);
-        result.r=linear_scalar(sp,s[npts-2],r[npts-2],
-                s[npts-1],r[npts-1]);
+        /* position does not support this case either */
+        for(int k=0;k<nsp;++k) result.push_back(this->position(sp[k]));
+        return(result);
     }
-    else
+    int is(0);
+    for(int k=0;k<nsp;++k)
     {
-        result.lat=linear_scalar(sp,s[is],lat[is],s[is+1],lat[is+1]);
-        result.lon=linear_scalar(sp,s[is],lon[is],s[is+1],lon[is+1]);
-        result.r=linear_scalar(sp,s[is],r[is],s[is+1],r[is+1]);
+        is=find_segment(sp[k],is);
+        result.push_back(this->interpolate(is,sp[k]));
     }
     return(result);
 }
-Cartesian_point  PLGeoPath::position_xyz(double sp)
+PLGeoPath PLGeoPath::resample(const vector<double>& sp)
 {
-    Geographic_point gp=this->position(sp);
-    return(this->coordxyz.cartesian(gp));
+    if(sp.empty())
+        throw GeoCoordError(string("PLGeoPath::resample method:  ")
+                + "empty list of path parameters");
+    vector<Geographic_point> pts=this->positions(sp);
+    return(PLGeoPath(pts,0));
 }
 double PLGeoPath::latitude(double sp)
 {
@@ -146,11 +286,15 @@ double PLGeoPath::send()
 {
     return(s[lat.size()-1]);
 }
-Geographic_point PLGeoPath::node_position(int i)
+void PLGeoPath::check_node_index(int i,const string method)
 {
     if(i<0 || i>=(this->number_points()) )
-        throw GeoCoordError(string("PLGeoPath::node_position method:  ")
+        throw GeoCoordError(string("PLGeoPath::")+method+" method:  "
                 + "requested point outside range of node points");
+}
+Geographic_point PLGeoPath::node_position(int i)
+{
+    this->check_node_index(i,"node_position");
     Geographic_point result;
     result.lat=lat[i];
     result.lon=lon[i];
@@ -159,18 +303,64 @@ Geographic_point PLGeoPath::node_position(int i)
 }
 Cartesian_point PLGeoPath::node_position_xyz(int i)
 {
-    try {
-    Geographic_point gp=this->node_position(i);
-    return(this->coordxyz.cartesian(gp));
-    } catch(...){throw;};
+    this->check_node_index(i,"node_position_xyz");
+    Cartesian_point result;
+    result.x1=xyz[3*i];
+    result.x2=xyz[3*i+1];
+    result.x3=xyz[3*i+2];
+    return(result);
 }
 double PLGeoPath::node_path_parameter(int i)
 {
-    if(i<0 || i>=(this->number_points()) )
-        throw GeoCoordError(string("PLGeoPath::node_path_parameter method:  ")
-                + "requested point outside range of node points");
+    this->check_node_index(i,"node_path_parameter");
     return(s[i]);
 }
+double PLGeoPath::node_tangent(int i, double *t)
+{
+    this->check_node_index(i,"node_tangent");
+    int npts=this->number_points();
+    if(npts<2) throw GeoCoordError(string("PLGeoPath::node_tangent method:  ")
+            + "path has only one point");
+    if(i==(npts-1)) --i;
+    for(int k=0;k<3;++k) t[k]=xyz[3*i+3+k]-xyz[3*i+k];
+    return(normalize3(t));
+}
+double PLGeoPath::node_curvature(int i)
+{
+    this->check_node_index(i,"node_curvature");
+    if((i==0) || (i==(this->number_points()-1))) return(0.0);
+    double t0[3],t1[3],cr[3];
+    double ds0=this->node_tangent(i-1,t0);
+    double ds1=this->node_tangent(i,t1);
+    dr3cros(t0,t1,cr);
+    double angle=atan2(dr3mag(cr),t0[0]*t1[0]+t0[1]*t1[1]+t0[2]*t1[2]);
+    return(2.0*angle/(ds0+ds1));
+}
+bool PLGeoPath::node_normal(int i, double *n)
+{
+    this->check_node_index(i,"node_normal");
+    int npts=this->number_points();
+    int k;
+    for(k=0;k<3;++k) n[k]=0.0;
+    if(npts<3) return(false);
+    if(i==0) i=1;
+    if(i==(npts-1)) i=npts-2;
+    double t0[3],t1[3];
+    this->node_tangent(i-1,t0);
+    this->node_tangent(i,t1);
+    for(k=0;k<3;++k) n[k]=t1[k]-t0[k];
+    if(normalize3(n)<DBL_EPSILON)
+    {
+        for(k=0;k<3;++k) n[k]=0.0;
+        return(false);
+    }
+    return(true);
+}
+void PLGeoPath::node_vertical(int i, double *u)
+{
+    this->check_node_index(i,"node_vertical");
+    for(int k=0;k<3;++k) u[k]=unit_xyz[3*i+k];
+}
 
 ostream& operator<<(ostream& os,PLGeoPath& path)
 {
@@ -191,3 +381,54 @@ ostream& operator<<(ostream& os,PLGeoPath& path)
     return os;
 }
 
+
+PLGeoPath resample_PLGeoPath(PLGeoPath& raw,double ds)
+{
+    if(ds<=0.0) 
+        throw GeoCoordError("resample_PLGeoPath was passed a negative resample interval");
+    double smax=raw.send();
+    vector<double> sp;
+    double sk;
+    for(sk=raw.sbegin()+ds;sk<smax;sk+=ds) sp.push_back(sk);
+    vector<Geographic_point> newpts;
+    newpts.reserve(sp.size()+1);
+    newpts.push_back(raw.origin());
+    vector<Geographic_point> pts=raw.positions(sp);
+    newpts.insert(newpts.end(),pts.begin(),pts.end());
+    return(PLGeoPath(newpts,0));
+}
+PLGeoPath timesample_PLGeoPath(PLGeoPath& raw, const vector<double>& t,
+        const vector<double>& s, double dt, double endtime)
+{
+    const string base_error("timesample_PLGeoPath:  ");
+    if(t.size()!=s.size()) throw GeoCoordError(base_error
+            + "time and distance vector sizes do not match");
+    int nt=t.size();
+    if(nt<=1) throw GeoCoordError(base_error
+            + "empty vectors for time and distance for path");
+    if(dt<=0.0) throw GeoCoordError(base_error
+            + "time sample interval must be positive");
+    double tmax=t[nt-1];
+    /* terminate on either end of the path or the passed endtime 
+       argument.  A negative endtime means no limit. */
+    bool use_endtime(endtime>=0.0);
+    double etest=endtime+(0.01*dt);  //allow some slop for this test
+    /* Times increase so the interval holding each sample time is 
+       found by advancing a cursor */
+    vector<double> sp;
+    int i(1);
+    double t0;
+    for(t0=dt;(t0<tmax) && (!use_endtime || (t0<=etest));t0+=dt)
+    {
+        while((i<nt) && (t[i]<=t0)) ++i;
+        double dsdt=(s[i]-s[i-1])/(t[i]-t[i-1]);
+        sp.push_back(s[i-1]+(t0-t[i-1])*dsdt);
+    }
+    //Assume first point is time t=0;
+    vector<Geographic_point> newpts;
+    newpts.reserve(sp.size()+1);
+    newpts.push_back(raw.origin());
+    vector<Geographic_point> pts=raw.positions(sp);
+    newpts.insert(newpts.end(),pts.begin(),pts.end());
+    return(PLGeoPath(newpts,0));
+}
@@ -10,6 +10,14 @@ distance along the path (in km) from the origin.  An approximation is used for t
 is presumed the total distance between two points is sqrt(distance(lat1,lon1,lat2,lon2)^2+dz^2)
 That is, it is assymptotic to L2 when the two control points are close enough to neglect 
 great circle path curvature.  
+
+Between control points the path follows the great circle through them
+(spherical linear interpolation of the unit vectors pointing to the nodes) 
+with radius varying linearly.   Unit vectors and Cartesian coordinates of
+the nodes are computed once by the constructors so the Cartesian and
+geometry methods (tangent, curvature, and normal) are simple arithmetic
+on cached data.  Query methods do not alter the object so one path can
+be read by multiple threads.
 */
 class PLGeoPath : public GeoPath
 {
@@ -42,12 +50,34 @@ public:
         distance, sp (in km), from a specified origin.  This method returns the geographical
         coordinates of the curve for a specified distance sp. Note this method always returns
         an answer. If the distance sp is beyond the range of support of control points the curve
-        is extrapolated using a linear project of the two points closest to the appropriate
+        is extrapolated along the great circle through the two points closest to the appropriate
         endpoint.
         \param sp is the distance in km from the origin whose coordinates are requested.
         \return point requested as a Geographic_point object.
         */
      Geographic_point position(double sp);
+     /*! \brief Return positions for a sequence of curve parameters.
+
+        Gives the same result as calling position for each element of
+        sp but the path is walked with a cursor instead of searching
+        for each sample.   The cost is proportional to the number of 
+        samples plus the number of nodes when sp is sorted (in either 
+        direction).  Unsorted input works but is slower.
+        \param sp is the list of distances in km from the origin.
+        \return vector of points matching sp.
+        */
+     vector<Geographic_point> positions(const vector<double>& sp);
+     /*! \brief Resample the path.
+
+        Creates a new path with nodes at the positions of curve 
+        parameters sp (computed with the positions method).   The first
+        point is the origin of the new path.
+        \param sp is the list of distances in km from the origin.
+        \exception GeoCoordError is thrown if sp is empty.
+        */
+     PLGeoPath resample(const vector<double>& sp);
+     /*! Same as position but returns the point in the internal Cartesian 
+       system (coordxyz). */
      Cartesian_point position_xyz(double sp);
      double latitude(double sp);
      double longitude(double sp);
@@ -85,13 +115,95 @@ public:
        \param i is the index position of the requested node.
        \exception SeisppError is throw if i is out of range */
      double node_path_parameter(int i);
+     /*! \brief Return the unit tangent vector at node i.
+
+       The tangent is the direction from node i to node i+1 in the 
+       internal Cartesian system (forward difference).  The last node 
+       uses the previous segment.
+       \param i is the index position of the node.
+       \param t is a 3 vector where the result is stored.
+       \return length (km) of the segment used.
+       \exception GeoCoordError is thrown if i is out of range or the
+         path has fewer than two points.
+       */
+     double node_tangent(int i, double *t);
+     /*! \brief Return curvature of the path at node i.
+
+       Curvature is the angle between the segments on each side of node
+       i divided by the average segment length (units of 1/km).  It is
+       0 at the end points.
+       \exception GeoCoordError is thrown if i is out of range.
+       */
+     double node_curvature(int i);
+     /*! \brief Return the principal normal at node i.
+
+       The normal is the unit vector in the direction the tangent turns
+       at node i (internal Cartesian system).  End points use the value
+       of the adjacent node.
+       \param i is the index position of the node.
+       \param n is a 3 vector where the result is stored.
+       \return false if the path is straight at i (n is then set to 0).
+       \exception GeoCoordError is thrown if i is out of range.
+       */
+     bool node_normal(int i, double *n);
+     /*! \brief Return the local vertical at node i.
+
+       \param i is the index position of the node.
+       \param u is a 3 vector where the unit vector pointing away from
+         the center of the earth in the internal Cartesian system is 
+         stored.
+       \exception GeoCoordError is thrown if i is out of range.
+       */
+     void node_vertical(int i, double *u);
      PLGeoPath& operator=(const PLGeoPath& parent);
      friend ostream& operator<<(ostream& os,PLGeoPath&);
 private:
+     /* Cursor used by positions.  Walks to the segment holding sp
+        starting from segment is and returns the new segment. */
+     int find_segment(double sp, int is);
+     /* Geometry of the nodes.  Built by build_cache in the 
+        constructors.  Each holds 3 values per node.  unit_geo are unit
+        vectors in the earth centered frame used by dsphcar, unit_xyz
+        are the same vectors in the coordxyz frame, and xyz are the
+        Cartesian coordinates in the coordxyz frame.  */
+     vector<double> unit_geo,unit_xyz,xyz;
+     /* Position of the earth's center in the coordxyz frame */
+     double center[3];
+     void build_cache();
+     void check_node_index(int i,const string method);
+     Geographic_point interpolate(int is, double sp);
+     Cartesian_point interpolate_xyz(int is, double sp);
      /*! Store control points in four parallel vector containers */
      vector<double> lat,lon,r,s;
      /*! store this point to allow it to be anywhere on the path and not have
        to interpolate to figure it's location */
      Geographic_point s0;  
 };
+/*! \brief Resample a path at a uniform interval.
+
+  Returns a path with the origin of raw followed by points at 
+  sbegin()+ds, sbegin()+2ds, ... up to the end of raw.
+  \param raw is the path to sample.
+  \param ds is the sample interval in km.
+  \exception GeoCoordError is thrown if ds is not positive.
+  */
+PLGeoPath resample_PLGeoPath(PLGeoPath& raw,double ds);
+/*! \brief Sample a path uniformly in time.
+
+  Paths built from plate motion models are parameterized by distance
+  but are needed at uniform time intervals.  t and s define the 
+  distance along raw as a piecewise linear function of time with t=0
+  at the origin.   The result has the origin of raw followed by 
+  points at times dt, 2dt, ... up to the last time in t or endtime 
+  (whichever is smaller).
+  \param raw is the path to sample.
+  \param t is the list of times (must increase).
+  \param s is the distance along raw at each time in t.
+  \param dt is the sample interval in time.
+  \param endtime is the largest time sampled (a small tolerance
+    is allowed).  A negative value (the default) means no limit.
+  \exception GeoCoordError is thrown if t and s are inconsistent.
+  */
+PLGeoPath timesample_PLGeoPath(PLGeoPath& raw, const vector<double>& t,
+        const vector<double>& s, double dt, double endtime=-1.0);
 #endif
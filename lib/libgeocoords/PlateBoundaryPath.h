@@ -3,6 +3,7 @@
 #include <float.h>
 #include "gclgrid.h"
 #include "GeoPath.h"
+#include "StagePoleModel.h"
 /*! Object to project a small circle path defining a plate boundary.
 
   In plate tectonics transform plate boundaries and motion vectors
@@ -91,6 +92,10 @@ private:
   plates have variable time history that is specified as a set of stage poles.
   This object is a variant of PlateBoundaryPath but for plates with stage
   poles models for longer term motion. 
+
+  Positions are computed with a StagePoleModel so the cost of a position
+  or distance does not depend on the number of stages.  Applications that
+  need many points at many times should use StagePoleModel directly.
   */
 class TimeVariablePlateBoundaryPath : public GeoPath
 {
@@ -138,6 +143,14 @@ public:
         times are not in decreasing time order. 
         */
     TimeVariablePlateBoundaryPath(string fname,double ola, double olo);
+    /*! \brief Construct from a stage pole model.
+
+      \param spm is the stage pole history.
+      \param ola latitude of origin of path to be projected (radians)
+      \param olo longitude of origin of path to be projected (radians)
+      */
+    TimeVariablePlateBoundaryPath(const StagePoleModel& spm, double ola,
+            double olo);
 
     /*! Standard copy constructor. */
     TimeVariablePlateBoundaryPath(const TimeVariablePlateBoundaryPath& parent);
@@ -184,24 +197,16 @@ public:
     /*! Return time at arc distance s in km */
     double time(double s);
 private:
-    vector<double> splat, splon,dt;
-    /* These become vectors to simplify path calculation */
-    vector<double> olat,olon;
-    /* This vector contains path arc length (radians of the longitude 
-       like angle subtended) to each interval point. 
-       Thus ss[0]=0, ss[1] is distance to olat[1],olon[1] from olat[0],olon[0],
-       etc accumulating for each successive stage pole. */
-    vector<double> ss;
+    /* Finite rotations for the stage pole history */
+    StagePoleModel rotations;
+    /* Origin of the path (radians) */
+    double olat,olon;
     /* This holds small circle distance (radians) from each stage pole to the 
-       first point on the path defined by that pole. Same length as
-       stage pole vectors */
+       first point on the path defined by that pole. One value per stage. */
     vector<double> ssdelta;
-    /* Similar vector of azimuth at pole to point defined as origin */
-    vector<double> azimuth0;
-    /* Angular velocities in radians/year.  Just angles[i]/dt[i],
-      but more convenient than storing angles. */
-    vector<double>  omegadot;  //angular velocity in radians
-    /* Integrated time to origin for each stage pole segment */
-    vector<double>  t0;
+    /* Path distance (km) to the start of each stage.  Same length as the
+       stage start times (one more than the number of stages). */
+    vector<double> sdist;
+    void build_path();
 };
 #endif
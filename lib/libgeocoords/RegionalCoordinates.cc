@@ -146,6 +146,101 @@ Geographic_point RegionalCoordinates::geographic(Cartesian_point cp)
     x[2]=cp.x3;
     return(this->geographic(x));
 }
+/* The array versions of cartesian and geographic work on blocks of 
+   this many points.   Intermediate values for one block are staged 
+   in small stack buffers so they stay in cache while the arithmetic 
+   loops that follow run without function calls and can be vectorized.
+   Arrays smaller than ThreadThreshold are never split between threads 
+   because the startup cost exceeds the gain.  */
+const int RCBlockSize(256);
+const int RCThreadThreshold(16384);
+void RegionalCoordinates::cartesian(const double *lat, const double *lon, 
+        const double *r, double *x1, double *x2, double *x3, int n, 
+        bool threaded)
+{
+    if(n<=0) return;
+    /* Copy the transformation to locals so the compiler knows they 
+       do not alias the output arrays */
+    const double r00(gtoc_rmatrix[0][0]),r01(gtoc_rmatrix[0][1]),
+          r02(gtoc_rmatrix[0][2]);
+    const double r10(gtoc_rmatrix[1][0]),r11(gtoc_rmatrix[1][1]),
+          r12(gtoc_rmatrix[1][2]);
+    const double r20(gtoc_rmatrix[2][0]),r21(gtoc_rmatrix[2][1]),
+          r22(gtoc_rmatrix[2][2]);
+    const double t0(translation_vector[0]),t1(translation_vector[1]),
+          t2(translation_vector[2]);
+    int nblocks=(n+RCBlockSize-1)/RCBlockSize;
+    int ib;
+#pragma omp parallel for schedule(static) if(threaded && (n>RCThreadThreshold))
+    for(ib=0;ib<nblocks;++ib)
+    {
+        double xg[RCBlockSize],yg[RCBlockSize],zg[RCBlockSize];
+        int i0=ib*RCBlockSize;
+        int nb=n-i0;
+        if(nb>RCBlockSize) nb=RCBlockSize;
+        int i;
+        /* First pass is the equivalent of dsphcar scaled by r with the 
+           origin translation removed */
+        for(i=0;i<nb;++i)
+        {
+            double clat=cos(lat[i0+i]);
+            double rc=r[i0+i]*clat;
+            xg[i]=rc*cos(lon[i0+i]) - t0;
+            yg[i]=rc*sin(lon[i0+i]) - t1;
+            zg[i]=r[i0+i]*sin(lat[i0+i]) - t2;
+        }
+        /* Second pass is the rotation and is pure arithmetic */
+        for(i=0;i<nb;++i)
+        {
+            x1[i0+i]=r00*xg[i]+r01*yg[i]+r02*zg[i];
+            x2[i0+i]=r10*xg[i]+r11*yg[i]+r12*zg[i];
+            x3[i0+i]=r20*xg[i]+r21*yg[i]+r22*zg[i];
+        }
+    }
+}
+void RegionalCoordinates::geographic(const double *x1, const double *x2, 
+        const double *x3, double *lat, double *lon, double *r, int n, 
+        bool threaded)
+{
+    if(n<=0) return;
+    const double r00(gtoc_rmatrix[0][0]),r01(gtoc_rmatrix[0][1]),
+          r02(gtoc_rmatrix[0][2]);
+    const double r10(gtoc_rmatrix[1][0]),r11(gtoc_rmatrix[1][1]),
+          r12(gtoc_rmatrix[1][2]);
+    const double r20(gtoc_rmatrix[2][0]),r21(gtoc_rmatrix[2][1]),
+          r22(gtoc_rmatrix[2][2]);
+    const double t0(translation_vector[0]),t1(translation_vector[1]),
+          t2(translation_vector[2]);
+    int nblocks=(n+RCBlockSize-1)/RCBlockSize;
+    int ib;
+#pragma omp parallel for schedule(static) if(threaded && (n>RCThreadThreshold))
+    for(ib=0;ib<nblocks;++ib)
+    {
+        double xg[RCBlockSize],yg[RCBlockSize],zg[RCBlockSize];
+        int i0=ib*RCBlockSize;
+        int nb=n-i0;
+        if(nb>RCBlockSize) nb=RCBlockSize;
+        int i;
+        /* Multiply by the transpose of the rotation matrix and add back
+           the translation vector.  Same algorithm as the scalar 
+           geographic method without the BLAS calls.  */
+        for(i=0;i<nb;++i)
+        {
+            double a(x1[i0+i]),b(x2[i0+i]),c(x3[i0+i]);
+            xg[i]=r00*a+r10*b+r20*c + t0;
+            yg[i]=r01*a+r11*b+r21*c + t1;
+            zg[i]=r02*a+r12*b+r22*c + t2;
+        }
+        /* Equivalent of dcarsph and dnrm2 */
+        for(i=0;i<nb;++i)
+        {
+            double rh=hypot(xg[i],yg[i]);
+            lon[i0+i]=atan2(yg[i],xg[i]);
+            lat[i0+i]=atan2(zg[i],rh);
+            r[i0+i]=sqrt(rh*rh+zg[i]*zg[i]);
+        }
+    }
+}
 /* This method is effecively a format converter from a vector to a struct*/
 Cartesian_point RegionalCoordinates::cartesian(double x[3])
 {
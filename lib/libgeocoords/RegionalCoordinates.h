@@ -101,6 +101,48 @@ public:
     \return converted point in Geographic_point struct (radians and km units)
     */
     Geographic_point geographic(Cartesian_point cp);
+    /*! \brief Convert arrays of geographic points to cartesian coordinates.
+
+      This is the array version of the cartesian methods intended for
+      bulk conversions of large point sets.   Input and output are held
+      in parallel (structure of arrays) buffers.   Points are processed 
+      in blocks with trig values computed first and the rotation done in 
+      a separate pass that the compiler can vectorize.  The trig 
+      functions are ordinary scalar libm calls.  The gain comes from 
+      removing the BLAS calls and struct returns of the scalar methods,
+      the vectorized rotation, and the optional thread split.  Results 
+      are identical (to rounding error) to calling cartesian for each 
+      point.  The rcbenchmark program compares the two.
+
+      \param lat is an array of n latitudes (radians)
+      \param lon is an array of n longitudes (radians)
+      \param r is an array of n radius values (km)
+      \param x1 is the output array (length n) for x1 coordinates (km)
+      \param x2 is the output array (length n) for x2 coordinates (km)
+      \param x3 is the output array (length n) for x3 coordinates (km)
+      \param n is the number of points to convert.
+      \param threaded when true large arrays are split between threads
+        (requires the library be compiled with OpenMP).  default is false.
+      */
+    void cartesian(const double *lat, const double *lon, const double *r,
+            double *x1, double *x2, double *x3, int n, bool threaded=false);
+    /*! \brief Convert arrays of cartesian points to geographic coordinates.
+
+      Array version of the geographic methods and the inverse of the
+      array version of cartesian.  Buffers are parallel arrays and the
+      same blocking and threading scheme is used.
+
+      \param x1 is an array of n x1 coordinates (km)
+      \param x2 is an array of n x2 coordinates (km)
+      \param x3 is an array of n x3 coordinates (km)
+      \param lat is the output array (length n) of latitudes (radians)
+      \param lon is the output array (length n) of longitudes (radians)
+      \param r is the output array (length n) of radius values (km)
+      \param n is the number of points to convert.
+      \param threaded when true large arrays are split between threads.
+      */
+    void geographic(const double *x1, const double *x2, const double *x3,
+            double *lat, double *lon, double *r, int n, bool threaded=false);
     /*! Return the origin of the coordinate system. */
     Geographic_point origin();
     /*! Return the azimuth of the coordinate system which is the angle
@@ -0,0 +1,82 @@
+#include <math.h>
+#include "gclgrid.h"
+#include "RegularGrid2d.h"
+using namespace std;
+RegularGrid2d::RegularGrid2d()
+{
+    x0=0.0;
+    y0=0.0;
+    dx=1.0;
+    dy=1.0;
+    nx=0;
+    ny=0;
+}
+RegularGrid2d::RegularGrid2d(double xmin, double ymin, double dxin,
+        double dyin, int nxin, int nyin) : z(nxin*nyin,0.0)
+{
+    x0=xmin;
+    y0=ymin;
+    dx=dxin;
+    dy=dyin;
+    nx=nxin;
+    ny=nyin;
+}
+RegularGrid2d::RegularGrid2d(BinaryCacheReader& in)
+{
+    vector<double> dpar;
+    vector<int> ipar;
+    try {
+        in.read(dpar);
+        in.read(ipar);
+        in.read(z);
+    }catch(...){throw;};
+    if((dpar.size()!=4) || (ipar.size()!=2))
+        throw GeoCoordError(string("RegularGrid2d cache file constructor:  ")
+                + "grid parameter arrays have wrong size");
+    x0=dpar[0];
+    y0=dpar[1];
+    dx=dpar[2];
+    dy=dpar[3];
+    nx=ipar[0];
+    ny=ipar[1];
+    if(z.size()!=static_cast<size_t>(nx*ny))
+        throw GeoCoordError(string("RegularGrid2d cache file constructor:  ")
+                + "grid size does not match number of values");
+}
+double RegularGrid2d::probe(double x, double y) const
+{
+    if((nx<2) || (ny<2)) return(a_nan());
+    double fx=(x-x0)/dx;
+    double fy=(y-y0)/dy;
+    /* Allow a tiny tolerance at the edges for rounding error */
+    const double tol(1.0e-9);
+    if((fx<-tol) || (fy<-tol)
+            || (fx>static_cast<double>(nx-1)+tol)
+            || (fy>static_cast<double>(ny-1)+tol)) return(a_nan());
+    int i=static_cast<int>(floor(fx));
+    int j=static_cast<int>(floor(fy));
+    if(i<0) i=0;
+    if(j<0) j=0;
+    if(i>nx-2) i=nx-2;
+    if(j>ny-2) j=ny-2;
+    double u=fx-static_cast<double>(i);
+    double v=fy-static_cast<double>(j);
+    const double *row0=&(z[j*nx+i]);
+    const double *row1=row0+nx;
+    return((1.0-v)*((1.0-u)*row0[0]+u*row0[1])
+            + v*((1.0-u)*row1[0]+u*row1[1]));
+}
+void RegularGrid2d::write(BinaryCacheWriter& out) const
+{
+    double dpar[4];
+    int ipar[2];
+    dpar[0]=x0;
+    dpar[1]=y0;
+    dpar[2]=dx;
+    dpar[3]=dy;
+    ipar[0]=nx;
+    ipar[1]=ny;
+    out.write(dpar,4);
+    out.write(ipar,2);
+    out.write(z);
+}
@@ -0,0 +1,58 @@
+#ifndef _REGULARGRID2D_H_
+#define _REGULARGRID2D_H_
+#include <vector>
+#include "BinaryCacheFile.h"
+using namespace std;
+/*! \brief Function sampled on a regular 2d grid.
+
+  This is a simple container for a function f(x,y) sampled on a
+  regular grid with bilinear interpolation between grid nodes.  It is
+  used to hold the result of a spline fit in GeoSplineSurface.  Like
+  the rest of this library x is normally longitude and y latitude, but
+  the object does not care about units.
+  */
+class RegularGrid2d
+{
+public:
+    /*! Default constructor.  Creates an empty grid.*/
+    RegularGrid2d();
+    /*! \brief Create a grid initialized to zero.
+
+      \param xmin is the x coordinate of the first column of nodes.
+      \param ymin is the y coordinate of the first row of nodes.
+      \param dx is the node spacing in x.
+      \param dy is the node spacing in y.
+      \param nx is the number of nodes in x.
+      \param ny is the number of nodes in y.
+      */
+    RegularGrid2d(double xmin, double ymin, double dx, double dy,
+            int nx, int ny);
+    /*! \brief Construct from a cache file.
+
+      Reads data written by the write method.
+      \exception GeoCoordError is thrown for read errors.
+      */
+    RegularGrid2d(BinaryCacheReader& in);
+    /*! Return the value at node i,j */
+    double val(int i, int j) const {return(z[j*nx+i]);};
+    /*! Return a reference to the value at node i,j */
+    double& val(int i, int j) {return(z[j*nx+i]);};
+    /*! \brief Interpolate the grid at x,y.
+
+      Uses bilinear interpolation from the four nodes surrounding x,y.
+      \return interpolated value or a NaN if x,y is outside the grid.
+      */
+    double probe(double x, double y) const;
+    /*! Return x coordinate of column i.*/
+    double x(int i) const {return(x0+dx*static_cast<double>(i));};
+    /*! Return y coordinate of row j.*/
+    double y(int j) const {return(y0+dy*static_cast<double>(j));};
+    /*! Save the grid to a cache file. */
+    void write(BinaryCacheWriter& out) const;
+    double x0,y0;
+    double dx,dy;
+    int nx,ny;
+    /* Values stored in row order (x varies fastest) */
+    vector<double> z;
+};
+#endif
@@ -0,0 +1,278 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "coords.h"
+#include "StagePoleModel.h"
+#include "GeoCoordError.h"
+using namespace std;
+namespace {
+/* Batch rotations with fewer output points than this are never
+   split between threads */
+const int SPMThreadThreshold(4096);
+/* Rotation about unit vector a by angle theta (right hand rule).
+   R=cos(theta)I + sin(theta)[a]x + (1-cos(theta))aa^T  */
+void axis_rotation(const double *a, double theta, double *R)
+{
+    double c=cos(theta);
+    double s=sin(theta);
+    double v=1.0-c;
+    R[0]=c+v*a[0]*a[0];
+    R[1]=v*a[0]*a[1]-s*a[2];
+    R[2]=v*a[0]*a[2]+s*a[1];
+    R[3]=v*a[1]*a[0]+s*a[2];
+    R[4]=c+v*a[1]*a[1];
+    R[5]=v*a[1]*a[2]-s*a[0];
+    R[6]=v*a[2]*a[0]-s*a[1];
+    R[7]=v*a[2]*a[1]+s*a[0];
+    R[8]=c+v*a[2]*a[2];
+}
+/* C=A*B for 3x3 matrices.  C must not be A or B. */
+void matrix_product(const double *A, const double *B, double *C)
+{
+    for(int i=0;i<3;++i)
+        for(int j=0;j<3;++j)
+            C[3*i+j]=A[3*i]*B[j]+A[3*i+1]*B[3+j]+A[3*i+2]*B[6+j];
+}
+inline void apply_rotation(const double *R, const double *x, double *y)
+{
+    y[0]=R[0]*x[0]+R[1]*x[1]+R[2]*x[2];
+    y[1]=R[3]*x[0]+R[4]*x[1]+R[5]*x[2];
+    y[2]=R[6]*x[0]+R[7]*x[1]+R[8]*x[2];
+}
+}  // end anonymous namespace
+StagePoleModel::StagePoleModel(vector<double> spla, vector<double> splo,
+            vector<double> times, vector<double> ang)
+{
+    try{
+        this->build(spla,splo,times,ang);
+    }catch(...){throw;};
+}
+StagePoleModel::StagePoleModel(string fname)
+{
+    const string base_error("StagePoleModel ascii file constructor:  ");
+    ifstream infile;
+    infile.open(fname.c_str(),ifstream::in);
+    if(infile.fail()) throw GeoCoordError(base_error
+            + "open failed for file name=" + fname);
+    vector<double> ilat,ilon,its,ite,iang;
+    char line[512];
+    while(infile.getline(line,512))
+    {
+        /* Skip blank and comment lines */
+        size_t ic=strspn(line," \t\r");
+        if((line[ic]=='\0') || (line[ic]=='#')) continue;
+        stringstream ss(line);
+        double lon,lat,tend,tstart,angle;
+        ss >> lon >> lat >> tend >> tstart >> angle;
+        if(ss.fail()) throw GeoCoordError(base_error
+                + "cannot parse line in file "+fname+":  "+line);
+        ilon.push_back(rad(lon));
+        ilat.push_back(rad(lat));
+        ite.push_back(tend);
+        its.push_back(tstart);
+        iang.push_back(rad(angle));
+    }
+    infile.close();
+    /* Check for input errors.  For first test iang is intentionally tested
+    to handle one line file without enough data. */
+    if(iang.size()==0) throw GeoCoordError(base_error
+            + "file "+fname+" seems to be empty or be improperly formatted");
+    if(ilon.size() != iang.size() ) throw GeoCoordError(base_error
+            + "size mistmatch.  File "+fname
+            + " probably improperly formatted.");
+    size_t i;
+    for(i=1;i<ilon.size();++i)
+    {
+        if(fabs(its[i-1]-ite[i])>0.01) throw GeoCoordError(base_error
+                + "Mismatched start and end time intervals. Require matching time intervals.");
+    }
+    /* Reverse the order of the vectors to get stages in increasing time
+       from present and convert times to positive time intervals.  */
+    vector<double>irlon,irlat,irdt,irang;
+    for(i=ilon.size();i>0;--i)
+    {
+        irlon.push_back(ilon[i-1]);
+        irlat.push_back(ilat[i-1]);
+        irang.push_back(iang[i-1]);
+        irdt.push_back(ite[i-1]-its[i-1]);
+    }
+    try{
+        this->build(irlat,irlon,irdt,irang);
+    }catch(...){throw;};
+}
+StagePoleModel::StagePoleModel(const StagePoleModel& parent)
+{
+    axis=parent.axis;
+    omegadot=parent.omegadot;
+    t0=parent.t0;
+    cumulative=parent.cumulative;
+}
+StagePoleModel& StagePoleModel::operator=(const StagePoleModel& parent)
+{
+    if(this!=&parent)
+    {
+        axis=parent.axis;
+        omegadot=parent.omegadot;
+        t0=parent.t0;
+        cumulative=parent.cumulative;
+    }
+    return(*this);
+}
+/* Positions on a path are computed by latlon with the azimuth from the
+   pole increasing with time.   Azimuth is measured clockwise from north
+   so seen from outside the earth points move clockwise around the pole.
+   That is a negative angle for a right hand rotation about the pole
+   vector.  */
+void StagePoleModel::build(const vector<double>& spla,
+        const vector<double>& splo, const vector<double>& times,
+        const vector<double>& ang)
+{
+    const string base_error("StagePoleModel constructor:  ");
+    if( (spla.size()!=splo.size()) || (splo.size()!=times.size())
+            || (times.size() != ang.size()) )throw GeoCoordError(
+                base_error+" input vector size mismatch");
+    int nstages=spla.size();
+    if(nstages==0) throw GeoCoordError(base_error
+            + "no stage pole data");
+    axis.resize(3*nstages);
+    omegadot.resize(nstages);
+    t0.resize(nstages+1);
+    cumulative.resize(9*(nstages+1));
+    int i;
+    for(i=0;i<9;++i) cumulative[i]=0.0;
+    cumulative[0]=1.0;
+    cumulative[4]=1.0;
+    cumulative[8]=1.0;
+    t0[0]=0.0;
+    for(i=0;i<nstages;++i)
+    {
+        if(times[i]<=0.0) throw GeoCoordError(base_error
+                + "stage time intervals must be positive");
+        dsphcar(splo[i],spla[i],&(axis[3*i]));
+        omegadot[i]=ang[i]/times[i];
+        t0[i+1]=t0[i]+times[i];
+        double S[9];
+        axis_rotation(&(axis[3*i]),-ang[i],S);
+        matrix_product(S,&(cumulative[9*i]),&(cumulative[9*(i+1)]));
+    }
+}
+int StagePoleModel::number_stages() const
+{
+    return(omegadot.size());
+}
+double StagePoleModel::stage_start(int i) const
+{
+    return(t0[i]);
+}
+int StagePoleModel::stage(double t) const
+{
+    if(t<0) throw GeoCoordError(string("StagePoleModel::stage:  ")
+                + "illegal negative time parameter. Must be nonnegative");
+    /* Last stage is open ended so only the first nstages points of t0
+       are searched.  t0[0]=0 so the result is never negative. */
+    int nstages=omegadot.size();
+    int i=upper_bound(t0.begin(),t0.begin()+nstages,t)-t0.begin();
+    return(i-1);
+}
+double StagePoleModel::angular_velocity(int i) const
+{
+    return(omegadot[i]);
+}
+void StagePoleModel::pole(int i, double *p) const
+{
+    for(int k=0;k<3;++k) p[k]=axis[3*i+k];
+}
+void StagePoleModel::rotation_matrix(double t, double *R) const
+{
+    try{
+        int i=this->stage(t);
+        double S[9];
+        axis_rotation(&(axis[3*i]),-omegadot[i]*(t-t0[i]),S);
+        matrix_product(S,&(cumulative[9*i]),R);
+    }catch(...){throw;};
+}
+Geographic_point StagePoleModel::rotate(const Geographic_point& p,
+        double t) const
+{
+    try{
+        double R[9],x[3],y[3];
+        this->rotation_matrix(t,R);
+        dsphcar(p.lon,p.lat,x);
+        apply_rotation(R,x,y);
+        Geographic_point result;
+        result.lat=atan2(y[2],hypot(y[0],y[1]));
+        result.lon=atan2(y[1],y[0]);
+        result.r=p.r;
+        return(result);
+    }catch(...){throw;};
+}
+void StagePoleModel::rotate(const double *x, int npts, const double *t,
+        int ntimes, double *y, bool threaded) const
+{
+    if((npts<=0) || (ntimes<=0)) return;
+    vector<double> R(9*ntimes);
+    int it;
+    try{
+        for(it=0;it<ntimes;++it) this->rotation_matrix(t[it],&(R[9*it]));
+    }catch(...){throw;};
+    long nitems=static_cast<long>(npts)*ntimes;
+    threaded=threaded && (nitems>SPMThreadThreshold);
+    long item;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(item=0;item<nitems;++item)
+    {
+        long ip=item%npts;
+        long k=item/npts;
+        apply_rotation(&(R[9*k]),x+3*ip,y+3*item);
+    }
+}
+void StagePoleModel::rotate(const double *x, int npts, double t,
+        double *lat, double *lon, bool threaded) const
+{
+    if(npts<=0) return;
+    double R[9];
+    try{
+        this->rotation_matrix(t,R);
+    }catch(...){throw;};
+    threaded=threaded && (npts>SPMThreadThreshold);
+    int i;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(i=0;i<npts;++i)
+    {
+        double y[3];
+        apply_rotation(R,x+3*i,y);
+        lat[i]=atan2(y[2],hypot(y[0],y[1]));
+        lon[i]=atan2(y[1],y[0]);
+    }
+}
+vector<Geographic_point> StagePoleModel::rotate(
+        const vector<Geographic_point>& points, const vector<double>& times,
+        bool threaded) const
+{
+    int npts=points.size();
+    int ntimes=times.size();
+    vector<Geographic_point> result;
+    if((npts==0) || (ntimes==0)) return(result);
+    vector<double> x(3*npts);
+    int i;
+    for(i=0;i<npts;++i) dsphcar(points[i].lon,points[i].lat,&(x[3*i]));
+    long nitems=static_cast<long>(npts)*ntimes;
+    vector<double> y(3*nitems);
+    try{
+        this->rotate(&(x[0]),npts,&(times[0]),ntimes,&(y[0]),threaded);
+    }catch(...){throw;};
+    result.resize(nitems);
+    threaded=threaded && (nitems>SPMThreadThreshold);
+    long item;
+#pragma omp parallel for schedule(static) if(threaded)
+    for(item=0;item<nitems;++item)
+    {
+        const double *u=&(y[3*item]);
+        result[item].lat=atan2(u[2],hypot(u[0],u[1]));
+        result[item].lon=atan2(u[1],u[0]);
+        result[item].r=points[item%npts].r;
+    }
+    return(result);
+}
@@ -0,0 +1,132 @@
+#ifndef _STAGEPOLEMODEL_H_
+#define _STAGEPOLEMODEL_H_
+#include <string>
+#include <vector>
+#include "gclgrid.h"
+using namespace std;
+/*! \brief Finite rotation engine for a sequence of stage poles.
+
+  A plate motion history given as stage poles is equivalent to a total
+  (finite) rotation for each time.  This object stores each stage pole
+  as a unit vector and the cumulative rotation matrix at the start of
+  each stage.  The total rotation at time t is then the stage rotation
+  for the time since the start of the active stage times the cumulative
+  rotation for that stage, so the cost of a rotation does not depend on
+  how many stages precede it.  The active stage is found by bisection.
+
+  The motion convention is the same as TimeVariablePlateBoundaryPath:
+  the position at time t of a point that is at x0 at t=0 is
+  rotation_matrix(t)*x0.  Times before 0 are illegal.   Times after the
+  end of the last stage continue with the last stage pole.
+
+  Rotation matrices are 3x3 arrays of 9 doubles stored by rows and
+  operate on earth centered unit vectors with the convention of dsphcar.
+  */
+class StagePoleModel
+{
+public:
+    /*! \brief Construct from vectors of stage pole data.
+
+      Arguments are the same parallel vectors used by the
+      TimeVariablePlateBoundaryPath constructor.  All angles are in radians.
+      \param spla is a vector of stage pole latitudes.
+      \param splo is a vector of stage pole longitudes.
+      \param times is a vector of time intervals covered by each stage pole
+        ordered in increasing time from present.
+      \param ang is a vector of angular displacements for each stage.
+      \exception throws a GeoCoordError if the vectors are empty, differ in
+        size, or any time interval is not positive.
+      */
+    StagePoleModel(vector<double> spla, vector<double> splo,
+            vector<double> times, vector<double> ang);
+    /*! \brief Construct from gmt format stage pole data.
+
+      Reads an ascii file in the format described for the file constructor
+      of TimeVariablePlateBoundaryPath (GMT rotconverter and backtracker
+      stage pole format:  longitude, latitude, tstart, tend, angle listed
+      from oldest to youngest with angles in degrees).  Blank lines and
+      lines starting with # are skipped.
+      \param fname is the file name to be read.
+      \exception throws a GeoCoordError if the file cannot be opened, is
+        empty, or the time intervals do not match.
+      */
+    StagePoleModel(string fname);
+    /*! Standard copy constructor. */
+    StagePoleModel(const StagePoleModel& parent);
+    /*! Standard assignment operator. */
+    StagePoleModel& operator=(const StagePoleModel& parent);
+    /*! Return the number of stage poles. */
+    int number_stages() const;
+    /*! Return time at the start of stage i.  i=number_stages() returns
+      the end time of the last stage. */
+    double stage_start(int i) const;
+    /*! \brief Return index of the stage active at time t.
+
+      \exception throws a GeoCoordError if t is negative. */
+    int stage(double t) const;
+    /*! Return angular velocity (radians/time) of stage i. */
+    double angular_velocity(int i) const;
+    /*! Fill p[3] with the unit vector of the pole for stage i. */
+    void pole(int i, double *p) const;
+    /*! \brief Compute the total rotation at time t.
+
+      \param t is time (nonnegative).
+      \param R receives the 3x3 rotation matrix (9 values by rows).
+      \exception throws a GeoCoordError if t is negative. */
+    void rotation_matrix(double t, double *R) const;
+    /*! \brief Rotate one point to time t.
+
+      The radius of p is not altered.
+      \exception throws a GeoCoordError if t is negative. */
+    Geographic_point rotate(const Geographic_point& p, double t) const;
+    /*! \brief Rotate arrays of unit vectors to many times.
+
+      Rotation matrices are computed once for each time and applied to
+      all points.  Output is ordered by time:  y[3*(it*npts+ip)] is the
+      first component of point ip rotated to time t[it].
+      \param x holds npts unit vectors (3 values each).
+      \param npts is the number of points.
+      \param t holds ntimes times.
+      \param ntimes is the number of times.
+      \param y receives 3*npts*ntimes values.  Must not overlap x.
+      \param threaded when true (default) large arrays are split between
+        threads.
+      \exception throws a GeoCoordError if any time is negative. */
+    void rotate(const double *x, int npts, const double *t, int ntimes,
+            double *y, bool threaded=true) const;
+    /*! \brief Rotate an array of unit vectors to one time.
+
+      Variant of the array method for applications that need geographic
+      coordinates of a large point set one time at a time.  The
+      conversion to latitude and longitude is threaded with the rotation.
+      \param x holds npts unit vectors (3 values each).
+      \param npts is the number of points.
+      \param t is the time.
+      \param lat receives npts latitudes (radians).
+      \param lon receives npts longitudes (radians).
+      \param threaded when true (default) large arrays are split between
+        threads.
+      \exception throws a GeoCoordError if t is negative. */
+    void rotate(const double *x, int npts, double t, double *lat,
+            double *lon, bool threaded=true) const;
+    /*! \brief Rotate a set of points to many times.
+
+      Geographic form of the array method.  The radius of each point is
+      preserved.  The result is ordered by time with all points for
+      times[0] first (result[it*points.size()+ip]).
+      \exception throws a GeoCoordError if any time is negative. */
+    vector<Geographic_point> rotate(const vector<Geographic_point>& points,
+            const vector<double>& times, bool threaded=true) const;
+private:
+    /* Unit vectors of the stage poles (3 per stage) */
+    vector<double> axis;
+    /* Angular velocity of each stage (radians/time) */
+    vector<double> omegadot;
+    /* Time at the start of each stage.  One more point than stages. */
+    vector<double> t0;
+    /* Total rotation matrix at each value of t0 (9 per value). */
+    vector<double> cumulative;
+    void build(const vector<double>& spla, const vector<double>& splo,
+            const vector<double>& times, const vector<double>& ang);
+};
+#endif
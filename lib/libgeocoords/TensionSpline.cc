@@ -0,0 +1,355 @@
+#include <math.h>
+#include <algorithm>
+#include <omp.h>
+#include "TensionSpline.h"
+using namespace std;
+TensionSplineStatistics::TensionSplineStatistics()
+{
+    limit=0.0;
+    converged=false;
+    elapsed=0.0;
+    nthreads=1;
+}
+ostream& operator<<(ostream& os, const TensionSplineStatistics& stats)
+{
+    os << "TensionSpline fit:  "<<stats.nx.size()<<" grids, "
+        << stats.nthreads<<" threads, "
+        << "elapsed time="<<stats.elapsed<<" s"<<endl
+        << "Convergence limit="<<stats.limit<<endl
+        << "nx ny constrained_nodes iterations max_change"<<endl;
+    for(size_t i=0;i<stats.nx.size();++i)
+        os << stats.nx[i]<<" "<<stats.ny[i]<<" "<<stats.nconstrained[i]<<" "
+            << stats.iterations[i]<<" "<<stats.max_change[i]<<endl;
+    if(stats.converged)
+        os << "Solution converged"<<endl;
+    else
+        os << "WARNING:  solution did not converge on the final grid"<<endl;
+    return(os);
+}
+namespace {
+/* One grid in the coarse to fine sequence.   Node values are stored
+   with a two node pad on each side to hold the boundary conditions
+   so the stencil never needs bounds checks. */
+class SplineLevel
+{
+public:
+    SplineLevel(int nxin, int nyin, int stridein)
+        : nx(nxin),ny(nyin),stride(stridein),pitch(nxin+4),
+          z((nxin+4)*(nyin+4),0.0),cindex((nxin+4)*(nyin+4),-1)
+    {};
+    int nx,ny;
+    /* node spacing in units of the final grid spacing */
+    int stride;
+    int pitch;
+    vector<double> z;
+    /* cindex is -1 for a free node or an index into the constraint
+       vectors.  cdx and cdy are the offset of the data point from the
+       node in units of this grid's spacing. */
+    vector<int> cindex;
+    vector<double> cz,cdx,cdy;
+    int index(int i, int j) const {return((j+2)*pitch+i+2);};
+    double& at(int i, int j) {return(z[index(i,j)]);};
+};
+/* Offsets and weights of the finite difference operator */
+class Stencil
+{
+public:
+    Stencil(double tension, double aspect);
+    vector<int> di,dj;
+    vector<double> w;
+    double center;
+};
+Stencil::Stencil(double tension, double aspect)
+{
+    /* 3x3 Laplacian and its square computed by convolution */
+    double a2=aspect*aspect;
+    double lap[3][3]={{0.0,a2,0.0},{1.0,-2.0*(1.0+a2),1.0},{0.0,a2,0.0}};
+    double op[5][5];
+    int i,j,k,l;
+    for(j=0;j<5;++j)
+        for(i=0;i<5;++i) op[j][i]=0.0;
+    for(j=0;j<3;++j)
+        for(i=0;i<3;++i)
+            for(l=0;l<3;++l)
+                for(k=0;k<3;++k)
+                    op[j+l][i+k]+=(1.0-tension)*lap[j][i]*lap[l][k];
+    for(j=0;j<3;++j)
+        for(i=0;i<3;++i)
+            op[j+1][i+1]-=tension*lap[j][i];
+    center=op[2][2];
+    for(j=0;j<5;++j)
+        for(i=0;i<5;++i)
+        {
+            if((i==2) && (j==2)) continue;
+            if(op[j][i]==0.0) continue;
+            di.push_back(i-2);
+            dj.push_back(j-2);
+            w.push_back(op[j][i]);
+        }
+}
+/* Fill the two pad rows/columns on each side from the boundary
+   condition (1-Tb) d2z/dn2 + Tb dz/dn = 0 written with centered
+   differences at the edge node.   The same relation centered one node
+   out gives the second pad node. */
+void apply_boundary_conditions(SplineLevel& g, double tb)
+{
+    double denom=1.0-0.5*tb;
+    double alpha=2.0*(1.0-tb)/denom;
+    double beta=(0.5*tb-(1.0-tb))/denom;
+    int i,j;
+    int nx=g.nx;
+    int ny=g.ny;
+    for(j=0;j<ny;++j)
+    {
+        g.at(-1,j)=alpha*g.at(0,j)+beta*g.at(1,j);
+        g.at(-2,j)=alpha*g.at(-1,j)+beta*g.at(0,j);
+        g.at(nx,j)=alpha*g.at(nx-1,j)+beta*g.at(nx-2,j);
+        g.at(nx+1,j)=alpha*g.at(nx,j)+beta*g.at(nx-1,j);
+    }
+    /* Rows are done after columns so the corners are filled */
+    for(i=-2;i<nx+2;++i)
+    {
+        g.at(i,-1)=alpha*g.at(i,0)+beta*g.at(i,1);
+        g.at(i,-2)=alpha*g.at(i,-1)+beta*g.at(i,0);
+        g.at(i,ny)=alpha*g.at(i,ny-1)+beta*g.at(i,ny-2);
+        g.at(i,ny+1)=alpha*g.at(i,ny)+beta*g.at(i,ny-1);
+    }
+}
+/* Assign data to the closest node of a grid.  fx and fy are data
+   positions in units of the final grid spacing.  If several points
+   are closest to the same node the closest one is used. */
+int set_constraints(SplineLevel& g, const vector<double>& fx,
+        const vector<double>& fy, const vector<double>& z)
+{
+    double s=static_cast<double>(g.stride);
+    vector<int> best(g.nx*g.ny,-1);
+    vector<double> bestdist(g.nx*g.ny,0.0);
+    size_t k;
+    for(k=0;k<fx.size();++k)
+    {
+        double gx=fx[k]/s;
+        double gy=fy[k]/s;
+        int i=static_cast<int>(floor(gx+0.5));
+        int j=static_cast<int>(floor(gy+0.5));
+        if((i<0) || (i>=g.nx) || (j<0) || (j>=g.ny)) continue;
+        double ddx=gx-static_cast<double>(i);
+        double ddy=gy-static_cast<double>(j);
+        double d=ddx*ddx+ddy*ddy;
+        int node=j*g.nx+i;
+        if((best[node]<0) || (d<bestdist[node]))
+        {
+            best[node]=k;
+            bestdist[node]=d;
+        }
+    }
+    int i,j;
+    for(j=0;j<g.ny;++j)
+        for(i=0;i<g.nx;++i)
+        {
+            int kk=best[j*g.nx+i];
+            if(kk<0) continue;
+            g.cindex[g.index(i,j)]=g.cz.size();
+            g.cz.push_back(z[kk]);
+            g.cdx.push_back(fx[kk]/s-static_cast<double>(i));
+            g.cdy.push_back(fy[kk]/s-static_cast<double>(j));
+        }
+    return(g.cz.size());
+}
+/* Bilinear interpolation of a coarse solution to start the next grid.
+   The coarse grid has twice the node spacing of the fine grid. */
+void interpolate_to_finer(SplineLevel& coarse, SplineLevel& fine)
+{
+    int i,j;
+#pragma omp parallel for private(i) schedule(static)
+    for(j=0;j<fine.ny;++j)
+    {
+        int jc=j/2;
+        double v=(j%2) ? 0.5 : 0.0;
+        int jc1=min(jc+1,coarse.ny-1);
+        for(i=0;i<fine.nx;++i)
+        {
+            int ic=i/2;
+            double u=(i%2) ? 0.5 : 0.0;
+            int ic1=min(ic+1,coarse.nx-1);
+            fine.at(i,j)=(1.0-v)*((1.0-u)*coarse.at(ic,jc)+u*coarse.at(ic1,jc))
+                + v*((1.0-u)*coarse.at(ic,jc1)+u*coarse.at(ic1,jc1));
+        }
+    }
+}
+/* Number of nodes needed to cover n fine grid nodes at a stride */
+int coarse_size(int n, int stride)
+{
+    return((n-1+stride-1)/stride+1);
+}
+}  // end anonymous namespace
+
+TensionSpline::TensionSpline(double tension_interior, double tension_boundary,
+        double aspect_ratio, double overrelaxation, double conv,
+        int maxit, double lowerbound, double upperbound)
+{
+    const string base_error("TensionSpline constructor:  ");
+    if((tension_interior<0.0) || (tension_interior>1.0)
+            || (tension_boundary<0.0) || (tension_boundary>1.0))
+        throw GeoCoordError(base_error
+                + "tension parameters must be between 0 and 1");
+    if(aspect_ratio<=0.0)
+        throw GeoCoordError(base_error + "aspect ratio must be positive");
+    if((overrelaxation<=0.0) || (overrelaxation>=2.0))
+        throw GeoCoordError(base_error
+                + "overrelaxation must be between 0 and 2");
+    if(maxit<1)
+        throw GeoCoordError(base_error
+                + "max_iterations must be positive");
+    if(lowerbound>=upperbound)
+        throw GeoCoordError(base_error
+                + "lower bound must be less than upper bound");
+    tension=tension_interior;
+    boundary_tension=tension_boundary;
+    aspect=aspect_ratio;
+    omega=overrelaxation;
+    convergence=conv;
+    max_iterations=maxit;
+    lower=lowerbound;
+    upper=upperbound;
+}
+TensionSplineStatistics TensionSpline::fit(const vector<double>& x,
+        const vector<double>& y, const vector<double>& z,
+        RegularGrid2d& grid) const
+{
+    const string base_error("TensionSpline::fit:  ");
+    if((x.size()!=y.size()) || (x.size()!=z.size()))
+        throw GeoCoordError(base_error
+                + "x,y,z vectors must be the same length");
+    if((grid.nx<2) || (grid.ny<2))
+        throw GeoCoordError(base_error
+                + "grid must have at least 2 nodes in each direction");
+    TensionSplineStatistics stats;
+    double starttime=omp_get_wtime();
+    stats.nthreads=omp_get_max_threads();
+    /* Convert data to grid units and drop points outside the grid */
+    vector<double> fx,fy,fz;
+    size_t k;
+    double zmin(0.0),zmax(0.0),zsum(0.0);
+    for(k=0;k<x.size();++k)
+    {
+        double gx=(x[k]-grid.x0)/grid.dx;
+        double gy=(y[k]-grid.y0)/grid.dy;
+        if((gx<-0.5) || (gx>static_cast<double>(grid.nx)-0.5)
+                || (gy<-0.5) || (gy>static_cast<double>(grid.ny)-0.5))
+            continue;
+        if(fz.empty())
+            zmin=zmax=z[k];
+        else
+        {
+            zmin=min(zmin,z[k]);
+            zmax=max(zmax,z[k]);
+        }
+        zsum+=z[k];
+        fx.push_back(gx);
+        fy.push_back(gy);
+        fz.push_back(z[k]);
+    }
+    if(fz.empty())
+        throw GeoCoordError(base_error + "no data points are inside the grid");
+    stats.limit=convergence*(zmax-zmin);
+    /* Coarsen by factors of 2 until a grid has fewer than 4 nodes
+       in either direction */
+    vector<int> strides;
+    int stride=1;
+    strides.push_back(stride);
+    while((coarse_size(grid.nx,2*stride)>=4)
+            && (coarse_size(grid.ny,2*stride)>=4))
+    {
+        stride*=2;
+        strides.push_back(stride);
+    }
+    Stencil op(tension,aspect);
+    int nstencil=op.w.size();
+    SplineLevel *previous=NULL;
+    int level;
+    for(level=strides.size()-1;level>=0;--level)
+    {
+        int s=strides[level];
+        SplineLevel *g=new SplineLevel(coarse_size(grid.nx,s),
+                coarse_size(grid.ny,s),s);
+        int nc=set_constraints(*g,fx,fy,fz);
+        if(previous==NULL)
+        {
+            double zmean=zsum/static_cast<double>(fz.size());
+            fill(g->z.begin(),g->z.end(),zmean);
+        }
+        else
+        {
+            interpolate_to_finer(*previous,*g);
+            delete previous;
+        }
+        apply_boundary_conditions(*g,boundary_tension);
+        /* Offsets into the padded array for the stencil */
+        vector<int> offset(nstencil);
+        for(int m=0;m<nstencil;++m) offset[m]=op.dj[m]*g->pitch+op.di[m];
+        int iteration;
+        double maxchange(0.0);
+        for(iteration=0;iteration<max_iterations;++iteration)
+        {
+            maxchange=0.0;
+            for(int color=0;color<5;++color)
+            {
+                int i,j;
+#pragma omp parallel for private(i) schedule(static) reduction(max:maxchange)
+                for(j=0;j<g->ny;++j)
+                {
+                    double *zp=&(g->z[0]);
+                    int i0=((color-3*j)%5+5)%5;
+                    for(i=i0;i<g->nx;i+=5)
+                    {
+                        int kk=g->index(i,j);
+                        double zold=zp[kk];
+                        double znew;
+                        int c=g->cindex[kk];
+                        if(c>=0)
+                        {
+                            /* Constrained node.  Correct data value for
+                               offset of data from node with the gradient*/
+                            double gx=0.5*(zp[kk+1]-zp[kk-1]);
+                            double gy=0.5*(zp[kk+g->pitch]-zp[kk-g->pitch]);
+                            znew=g->cz[c]-gx*g->cdx[c]-gy*g->cdy[c];
+                        }
+                        else
+                        {
+                            double sum(0.0);
+                            for(int m=0;m<nstencil;++m)
+                                sum+=op.w[m]*zp[kk+offset[m]];
+                            znew=zold+omega*(-sum/op.center-zold);
+                        }
+                        if(znew<lower) znew=lower;
+                        if(znew>upper) znew=upper;
+                        zp[kk]=znew;
+                        double change=fabs(znew-zold);
+                        if(change>maxchange) maxchange=change;
+                    }
+                }
+            }
+            apply_boundary_conditions(*g,boundary_tension);
+            if(maxchange<=stats.limit)
+            {
+                ++iteration;
+                break;
+            }
+        }
+        stats.nx.push_back(g->nx);
+        stats.ny.push_back(g->ny);
+        stats.iterations.push_back(iteration);
+        stats.max_change.push_back(maxchange);
+        stats.nconstrained.push_back(nc);
+        if(level==0) stats.converged=(maxchange<=stats.limit);
+        previous=g;
+    }
+    /* previous now holds the solution on the final grid */
+    int i,j;
+    for(j=0;j<grid.ny;++j)
+        for(i=0;i<grid.nx;++i)
+            grid.val(i,j)=previous->at(i,j);
+    delete previous;
+    stats.elapsed=omp_get_wtime()-starttime;
+    return(stats);
+}
@@ -0,0 +1,112 @@
+#ifndef _TENSIONSPLINE_H_
+#define _TENSIONSPLINE_H_
+#include <vector>
+#include <ostream>
+#include "GeoCoordError.h"
+#include "RegularGrid2d.h"
+using namespace std;
+/*! \brief Convergence and timing summary for a TensionSpline fit.
+
+  The fit is done on a sequence of grids from coarse to fine.  The
+  vectors have one entry per grid with the coarsest first.  */
+class TensionSplineStatistics
+{
+public:
+    TensionSplineStatistics();
+    /*! Number of nodes in x for each grid. */
+    vector<int> nx;
+    /*! Number of nodes in y for each grid. */
+    vector<int> ny;
+    /*! Number of relaxation sweeps done on each grid. */
+    vector<int> iterations;
+    /*! Largest change in the last sweep on each grid. */
+    vector<double> max_change;
+    /*! Number of nodes constrained by data on each grid. */
+    vector<int> nconstrained;
+    /*! Convergence limit (convergence fraction times data range). */
+    double limit;
+    /*! True if the finest grid converged before max_iterations. */
+    bool converged;
+    /*! Wall clock time of the fit in seconds. */
+    double elapsed;
+    /*! Number of threads used. */
+    int nthreads;
+};
+/*! Print a readable summary of fit statistics. */
+ostream& operator<<(ostream& os, const TensionSplineStatistics& stats);
+/*! \brief Gridding with continuous curvature splines in tension.
+
+  This object fits a surface to irregularly spaced data by solving
+  the equations of Smith and Wessel (1990, Geophysics, 55, 293-305)
+  used by the GMT surface program:
+
+     (1-T) del^4 z - T del^2 z = 0
+
+  on a regular grid with z constrained by the data.  T is the interior
+  tension.   At the grid edges the condition
+
+     (1-Tb) d2z/dn2 + Tb dz/dn = 0
+
+  is applied where Tb is the boundary tension.
+
+  The equations are solved by over-relaxed Gauss-Seidel iteration.  The
+  13 point stencil of del^4 couples nodes two apart, so the usual
+  red-black ordering does not give independent updates.  Nodes are
+  instead split into five colors by (i+3j) mod 5.  No two nodes of the
+  same color are in each other's stencil so all nodes of one color are
+  updated in parallel with OpenMP.   Like GMT the solution is first
+  computed on a coarse grid.  Each result is interpolated to the next
+  finer grid as the starting solution there.   Most of the work is done
+  on the coarse grids so a fine grid needs only a few sweeps.
+
+  A data point constrains the grid node closest to it.   The constraint
+  includes a first order correction for the offset of the point from
+  the node using the local gradient of the current solution.
+  */
+class TensionSpline
+{
+public:
+    /*! \brief Define the fit parameters.
+
+      \param tension_interior is the interior tension T (0 to 1).
+      \param tension_boundary is the boundary tension Tb (0 to 1).
+      \param aspect_ratio is the ratio of x to y node spacing to use in
+        the equations.  Use 1 for an isotropic grid.
+      \param overrelaxation is the over-relaxation factor (1 to 2).
+      \param convergence sets the convergence limit as a fraction of the
+        range of the data values.
+      \param max_iterations is the maximum number of sweeps on each grid.
+      \param lower is a lower bound for the solution.
+      \param upper is an upper bound for the solution.
+
+      \exception GeoCoordError is thrown for illegal parameters.
+      */
+    TensionSpline(double tension_interior, double tension_boundary,
+            double aspect_ratio, double overrelaxation, double convergence,
+            int max_iterations, double lower, double upper);
+    /*! \brief Fit a set of points.
+
+      \param x is a vector of x coordinates of the data.
+      \param y is a vector of y coordinates of the data.
+      \param z is a vector of data values.
+      \param grid defines the geometry of the output.  The node values
+        are replaced by the solution.  Data outside the grid are ignored.
+
+      \return convergence and timing statistics.
+      \exception GeoCoordError is thrown if the vectors are not the
+        same length, the grid is smaller than 2 by 2, or no data are
+        inside the grid.
+      */
+    TensionSplineStatistics fit(const vector<double>& x,
+            const vector<double>& y, const vector<double>& z,
+            RegularGrid2d& grid) const;
+private:
+    double tension;
+    double boundary_tension;
+    double aspect;
+    double omega;
+    double convergence;
+    int max_iterations;
+    double lower,upper;
+};
+#endif